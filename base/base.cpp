@@ -3,7 +3,17 @@
 #include "../tools/debug.h"
 #include "../tools/utils.h"
 #include "../tools/inits.h"
-#include <fstream>
+#include "../tools/settings.h"
+#include "../tools/startupProfiler.h"
+#include "../tools/gltfLoader.h"
+#include "../tools/hash.h"
+#include "../tools/meshCache.h"
+#include "../tools/meshOptimize.h"
+#include "../tools/vertexPacking.h"
+#include "../tools/vfs.h"
+#include "../tools/weld.h"
+#include <filesystem>
+#include <istream>
 
 #define VMA_IMPLEMENTATION
 #include <vk_mem_alloc.h>
@@ -14,6 +24,42 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+namespace {
+
+// tinyobj only reads streams, this one reads straight out of an AssetFile
+struct ViewStreamBuf : std::streambuf {
+    explicit ViewStreamBuf(std::span<const uint8_t> bytes) {
+        char* begin = const_cast<char*>(reinterpret_cast<const char*>(bytes.data()));
+        setg(begin, begin, begin + bytes.size());
+    }
+};
+
+// .mtl files next to the .obj, through the pack like the .obj itself
+class AssetMaterialReader : public tinyobj::MaterialReader {
+public:
+    explicit AssetMaterialReader(std::filesystem::path _directory) : directory(std::move(_directory)) {}
+
+    bool operator()(const std::string& matId, std::vector<tinyobj::material_t>* materials,
+                    std::map<std::string, int>* matMap, std::string* warn, std::string* err) override {
+        AssetFile file;
+        if (!file.open((directory / matId).string().c_str())) {
+            if (warn) {
+                *warn += "Material file [ " + matId + " ] not found.\n";
+            }
+            return false;
+        }
+
+        ViewStreamBuf buffer(file.span());
+        std::istream stream(&buffer);
+        tinyobj::LoadMtl(matMap, materials, &stream, warn, err);
+        return true;
+    }
+
+private:
+    std::filesystem::path directory;
+};
+
+}
 
 
 Base::Base(uint32_t _width, uint32_t _height, const char *_windowName)
@@ -24,16 +70,89 @@ Base::Base(uint32_t _width, uint32_t _height, const char *_windowName)
 }
 
 void Base::prepare() {
-    initWindow();
-    initInstance();
-    initVulkan();
-    initAllocator();
-    createCommandPool();
-    initFrameData();
-    initImmStructures();
+    trace::init();
+    STARTUP_STAGE("Base::prepare");
+
+    // asset reads prefer the pack from here on, IDK_PACK= (empty) runs off loose files only
+    vfs::mount(envString("IDK_PACK", "idk.pak").c_str());
+
+    jobs.init(static_cast<uint32_t>(envNumber("IDK_JOB_THREADS", 0.0)));
+    // compressed pack entries decompress a chunk per job
+    vfs::setParallelFor([this](uint32_t count, const std::function<void(uint32_t, uint32_t)>& function) {
+        jobs.parallelFor(count, 1, function);
+    });
+    vertexFormat = envFlag("IDK_PACKED_VERTICES", true) ? VertexFormat::Packed : VertexFormat::Full;
+
+    {
+        STARTUP_STAGE("initWindow");
+        initWindow();
+    }
+    {
+        STARTUP_STAGE("initInstance");
+        initInstance();
+    }
+    {
+        STARTUP_STAGE("initVulkan");
+        initVulkan();
+    }
+    {
+        STARTUP_STAGE("initAllocator");
+        initAllocator();
+    }
+    if (headless) {
+        STARTUP_STAGE("initHeadlessTarget");
+        initHeadlessTarget();
+    }
+    {
+        STARTUP_STAGE("createCommandPool");
+        createCommandPool();
+    }
+    {
+        STARTUP_STAGE("initFrameData");
+        initFrameData();
+    }
+    {
+        STARTUP_STAGE("initUploadQueue");
+        initUploadQueue();
+    }
+    {
+        STARTUP_STAGE("initBindlessTextures");
+        initBindlessTextures();
+    }
+    {
+        STARTUP_STAGE("initTextureStreamer");
+        initTextureStreamer();
+    }
+    {
+        STARTUP_STAGE("initPipelineCache");
+        initPipelineCache();
+    }
+    {
+        STARTUP_STAGE("initPipelineCompiler");
+        initPipelineCompiler();
+    }
+    {
+        STARTUP_STAGE("initMipGenerator");
+        initMipGenerator();
+    }
+
+    {
+        STARTUP_STAGE("gpu profiler calibrate");
+        gpuProfiler.init(device, physicalDevice, indices.graphicsFamily, MAX_FRAMES);
+        gpuProfiler.calibrate([this](std::function<void(VkCommandBuffer)>&& function) {
+            immediateSubmit(std::move(function));
+        });
+    }
 }
 
 void Base::initWindow() {
+    // automation runs (overdraw capture etc.) don't need anything on screen, or a display to put it on
+    headless = envFlag("IDK_HEADLESS");
+    if (headless) {
+        std::cout << "Headless, rendering " << windowExtent.width << "x" << windowExtent.height << " offscreen" << std::endl;
+        return;
+    }
+
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
@@ -44,7 +163,7 @@ void Base::initWindow() {
 }
 
 void Base::initInstance() {
-    instance = createInstance();
+    instance = createInstance(headless);
 
     debugMessenger = registerDebugCallback(instance);
 }
@@ -52,17 +171,30 @@ void Base::initInstance() {
 void Base::initVulkan() {
     physicalDevice = choosePhysicalDevice(instance);
 
-    VK_CHECK(glfwCreateWindowSurface(instance, window, nullptr, &surface));
+    if (!headless) {
+        VK_CHECK(glfwCreateWindowSurface(instance, window, nullptr, &surface));
+    }
 
     indices = findQueueFamilies(physicalDevice, surface);
+    if (!envFlag("IDK_TRANSFER_QUEUE", true)) {
+        indices.transferFamilyHasValue = false;
+    }
 
-    device = createLogicalDevice(physicalDevice, indices);
+    device = createLogicalDevice(physicalDevice, indices, !headless);
 
     vkGetDeviceQueue(device, indices.graphicsFamily, 0, &graphicsQueue);
     vkGetDeviceQueue(device, indices.presentFamily, 0, &presentQueue);
+    if (indices.transferFamilyHasValue) {
+        vkGetDeviceQueue(device, indices.transferFamily, 0, &transferQueue);
+    }
 
-    swapchain.setContext(instance, physicalDevice, device, surface, window);
-    swapchain.create(windowExtent.width, windowExtent.height, indices);
+    // headless keeps the extent here too, it's what everything sizes its targets by
+    if (headless) {
+        swapchain.swapchainExtent = windowExtent;
+    } else {
+        swapchain.setContext(instance, physicalDevice, device, surface, window);
+        swapchain.create(windowExtent.width, windowExtent.height, indices);
+    }
 
     initialized = true;
 }
@@ -72,13 +204,35 @@ void Base::initAllocator() {
     allocInfo.physicalDevice = physicalDevice;
     allocInfo.device = device;
     allocInfo.instance = instance;
-    allocInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT | VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    allocInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
 
-#ifndef NDEBUG
-    allocInfo.flags |= VMA_ALLOCATOR_CREATE_EXTERNALLY_SYNCHRONIZED_BIT;
-#endif
+    if (isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        allocInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
 
+    // no VMA_ALLOCATOR_CREATE_EXTERNALLY_SYNCHRONIZED_BIT: job workers, the upload thread and the
+    // texture streamer allocate while the main thread frees, VMA has to do its own locking
     VK_CHECK(vmaCreateAllocator(&allocInfo, &allocator));
+
+    memoryTelemetry.init(allocator);
+}
+
+void Base::initHeadlessTarget() {
+    // same format as the swapchain views, so the pipelines don't care which one they draw into
+    headlessTarget = createAllocatedImage({ windowExtent.width, windowExtent.height, 1 }, VK_FORMAT_B8G8R8A8_SRGB,
+                                          VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false,
+                                          MemoryCategory::RenderTarget, "headless target");
+}
+
+bool Base::shouldClose() const {
+    return headless ? closeRequested : glfwWindowShouldClose(window);
+}
+
+void Base::requestClose() {
+    closeRequested = true;
+    if (window) {
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
 }
 
 void Base::initDepthImage() {
@@ -89,16 +243,17 @@ void Base::initDepthImage() {
     };
 
     depthImage = createAllocatedImage(depthImageExtent, VK_FORMAT_D32_SFLOAT,
-                                     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, false);
+                                     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, false,
+                                     MemoryCategory::RenderTarget, "depth");
 
-    immediateSubmit([&](VkCommandBuffer cmd) {
+    uploads.enqueue([image = depthImage.image](VkCommandBuffer cmd) {
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
         barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
         barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
         barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = depthImage.image;
+        barrier.image = image;
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
         barrier.subresourceRange.baseMipLevel = 0;
         barrier.subresourceRange.levelCount = 1;
@@ -138,24 +293,43 @@ void Base::initFrameData() {
     }
 }
 
-void Base::initImmStructures() {
-    immFence = createFence(device);
+void Base::initUploadQueue() {
+    uploads.init(device, allocator, &memoryTelemetry, indices.graphicsFamily, graphicsQueue, &graphicsQueueMutex);
+}
 
-    VkCommandPoolCreateInfo cmdPoolInfo = {};
-    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    cmdPoolInfo.queueFamilyIndex = indices.graphicsFamily;
-    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+void Base::initBindlessTextures() {
+    bindlessTextures.init(device, physicalDevice);
+}
 
-    VK_CHECK(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &immCommandPool));
+void Base::initTextureStreamer() {
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
 
-    VkCommandBufferAllocateInfo cmdBufferAllocInfo { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-    cmdBufferAllocInfo.pNext = nullptr;
-    cmdBufferAllocInfo.commandPool = immCommandPool;
-    cmdBufferAllocInfo.commandBufferCount = 1;
-    cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    textureStreamer.init(device, allocator, &memoryTelemetry, &jobs, &uploads, indices, graphicsQueue, transferQueue,
+                         &graphicsQueueMutex, supportedFeatures.textureCompressionBC, &bindlessTextures,
+                         &mipGenerator);  // initialized a stage later, the streamer only touches it after request()
+}
+
+void Base::initPipelineCache() {
+    pipelineCache.init(device, physicalDevice);
+}
 
-    VK_CHECK(vkAllocateCommandBuffers(device, &cmdBufferAllocInfo, &immCommandBuffer));
+void Base::initPipelineCompiler() {
+    bool pipelineLibrary = useGraphicsPipelineLibrary(physicalDevice);
+    pipelineCompiler.init(device, &pipelineCache, &jobs, [this](const char* path) { return loadShader(device, path); },
+                          pipelineLibrary);
+    std::cout << "Pipelines compile on the job system" << (pipelineLibrary ? ", linked from graphics pipeline libraries" : "")
+              << std::endl;
+}
+
+void Base::initMipGenerator() {
+    VkShaderModule shader = loadShader(device, "../shaders/mips.comp.glsl.spv");
+    mipGenerator.init(device, allocator, &memoryTelemetry, &pipelineCache, shader);
+    vkDestroyShaderModule(device, shader, nullptr);
+}
 
+void Base::initVirtualTextures() {
+    virtualTextures.init(device, allocator, &memoryTelemetry, &jobs, &uploads);
 }
 
 void Base::initCamera(float x, float y, float z) {
@@ -188,171 +362,367 @@ void Base::createCommandBuffers() {
 }
 
 MeshBuffers Base::loadMesh(std::span<uint32_t> indices, std::span<Vertex> vertices) {
+    // one width for the whole merged buffer, surfaces index into it by startIndex
+    VkIndexType type = chooseIndexType(vertices.size());
+    std::vector<uint16_t> narrowed;
+    std::span<const std::byte> indexBytes = std::as_bytes(indices);
+    if (type == VK_INDEX_TYPE_UINT16) {
+        narrowed = narrowIndices(indices);
+        indexBytes = std::as_bytes(std::span(narrowed));
+    }
+
     const size_t vertexBufferSize = vertices.size() * sizeof(Vertex);
-    const size_t indexBufferSize = indices.size() * sizeof(uint32_t);
+    const size_t indexBufferSize = indexBytes.size();
 
     MeshBuffers newMeshBuffer;
+    newMeshBuffer.indexType = type;
     newMeshBuffer.vertexBuffer = createAllocatedBuffer(vertexBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-        VMA_MEMORY_USAGE_GPU_ONLY);
+        VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Mesh, "vertices");
     assert(newMeshBuffer.vertexBuffer.allocation);
 
     VkBufferDeviceAddressInfo deviceAddressInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,.buffer = newMeshBuffer.vertexBuffer.buffer };
     newMeshBuffer.vertexBufferAddress = vkGetBufferDeviceAddress(device, &deviceAddressInfo);
 
     newMeshBuffer.indexBuffer = createAllocatedBuffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VMA_MEMORY_USAGE_GPU_ONLY);
+        VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Mesh, "indices");
 
-    AllocatedBuffer staging  = createAllocatedBuffer(vertexBufferSize + indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+    StagingSlice staging = uploads.allocateStaging(vertexBufferSize + indexBufferSize);
+    memcpy(staging.data, vertices.data(), vertexBufferSize);
+    memcpy(staging.data + vertexBufferSize, indexBytes.data(), indexBufferSize);
 
-    void* data = staging.allocation->GetMappedData();
-    memcpy(data, vertices.data(), vertexBufferSize);
-    memcpy((char*)data + vertexBufferSize, indices.data(), indexBufferSize);
-
-    immediateSubmit([&](VkCommandBuffer cmd) {
+    uploads.enqueue([staging, vertexBufferSize, indexBufferSize, vertexDst = newMeshBuffer.vertexBuffer.buffer,
+                     indexDst = newMeshBuffer.indexBuffer.buffer](VkCommandBuffer cmd) {
         VkBufferCopy vertexCopy { 0 };
         vertexCopy.dstOffset = 0;
-        vertexCopy.srcOffset = 0;
+        vertexCopy.srcOffset = staging.offset;
         vertexCopy.size = vertexBufferSize;
 
-        vkCmdCopyBuffer(cmd, staging.buffer, newMeshBuffer.vertexBuffer.buffer, 1, &vertexCopy);
+        vkCmdCopyBuffer(cmd, staging.buffer, vertexDst, 1, &vertexCopy);
 
         VkBufferCopy indexCopy{ 0 };
         indexCopy.dstOffset = 0;
-        indexCopy.srcOffset = vertexBufferSize;
+        indexCopy.srcOffset = staging.offset + vertexBufferSize;
         indexCopy.size = indexBufferSize;
 
-        vkCmdCopyBuffer(cmd, staging.buffer, newMeshBuffer.indexBuffer.buffer, 1, &indexCopy);
-    });
-
-    destroyAllocatedBuffer(staging.buffer, staging.allocation);
+        vkCmdCopyBuffer(cmd, staging.buffer, indexDst, 1, &indexCopy);
+    }, staging);
 
     return newMeshBuffer;
 }
 
 
+void Base::loadModel(const char *filePath) {
+    std::string extension = std::filesystem::path(filePath).extension().string();
+    if (extension == ".gltf" || extension == ".glb") {
+        loadGltf(filePath);
+    } else {
+        loadObj(filePath);
+    }
+    modelNodes.setGpuCopies(MAX_FRAMES);
+}
+
 void Base::loadObj(const char *filePath) {
+    TRACE_FUNCTION();
+
+    uint64_t sourceHash = 0;
+    uint64_t sourceSize = 0;
+    {
+        TRACE_ZONE("hash source");
+        AssetFile source;
+        if (!source.open(filePath)) {
+            throw std::runtime_error(std::string("Could not open ") + filePath);
+        }
+        sourceHash = hash64(source.data(), source.size());
+        sourceSize = source.size();
+    }
+
+    cookMesh(filePath, sourceHash, sourceSize, [this, filePath](const MeshOptimizeSettings* optimize) {
+        ObjMeshData meshData = parseObj(filePath);
+        if (optimize) {
+            TRACE_ZONE("optimize mesh");
+            MeshOptimizeReport report = optimizeMesh<Vertex>(meshData.indices, meshData.vertices, *optimize);
+            printMeshOptimizeReport(filePath, report);
+        }
+        return meshData;
+    });
+
+    modelNodes.clear();
+    modelNodes.add();
+    modelNodes.update();
+}
+
+void Base::loadGltf(const char *filePath) {
+    TRACE_FUNCTION();
+
+    // the json and the mapped buffers are all the cache check needs, decoding waits for a miss
+    GLTFLoader loader;
+    loader.open(filePath);
+
+    cookMesh(filePath, loader.sourceHash(), loader.sourceSize(), [this, &loader](const MeshOptimizeSettings* optimize) {
+        loader.decode(jobs, optimize);
+
+        ObjMeshData meshData;
+        meshData.vertices = std::move(loader.vertices);
+        meshData.indices = std::move(loader.indices);
+        for (const GLTFLoader::Primitive& primitive : loader.primitives) {
+            meshData.surfaces.push_back({ primitive.firstIndex, primitive.indexCount, primitive.materialIndex, primitive.node });
+        }
+        return meshData;
+    });
+
+    // open() read these, so they're here on a cache hit too. embedded images aren't streamed
+    modelNodes = std::move(loader.transforms);
+    modelMaterials = loader.materials;
+    modelMaterialTextures.clear();
+    for (const Material& material : modelMaterials) {
+        int32_t image = material.baseColorTexture >= 0 ? loader.textureImages[material.baseColorTexture] : -1;
+        modelMaterialTextures.push_back(image >= 0 ? loader.imagePaths[image] : std::string());
+    }
+}
+
+// the cooked cache if it matches the source, otherwise parse (which also optimizes), quantize,
+// write the cache and upload
+void Base::cookMesh(const char *filePath, uint64_t sourceHash, uint64_t sourceSize, const MeshParser& parse) {
+    bool useCache = envFlag("IDK_MESH_CACHE", true);
+    std::string cachePath = cacheFilePath(filePath, "mesh");
+
+    uint32_t cookFlags = 0;
+    if (envFlag("IDK_MESH_OPTIMIZE", true)) {
+        cookFlags |= MeshCookOptimized;
+        if (envFlag("IDK_MESH_OVERDRAW")) {
+            cookFlags |= MeshCookOverdrawOptimized;
+        }
+    }
+    if (vertexFormat == VertexFormat::Packed) {
+        cookFlags |= MeshCookPackedVertices;
+    }
+
+    if (useCache) {
+        CookedMesh cooked;
+        if (cooked.open(cachePath, sourceHash, sourceSize, cookFlags)) {
+            const MeshCacheHeader& header = cooked.header();
+            MeshBounds bounds {
+                glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+                glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2])
+            };
+            vertexScale = quantizationScale(bounds);
+            vertexOffset = quantizationOffset(bounds);
+
+            if (!cooked.readSurfaces(modelSurfaces)) {
+                throw std::runtime_error("Mesh cache " + cachePath + " is corrupt");
+            }
+
+            VkIndexType type = header.indexStride == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+            uploadMeshData(cooked.vertexBytes(), cooked.indexBytes(), type, filePath,
+                           [&](std::byte* vertexDst, std::byte* indexDst) {
+                if (!cooked.readVertices(vertexDst) || !cooked.readIndices(indexDst)) {
+                    throw std::runtime_error("Mesh cache " + cachePath + " is corrupt");
+                }
+            });
+            return;
+        }
+    }
+
+    MeshOptimizeSettings settings;
+    settings.optimizeOverdraw = cookFlags & MeshCookOverdrawOptimized;
+    ObjMeshData meshData = parse((cookFlags & MeshCookOptimized) ? &settings : nullptr);
+
+    modelSurfaces = std::move(meshData.surfaces);
+    if (modelSurfaces.empty()) {
+        modelSurfaces.push_back({ 0, static_cast<uint32_t>(meshData.indices.size()), -1, 0 });
+    }
+
+    MeshBounds bounds = computeBounds(meshData.vertices);
+    vertexScale = quantizationScale(bounds);
+    vertexOffset = quantizationOffset(bounds);
+
+    std::vector<PackedVertex> packedVertices;
+    std::span<const std::byte> vertexBytes = std::as_bytes(std::span(meshData.vertices));
+    uint32_t vertexStride = sizeof(Vertex);
+    if (vertexFormat == VertexFormat::Packed) {
+        TRACE_ZONE("pack vertices");
+        packedVertices = packVertices(meshData.vertices, bounds);
+        vertexBytes = std::as_bytes(std::span(packedVertices));
+        vertexStride = sizeof(PackedVertex);
+    }
+
+    VkIndexType type = chooseIndexType(meshData.vertices.size());
+    std::vector<uint16_t> narrowedIndices;
+    std::span<const std::byte> indexBytes = std::as_bytes(std::span(meshData.indices));
+    if (type == VK_INDEX_TYPE_UINT16) {
+        narrowedIndices = narrowIndices(meshData.indices);
+        indexBytes = std::as_bytes(std::span(narrowedIndices));
+    }
+
+    if (useCache) {
+        TRACE_ZONE("write mesh cache");
+        if (writeMeshCache(cachePath, sourceHash, sourceSize, cookFlags, vertexBytes, vertexStride, bounds,
+                           indexBytes, indexTypeSize(type), modelSurfaces)) {
+            std::cout << "Cooked " << filePath << " to " << cachePath << std::endl;
+        }
+    }
+
+    uploadMeshData(vertexBytes, indexBytes, type, filePath);
+}
+
+ObjMeshData Base::parseObj(const char *filePath) {
+    TRACE_FUNCTION();
+
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
     std::string warn, err;
 
-    std::vector<Vertex>           vertices;
-    std::vector<uint32_t>         vertexIndices;
+    ObjMeshData meshData;
+    std::vector<Vertex>&          vertices = meshData.vertices;
+    std::vector<uint32_t>&        vertexIndices = meshData.indices;
 
-    if (!LoadObj(&attrib, &shapes, &materials, &warn, &err, filePath)) {
-        throw std::runtime_error(warn + err);
+    {
+        TRACE_ZONE("tinyobj::LoadObj");
+        AssetFile source;
+        if (!source.open(filePath)) {
+            throw std::runtime_error(std::string("Could not open ") + filePath);
+        }
+
+        ViewStreamBuf buffer(source.span());
+        std::istream stream(&buffer);
+        AssetMaterialReader materialReader(std::filesystem::path(filePath).parent_path());
+        if (!LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream, &materialReader)) {
+            throw std::runtime_error(warn + err);
+        }
     }
 
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+    std::vector<Vertex> corners;
+    std::vector<WeldRange> shards;
+    {
+        TRACE_ZONE("expand corners");
+        size_t cornerCount = 0;
+        for (const auto& shape : shapes) {
+            cornerCount += shape.mesh.indices.size();
+        }
+        corners.reserve(cornerCount);
 
-    for (const auto& shape : shapes) {
-        for (const auto& index : shape.mesh.indices) {
-            Vertex vertex{};
+        for (const auto& shape : shapes) {
+            shards.push_back({ corners.size(), shape.mesh.indices.size() });
 
-            vertex.position = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
+            for (const auto& index : shape.mesh.indices) {
+                Vertex vertex{};
 
-            if (index.texcoord_index >= 0) {
-                vertex.uv_x = attrib.texcoords[2 * index.texcoord_index + 0];
-                vertex.uv_y = 1.0f - attrib.texcoords[2 * index.texcoord_index + 1];
+                vertex.position = {
+                    attrib.vertices[3 * index.vertex_index + 0],
+                    attrib.vertices[3 * index.vertex_index + 1],
+                    attrib.vertices[3 * index.vertex_index + 2]
+                };
 
-            } else {
-                vertex.uv_x = 0.0f;
-                vertex.uv_y = 0.0f;
-            }
+                if (index.texcoord_index >= 0) {
+                    vertex.uv_x = attrib.texcoords[2 * index.texcoord_index + 0];
+                    vertex.uv_y = 1.0f - attrib.texcoords[2 * index.texcoord_index + 1];
 
-            if (index.normal_index >= 0) {
-                vertex.normal = {
-                    attrib.normals[3 * index.normal_index + 0],
-                    attrib.normals[3 * index.normal_index + 1],
-                    attrib.normals[3 * index.normal_index + 2]
-                };
-            } else {
-                vertex.normal = {0.0f, 1.0f, 0.0f};
-            }
+                } else {
+                    vertex.uv_x = 0.0f;
+                    vertex.uv_y = 0.0f;
+                }
 
-            vertex.color = {1.0f, 1.0f, 1.0f};
+                if (index.normal_index >= 0) {
+                    vertex.normal = {
+                        attrib.normals[3 * index.normal_index + 0],
+                        attrib.normals[3 * index.normal_index + 1],
+                        attrib.normals[3 * index.normal_index + 2]
+                    };
+                } else {
+                    vertex.normal = {0.0f, 1.0f, 0.0f};
+                }
 
-            if (!uniqueVertices.contains(vertex)) {
-                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                vertices.push_back(vertex);
-            }
+                vertex.color = {1.0f, 1.0f, 1.0f};
 
-            vertexIndices.push_back(uniqueVertices[vertex]);
+                corners.push_back(vertex);
+            }
         }
     }
 
+    {
+        TRACE_ZONE("weld vertices");
+        // loadObj runs on a worker, the shards go to the same pool rather than threads of their own
+        weldVertices<Vertex>(corners, shards, vertices, vertexIndices,
+                             [this](uint32_t count, const std::function<void(uint32_t, uint32_t)>& function) {
+                                 jobs.parallelFor(count, 1, function);
+                             });
+    }
+
+    return meshData;
+}
+
+void Base::uploadMeshData(std::span<const std::byte> vertexBytes, std::span<const std::byte> indexBytes, VkIndexType type,
+                          const char *name) {
+    uploadMeshData(vertexBytes.size(), indexBytes.size(), type, name, [&](std::byte* vertexDst, std::byte* indexDst) {
+        memcpy(vertexDst, vertexBytes.data(), vertexBytes.size());
+        memcpy(indexDst, indexBytes.data(), indexBytes.size());
+    });
+}
+
+// vertices and indices share one staging slice, the cooked path reads (or decompresses) into it straight
+// from the cache file. the copy goes out with the next uploads.flush()
+void Base::uploadMeshData(size_t vertexBytes, size_t indexBytes, VkIndexType type, const char *name,
+                          const MeshDataFill& fill) {
+    TRACE_FUNCTION();
 
-    size_t vertexBuffersize = vertices.size() * sizeof(Vertex);
-    indexCount = static_cast<uint32_t>(vertexIndices.size());
-    size_t indexBufferSize = vertexIndices.size() * sizeof(uint32_t);
+    size_t vertexBuffersize = vertexBytes;
+    indexType = type;
+    indexCount = static_cast<uint32_t>(indexBytes / indexTypeSize(type));
+    size_t indexBufferSize = indexBytes;
 
     vertexBuffer = createAllocatedBuffer(vertexBuffersize,  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-        VMA_MEMORY_USAGE_GPU_ONLY);
+        VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Mesh, name);
     VkBufferDeviceAddressInfo deviceAddressInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,.buffer = vertexBuffer.buffer };
     vertexBuffer.bufferAddress = vkGetBufferDeviceAddress(device, &deviceAddressInfo);
 
     indexBuffer = createAllocatedBuffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VMA_MEMORY_USAGE_GPU_ONLY);
-
-    AllocatedBuffer vertexStaging = createAllocatedBuffer(vertexBuffersize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Mesh, name);
 
-    void* vertexData;
-    vmaMapMemory(allocator, vertexStaging.allocation, &vertexData);
-    memcpy(vertexData, vertices.data(), vertexBuffersize);
-    vmaUnmapMemory(allocator, vertexStaging.allocation);
-
-    AllocatedBuffer indexStaging = createAllocatedBuffer(indexBufferSize,
-       VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-    void* indexData;
-    vmaMapMemory(allocator, indexStaging.allocation, &indexData);
-    memcpy(indexData, vertexIndices.data(), indexBufferSize);
-    vmaUnmapMemory(allocator, indexStaging.allocation);
+    StagingSlice staging = uploads.allocateStaging(vertexBuffersize + indexBufferSize);
+    {
+        TRACE_ZONE("fill staging");
+        fill(staging.data, staging.data + vertexBuffersize);
+    }
 
-    immediateSubmit([&](VkCommandBuffer cmd) {
+    uploads.enqueue([staging, vertexBuffersize, indexBufferSize, vertexDst = vertexBuffer.buffer,
+                     indexDst = indexBuffer.buffer](VkCommandBuffer cmd) {
         VkBufferCopy vertexCopy{};
+        vertexCopy.srcOffset = staging.offset;
         vertexCopy.size = vertexBuffersize;
-        vkCmdCopyBuffer(cmd, vertexStaging.buffer, vertexBuffer.buffer, 1, &vertexCopy);
+        vkCmdCopyBuffer(cmd, staging.buffer, vertexDst, 1, &vertexCopy);
 
         VkBufferCopy indexCopy{};
+        indexCopy.srcOffset = staging.offset + vertexBuffersize;
         indexCopy.size = indexBufferSize;
-        vkCmdCopyBuffer(cmd, indexStaging.buffer, indexBuffer.buffer, 1, &indexCopy);
-    });
-
-    vmaDestroyBuffer(allocator, vertexStaging.buffer, vertexStaging.allocation);
-    vmaDestroyBuffer(allocator, indexStaging.buffer, indexStaging.allocation);
+        vkCmdCopyBuffer(cmd, staging.buffer, indexDst, 1, &indexCopy);
+    }, staging);
 }
 
-AllocatedImage Base::loadTextureImage(const char *filePath) {
+// the copy and the mip chain go out with the next uploads.flush()
+AllocatedImage Base::loadTextureImage(const char *filePath, MipMode mipMode) {
+    TRACE_FUNCTION();
+
     int texWidth, texHeight, texChannels;
 
-    stbi_uc* pixels = stbi_load(filePath, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    stbi_uc* pixels = nullptr;
+    {
+        TRACE_ZONE("stbi_load");
+        AssetFile source;
+        if (!source.open(filePath)) {
+            throw std::runtime_error(std::string("Could not open ") + filePath);
+        }
+        pixels = stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &texWidth, &texHeight,
+                                       &texChannels, STBI_rgb_alpha);
+        if (!pixels) {
+            throw std::runtime_error(std::string("Could not decode ") + filePath + ": " + stbi_failure_reason());
+        }
+    }
     uint64_t imageSize = texWidth * texHeight * 4;
     uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
 
-    VkBuffer stagingBuffer;
-    VmaAllocation stagingAllocation;
-
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = imageSize;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    VmaAllocationCreateInfo allocInfo{};
-    allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-
-    vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &stagingBuffer, &stagingAllocation, nullptr);
-
-    void* mappedData;
-    vmaMapMemory(allocator, stagingAllocation, &mappedData);
-    memcpy(mappedData, pixels, imageSize);
-    vmaUnmapMemory(allocator, stagingAllocation);
+    StagingSlice staging = uploads.allocateStaging(imageSize);
+    memcpy(staging.data, pixels, imageSize);
 
     stbi_image_free(pixels);
 
@@ -362,11 +732,24 @@ AllocatedImage Base::loadTextureImage(const char *filePath) {
         1
     };
 
-    AllocatedImage texImage = createAllocatedImage(imageExtent, VK_FORMAT_R8G8B8A8_SRGB,
-           VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-           true);
+    bool computeMips = MipGenerator::useCompute(mipMode) &&
+        MipGenerator::supports(VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
+
+    AllocatedImage texImage;
+    MipGenerator::Views mipViews;
+    if (computeMips) {
+        texImage = createAllocatedImage(imageExtent, VK_FORMAT_R8G8B8A8_SRGB,
+               VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+               true, MemoryCategory::Texture, filePath,
+               VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT);
+        mipViews = mipGenerator.createViews(texImage.image, VK_FORMAT_R8G8B8A8_SRGB, mipLevels);
+    } else {
+        texImage = createAllocatedImage(imageExtent, VK_FORMAT_R8G8B8A8_SRGB,
+               VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+               true, MemoryCategory::Texture, filePath);
+    }
 
-    immediateSubmit([&](VkCommandBuffer cmd) {
+    uploads.enqueue([this, staging, texImage, texWidth, texHeight, mipLevels, computeMips, mipViews](VkCommandBuffer cmd) {
         // Transition entire image (all mip levels) to transfer destination
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -388,7 +771,7 @@ AllocatedImage Base::loadTextureImage(const char *filePath) {
             0, 0, nullptr, 0, nullptr, 1, &barrier);
 
         VkBufferImageCopy region{};
-        region.bufferOffset = 0;
+        region.bufferOffset = staging.offset;
         region.bufferRowLength = 0;
         region.bufferImageHeight = 0;
         region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -401,12 +784,17 @@ AllocatedImage Base::loadTextureImage(const char *filePath) {
             static_cast<uint32_t>(texHeight),
             1 };
 
-        vkCmdCopyBufferToImage(cmd, stagingBuffer, texImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        vkCmdCopyBufferToImage(cmd, staging.buffer, texImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
-        createMipmaps(cmd, texImage.image, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
+        if (computeMips) {
+            mipGenerator.record(cmd, texImage.image, VK_FORMAT_R8G8B8A8_SRGB, mipViews, texWidth, texHeight);
+        } else {
+            createMipmaps(cmd, texImage.image, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
+        }
+    }, staging, [this, mipViews]() mutable {
+        mipGenerator.destroyViews(mipViews);
     });
 
-    vmaDestroyBuffer(allocator, stagingBuffer, stagingAllocation);
     return texImage;
 }
 
@@ -491,12 +879,14 @@ void Base::createMipmaps(VkCommandBuffer cmd, VkImage image, VkFormat imageForma
         0, nullptr, 0, nullptr, 1, &barrier);
 }
 
-AllocatedImage Base::createAllocatedImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped) {
+AllocatedImage Base::createAllocatedImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped,
+                                          MemoryCategory category, const char* name, VkImageCreateFlags flags) {
     AllocatedImage newImage;
     newImage.imageFormat = format;
     newImage.imageExtent = size;
 
     VkImageCreateInfo img_info = imageCreateInfo(format, usage, size);
+    img_info.flags = flags;
     if (mipmapped) {
         img_info.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(size.width, size.height)))) + 1;
     } else {
@@ -508,6 +898,7 @@ AllocatedImage Base::createAllocatedImage(VkExtent3D size, VkFormat format, VkIm
     allocinfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
     VK_CHECK(vmaCreateImage(allocator, &img_info, &allocinfo, &newImage.image, &newImage.allocation, nullptr));
+    memoryTelemetry.track(newImage.allocation, category, name);
 
     VkImageAspectFlags aspectFlag = VK_IMAGE_ASPECT_COLOR_BIT;
     if (format == VK_FORMAT_D32_SFLOAT) {
@@ -517,12 +908,20 @@ AllocatedImage Base::createAllocatedImage(VkExtent3D size, VkFormat format, VkIm
     VkImageViewCreateInfo view_info = imageviewCreateInfo(format, newImage.image, aspectFlag);
     view_info.subresourceRange.levelCount = img_info.mipLevels;
 
+    // extended usage means the format itself may not support all of usage, keep that off the default view
+    VkImageViewUsageCreateInfo viewUsage { VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO };
+    if (flags & VK_IMAGE_CREATE_EXTENDED_USAGE_BIT) {
+        viewUsage.usage = usage & ~VK_IMAGE_USAGE_STORAGE_BIT;
+        view_info.pNext = &viewUsage;
+    }
+
     VK_CHECK(vkCreateImageView(device, &view_info, nullptr, &newImage.imageView));
 
     return newImage;
 }
 
-AllocatedBuffer Base::createAllocatedBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) {
+AllocatedBuffer Base::createAllocatedBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                            MemoryCategory category, const char* name) {
     VkBufferCreateInfo bufferInfo = {.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
     bufferInfo.pNext = nullptr;
     bufferInfo.size = allocSize;
@@ -536,35 +935,26 @@ AllocatedBuffer Base::createAllocatedBuffer(size_t allocSize, VkBufferUsageFlags
 
     VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &vmaAllocInfo, &newBuffer.buffer, &newBuffer.allocation,
         &newBuffer.info));
+    memoryTelemetry.track(newBuffer.allocation, category, name);
 
     return newBuffer;
 }
 
 void Base::destroyAllocatedImage(VkImage image, VmaAllocation allocation) {
+    memoryTelemetry.untrack(allocation);
     vmaDestroyImage(allocator, image, allocation);
 }
 
 void Base::destroyAllocatedBuffer(VkBuffer buffer, VmaAllocation allocation) {
+    memoryTelemetry.untrack(allocation);
     vmaDestroyBuffer(allocator, buffer, allocation);
 }
 
+// safe from any thread, the upload thread does the recording and submit
 void Base::immediateSubmit(std::function<void(VkCommandBuffer cmd)> &&function) {
-    VK_CHECK(vkResetFences(device, 1, &immFence));
-    VK_CHECK(vkResetCommandBuffer(immCommandBuffer, 0));
-
-    VkCommandBufferBeginInfo cmdBeginInfo = commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-    VK_CHECK(vkBeginCommandBuffer(immCommandBuffer, &cmdBeginInfo));
+    TRACE_FUNCTION();
 
-    function(immCommandBuffer);
-
-    VK_CHECK(vkEndCommandBuffer(immCommandBuffer));
-
-    VkCommandBufferSubmitInfo cmdInfo = submitCommandBufferInfo(immCommandBuffer);
-    VkSubmitInfo2 submit = createSubmitInfo(&cmdInfo, nullptr, nullptr);
-
-    VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submit, immFence));
-    VK_CHECK(vkWaitForFences(device, 1, &immFence, true, 9999999999));
+    uploads.submitAndWait(std::move(function));
 }
 
 
@@ -603,26 +993,20 @@ void Base::updatePerFrameData(uint32_t frameIndex) {
 }
 
 VkShaderModule Base::loadShader(VkDevice device, const char *filePath) {
-    std::ifstream file(filePath, std::ios::ate | std::ios::binary);
-
-    if (!file.is_open()) {
-        std::cerr << "Could not open file" << std::endl;
-        exit(1);
+    AssetFile file;
+    if (!file.open(filePath)) {
+        throw std::runtime_error(std::string("Could not open ") + filePath);
+    }
+    if (file.size() % sizeof(uint32_t) != 0) {
+        throw std::runtime_error(std::string(filePath) + " isn't SPIR-V");
     }
 
-    size_t fileSize = (size_t)file.tellg();
-
-    std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
-
-    file.seekg(0);
-    file.read((char*)buffer.data(), fileSize);
-    file.close();
-
+    // mappings and pack entries are both aligned enough to hand over as they are
     VkShaderModuleCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     createInfo.pNext = nullptr;
-    createInfo.codeSize = buffer.size() * sizeof(uint32_t);
-    createInfo.pCode = buffer.data();
+    createInfo.codeSize = file.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(file.data());
 
     VkShaderModule shaderModule;
     VK_CHECK(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule));
@@ -633,6 +1017,11 @@ VkShaderModule Base::loadShader(VkDevice device, const char *filePath) {
 Base::~Base() {
     vkDeviceWaitIdle(device);
 
+    textureStreamer.shutdown();
+    virtualTextures.shutdown();
+    uploads.shutdown();
+    mipGenerator.destroy();
+    bindlessTextures.destroy();
 
     for (auto& frame : frames) {
         vkDestroyFence(device, frame.renderFence, nullptr);
@@ -641,10 +1030,24 @@ Base::~Base() {
         frame._frameDescriptors.destroyPools(device);
     }
 
+    if (headless) {
+        vkDestroyImageView(device, headlessTarget.imageView, nullptr);
+        destroyAllocatedImage(headlessTarget.image, headlessTarget.allocation);
+    }
+
+    memoryTelemetry.reportLeaks();
     vmaDestroyAllocator(allocator);
 
-    vkDestroyFence(device, immFence, nullptr);
-    vkDestroyCommandPool(device, immCommandPool, nullptr);
+    gpuProfiler.destroy();
+
+    // before the job system goes, something may still be compiling
+    pipelineCompiler.destroy();
+
+    vfs::setParallelFor(nullptr);
+    jobs.shutdown();
+
+    // every pipeline is built by now, the apps destroy theirs before this runs
+    pipelineCache.destroy();
 
     vkDestroyCommandPool(device, commandPool, nullptr);
 
@@ -652,7 +1055,11 @@ Base::~Base() {
     destroyDebugMessenger(instance, debugMessenger);
     vkDestroyInstance(instance, nullptr);
 
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+
+    trace::flush();
 }
 
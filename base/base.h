@@ -6,8 +6,21 @@
 #include "swapchain.h"
 #include "../tools/types.h"
 #include "../tools/camera.h"
+#include "../tools/trace.h"
+#include "../tools/memoryTelemetry.h"
+#include "../tools/jobSystem.h"
+#include "../tools/uploadQueue.h"
+#include "../tools/bindlessTextures.h"
+#include "../tools/textureStreamer.h"
+#include "../tools/transformHierarchy.h"
+#include "../tools/mipGenerator.h"
+#include "../tools/pipelineCache.h"
+#include "../tools/pipelineCompiler.h"
+#include "../tools/virtualTexture.h"
 #include <vk_mem_alloc.h>
 
+struct MeshOptimizeSettings;
+
 
 class Base {
 private:
@@ -19,9 +32,16 @@ private:
     void createCommandPool();
     virtual void createCommandBuffers();
     void initFrameData();
-    void initImmStructures();
+    void initUploadQueue();
+    void initBindlessTextures();
+    void initTextureStreamer();
+    void initPipelineCache();
+    void initPipelineCompiler();
+    void initMipGenerator();
+    void initHeadlessTarget();
 
     bool initialized { false };
+    bool closeRequested { false };
 
 protected:
     VkInstance                   instance       { VK_NULL_HANDLE };
@@ -32,7 +52,12 @@ protected:
     VkDevice                     device         { VK_NULL_HANDLE };
     VkQueue                      graphicsQueue  { VK_NULL_HANDLE };
     VkQueue                      presentQueue   { VK_NULL_HANDLE };
-    GLFWwindow*                  window;
+    VkQueue                      transferQueue  { VK_NULL_HANDLE };
+    GLFWwindow*                  window         { nullptr };
+    // IDK_HEADLESS=1: no window, no surface, no swapchain. frames render into headlessTarget
+    // and nothing presents, so automation runs without a display server
+    bool                         headless       { false };
+    AllocatedImage               headlessTarget {};
     VmaAllocator                 allocator;
     Camera                       camera;
 
@@ -43,17 +68,37 @@ protected:
 
     FrameData                    frames[MAX_FRAMES];
 
-    VkCommandPool                immCommandPool;
-    VkCommandBuffer              immCommandBuffer;
-    VkFence                      immFence;
+    JobSystem                    jobs;
+    UploadQueue                  uploads;
+    BindlessTextures             bindlessTextures;
+    TextureStreamer              textureStreamer;
+    MipGenerator                 mipGenerator;
+    PipelineCache                pipelineCache;      // pass handle() to every vkCreate*Pipelines
+    PipelineCompiler             pipelineCompiler;
+    VirtualTextures              virtualTextures;    // only set up by apps that call initVirtualTextures()
+    std::mutex                   graphicsQueueMutex;
 
     AllocatedBuffer              vertexBuffer;
     AllocatedBuffer              indexBuffer;
     uint32_t                     indexCount;
+    VkIndexType                  indexType      { VK_INDEX_TYPE_UINT32 };
+    VertexFormat                 vertexFormat   { VertexFormat::Full };
+    glm::vec4                    vertexScale    { 1.0f };  // dequantization for VertexFormat::Packed
+    glm::vec4                    vertexOffset   { 0.0f };
+
+    // what loadModel keeps besides the buffers. an obj is one surface without a material
+    std::vector<MeshSurface>     modelSurfaces;
+    std::vector<Material>        modelMaterials;
+    std::vector<std::string>     modelMaterialTextures;  // base color image per material, empty without one
+    // the surfaces' nodes, an obj has one at identity. a GPU copy per frame in flight
+    TransformHierarchy           modelNodes     { MAX_FRAMES };
 
     VkImageLayout                depthImageLayout;
     AllocatedImage               depthImage;
 
+    trace::GpuProfiler           gpuProfiler;
+    MemoryTelemetry              memoryTelemetry;
+
     VkPipelineStageFlags         submitPipelineStages { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 
     std::vector<VkCommandBuffer> drawCommandBuffers {};
@@ -64,14 +109,31 @@ protected:
 
     VkShaderModule loadShader(VkDevice device, const char *filePath);
     MeshBuffers loadMesh(std::span<uint32_t> indices, std::span<Vertex> vertices);
+    // .gltf/.glb through GLTFLoader, anything else as obj
+    void loadModel(const char *filePath);
     void loadObj(const char *filePath);
-    AllocatedImage loadTextureImage(const char *filePath);
+    void loadGltf(const char *filePath);
+    ObjMeshData parseObj(const char *filePath);
+    // gets the optimize settings, null when IDK_MESH_OPTIMIZE=0
+    using MeshParser = std::function<ObjMeshData(const MeshOptimizeSettings* optimize)>;
+    void cookMesh(const char *filePath, uint64_t sourceHash, uint64_t sourceSize, const MeshParser& parse);
+    void uploadMeshData(std::span<const std::byte> vertexBytes, std::span<const std::byte> indexBytes, VkIndexType type,
+                        const char *name);
+    // fill writes the vertices and the indices straight into staging
+    using MeshDataFill = std::function<void(std::byte* vertexDst, std::byte* indexDst)>;
+    void uploadMeshData(size_t vertexBytes, size_t indexBytes, VkIndexType type, const char *name, const MeshDataFill& fill);
+    AllocatedImage loadTextureImage(const char *filePath, MipMode mipMode = MipMode::Default);
     void createMipmaps(VkCommandBuffer cmd, VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
     virtual void beginCommands(VkCommandBuffer cmd, VkImageView swapchainImageView);
     virtual void endCommands(VkCommandBuffer cmd);
     virtual void updatePerFrameData(uint32_t frameIndex);
     void initCamera(float x, float y, float z);
     void initDepthImage();
+    void initVirtualTextures();
+
+    // the window's close button, or requestClose() when headless
+    bool shouldClose() const;
+    void requestClose();
 
 public:
     Swapchain swapchain;
@@ -80,8 +142,11 @@ public:
     virtual ~Base();
 
     bool isInitialized() const { return initialized; }
-    AllocatedImage  createAllocatedImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false);
-    AllocatedBuffer createAllocatedBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+    AllocatedImage  createAllocatedImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false,
+                                         MemoryCategory category = MemoryCategory::Other, const char* name = nullptr,
+                                         VkImageCreateFlags flags = 0);
+    AllocatedBuffer createAllocatedBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                          MemoryCategory category = MemoryCategory::Other, const char* name = nullptr);
 
     void destroyAllocatedImage(VkImage image, VmaAllocation allocation);
     void destroyAllocatedBuffer(VkBuffer buffer, VmaAllocation allocation);
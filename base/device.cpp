@@ -2,17 +2,21 @@
 
 #include <iostream>
 #include <set>
+#include <cstring>
 #include <stdexcept>
 
 #include "../tools/debug.h"
+#include "../tools/settings.h"
 #include "../tools/utils.h"
 
-static std::vector<const char*> getRequiredExtensions() {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+static std::vector<const char*> getRequiredExtensions(bool headless) {
+    std::vector<const char*> extensions;
+    if (!headless) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
 #ifndef NDEBUG
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -21,7 +25,7 @@ static std::vector<const char*> getRequiredExtensions() {
     return extensions;
 }
 
-VkInstance createInstance() {
+VkInstance createInstance(bool headless) {
     VkApplicationInfo appInfo = { VK_STRUCTURE_TYPE_APPLICATION_INFO };
     appInfo.apiVersion = API_VERSION;
 
@@ -37,7 +41,7 @@ VkInstance createInstance() {
     createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*) &debugCreateInfo;
 #endif
 
-    auto extensions = getRequiredExtensions();
+    auto extensions = getRequiredExtensions(headless);
     createInfo.ppEnabledExtensionNames = extensions.data();
     createInfo.enabledExtensionCount = std::size(extensions);
 
@@ -89,7 +93,11 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice, VkSurfaceK
         }
 
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+        if (surface != VK_NULL_HANDLE) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+        } else {
+            presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        }
         if (queueFamily.queueCount > 0 && presentSupport) {
             indices.presentFamily = i;
             indices.presentFamilyHasValue = true;
@@ -101,12 +109,31 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice, VkSurfaceK
         i++;
     }
 
+    // prefer a transfer-only family, otherwise any non-graphics one that can copy
+    for (int pass = 0; pass < 2 && !indices.transferFamilyHasValue; pass++) {
+        for (uint32_t family = 0; family < queueFamilyCount; family++) {
+            VkQueueFlags flags = queueFamilies[family].queueFlags;
+            if (queueFamilies[family].queueCount == 0 || !(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+                continue;
+            }
+            if (pass == 0 && (flags & VK_QUEUE_COMPUTE_BIT)) {
+                continue;
+            }
+            indices.transferFamily = family;
+            indices.transferFamilyHasValue = true;
+            break;
+        }
+    }
+
     return indices;
 }
 
-VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice, QueueFamilyIndices indices) {
+VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice, QueueFamilyIndices indices, bool presents) {
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+    if (indices.transferFamilyHasValue) {
+        uniqueQueueFamilies.insert(indices.transferFamily);
+    }
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -118,30 +145,67 @@ VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice, QueueFamilyIndices
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
-    const char* deviceExtensions[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    std::vector<const char*> deviceExtensions;
+    if (presents) {
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
+    if (isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    // tools/pipelineCompiler links variants out of shared libraries with it
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT };
+    bool pipelineLibrary = useGraphicsPipelineLibrary(physicalDevice);
+    if (pipelineLibrary) {
+        deviceExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+        pipelineLibraryFeatures.graphicsPipelineLibrary = true;
+    }
 
     VkPhysicalDeviceVulkan13Features features13 { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES };
     features13.dynamicRendering = true;
     features13.synchronization2 = true;
+    features13.pNext = pipelineLibrary ? &pipelineLibraryFeatures : nullptr;
 
     VkPhysicalDeviceVulkan12Features features12 {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
     features12.bufferDeviceAddress = true;
     features12.descriptorIndexing = true;
+    // tools/bindlessTextures
+    features12.runtimeDescriptorArray = true;
+    features12.descriptorBindingPartiallyBound = true;
+    features12.descriptorBindingSampledImageUpdateAfterBind = true;
+    features12.shaderSampledImageArrayNonUniformIndexing = true;
     features12.drawIndirectCount = true;
+    features12.timelineSemaphore = true;
     features12.pNext = &features13;
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+    // every material bucket's indirect draw starts at its own firstInstance in the binned instances
+    if (!supportedFeatures.drawIndirectFirstInstance) {
+        throw std::runtime_error("drawIndirectFirstInstance is not supported, material binning needs it");
+    }
+
     VkPhysicalDeviceFeatures2 features2 { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
     features2.features.multiDrawIndirect = true;
+    features2.features.drawIndirectFirstInstance = true;
     features2.features.samplerAnisotropy = true;
     features2.features.sampleRateShading = true;
+    features2.features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+    features2.features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    // the overdraw counters and the virtual texture feedback write from fragment shaders
+    features2.features.fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics;
     features2.pNext = &features12;
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(std::size(deviceExtensions));
-    createInfo.ppEnabledExtensionNames = deviceExtensions;
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
     createInfo.pNext = &features2;
 
     VkDevice device { VK_NULL_HANDLE };
@@ -150,3 +214,35 @@ VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice, QueueFamilyIndices
     return device;
 }
 
+
+bool useGraphicsPipelineLibrary(VkPhysicalDevice physicalDevice) {
+    if (!envFlag("IDK_PIPELINE_LIBRARY", true) ||
+        !isDeviceExtensionSupported(physicalDevice, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) ||
+        !isDeviceExtensionSupported(physicalDevice, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+        return false;
+    }
+
+    // some drivers list the extension without the feature
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT };
+    VkPhysicalDeviceFeatures2 features { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+    features.pNext = &pipelineLibraryFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    return pipelineLibraryFeatures.graphicsPipelineLibrary;
+}
+
+bool isDeviceExtensionSupported(VkPhysicalDevice physicalDevice, const char* extensionName) {
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+    for (const auto& extension : extensions) {
+        if (strcmp(extension.extensionName, extensionName) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -7,7 +7,12 @@
 
 #define API_VERSION VK_API_VERSION_1_4
 
-VkInstance createInstance();
+// headless skips the window system extensions, there's no surface to make
+VkInstance createInstance(bool headless = false);
 VkPhysicalDevice choosePhysicalDevice(VkInstance instance);
+// without a surface the graphics family doubles as the present family, nothing presents anyway
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
-VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice, QueueFamilyIndices indices);
\ No newline at end of file
+VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice, QueueFamilyIndices indices, bool presents = true);
+bool isDeviceExtensionSupported(VkPhysicalDevice physicalDevice, const char* extensionName);
+// VK_EXT_graphics_pipeline_library, unless IDK_PIPELINE_LIBRARY=0. createLogicalDevice enables it when this is true
+bool useGraphicsPipelineLibrary(VkPhysicalDevice physicalDevice);
\ No newline at end of file
@@ -0,0 +1,183 @@
+// reading a whole pack into one destination buffer the way the mesh cache reads into
+// staging: raw against LZ4 compressed, one thread against all of them, cold and warm
+// page cache. cold needs the kernel to drop the pages (linux, posix_fadvise), anywhere
+// else it reports warm twice. the slow disk rows add the time to read the stored bytes
+// at that speed to the warm time, which is what a disk slower than the decompressor sees.
+//
+//   packBench [threads] <file or directory>...
+
+#include "../tools/packWriter.h"
+#include "../tools/vfs.h"
+#include "../tools/hash.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// a fresh set of threads per call, the entries big enough to have chunks to split pay for that
+static ParallelFor threadParallelFor(uint32_t threadCount) {
+    return [threadCount](uint32_t count, const std::function<void(uint32_t, uint32_t)>& function) {
+        std::atomic<uint32_t> next { 0 };
+        auto worker = [&] {
+            for (uint32_t i = next++; i < count; i = next++) {
+                function(i, i + 1);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (uint32_t i = 1; i < std::min(threadCount, count); i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+}
+
+static bool dropPageCache(const std::string& path) {
+#if defined(__linux__) && defined(POSIX_FADV_DONTNEED)
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    fdatasync(fd);
+    bool dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return dropped;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+struct ReadResult {
+    double   ms       { 0.0 };
+    uint64_t checksum { 0 };
+    bool     valid    { true };
+};
+
+static ReadResult readPack(const std::string& packPath, const std::vector<PackInput>& inputs, bool cold) {
+    if (cold) {
+        dropPageCache(packPath);
+    }
+
+    ReadResult result;
+    auto start = std::chrono::steady_clock::now();
+    if (!vfs::mount(packPath.c_str())) {
+        result.valid = false;
+        return result;
+    }
+
+    std::vector<uint8_t> destination;
+    for (const PackInput& input : inputs) {
+        AssetFile file;
+        if (!file.open(input.key.c_str(), false) || !file.isPacked()) {
+            result.valid = false;
+            continue;
+        }
+        destination.resize(std::max(destination.size(), file.size()));
+        if (!file.readInto(destination.data(), 0, file.size())) {
+            result.valid = false;
+            continue;
+        }
+        result.checksum ^= hash64(destination.data(), file.size());
+    }
+    vfs::unmount();
+
+    result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int first = 1;
+    uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 1 && std::atoi(argv[1]) > 0) {
+        threadCount = static_cast<uint32_t>(std::atoi(argv[1]));
+        first++;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "usage: packBench [threads] <file or directory>...\n");
+        return 1;
+    }
+
+    std::vector<PackInput> inputs;
+    for (int i = first; i < argc; i++) {
+        if (!collectPackInputs(argv[i], inputs)) {
+            fprintf(stderr, "packBench: %s doesn't exist\n", argv[i]);
+            return 1;
+        }
+    }
+
+    std::string rawPath = (fs::temp_directory_path() / "packBench-raw.pak").string();
+    std::string lz4Path = (fs::temp_directory_path() / "packBench-lz4.pak").string();
+    PackStats rawStats, lz4Stats;
+    auto packStart = std::chrono::steady_clock::now();
+    if (!writePack(rawPath.c_str(), inputs, false, &rawStats)) {
+        return 1;
+    }
+    auto packEnd = std::chrono::steady_clock::now();
+    if (!writePack(lz4Path.c_str(), inputs, true, &lz4Stats)) {
+        return 1;
+    }
+    auto compressEnd = std::chrono::steady_clock::now();
+
+    double mb = rawStats.bytes / (1024.0 * 1024.0);
+    printf("%llu files, %.1f MB, lz4 %.1f MB (%.2fx, %llu entries compressed), %u threads\n",
+           static_cast<unsigned long long>(rawStats.files), mb, lz4Stats.storedBytes / (1024.0 * 1024.0),
+           double(rawStats.bytes) / std::max<uint64_t>(lz4Stats.storedBytes, 1),
+           static_cast<unsigned long long>(lz4Stats.compressed), threadCount);
+    printf("packing %.1f ms raw, %.1f ms lz4\n", std::chrono::duration<double, std::milli>(packEnd - packStart).count(),
+           std::chrono::duration<double, std::milli>(compressEnd - packEnd).count());
+
+    struct Row {
+        const char*        name;
+        const std::string* path;
+        const PackStats*   stats;
+        uint32_t           threads;
+    };
+    const Row rows[] = {
+        { "raw",          &rawPath, &rawStats, 1 },
+        { "raw, threads", &rawPath, &rawStats, threadCount },
+        { "lz4",          &lz4Path, &lz4Stats, 1 },
+        { "lz4, threads", &lz4Path, &lz4Stats, threadCount },
+    };
+
+    bool allValid = true;
+    uint64_t expected = 0;
+    bool haveExpected = false;
+    printf("%-16s %10s %10s %10s %14s %14s\n", "", "cold ms", "warm ms", "warm MB/s", "100 MB/s disk", "500 MB/s disk");
+    for (const Row& row : rows) {
+        vfs::setParallelFor(row.threads > 1 ? threadParallelFor(row.threads) : nullptr);
+        ReadResult cold = readPack(*row.path, inputs, true);
+        ReadResult warm = readPack(*row.path, inputs, false);
+
+        if (!haveExpected) {
+            expected = warm.checksum;
+            haveExpected = true;
+        }
+        bool valid = cold.valid && warm.valid && cold.checksum == expected && warm.checksum == expected;
+        allValid = allValid && valid;
+
+        auto modeled = [&](double diskMBs) { return row.stats->storedBytes / (diskMBs * 1024.0 * 1024.0) * 1000.0 + warm.ms; };
+        printf("%-16s %10.1f %10.1f %10.1f %14.1f %14.1f  %s\n", row.name, cold.ms, warm.ms, mb / (warm.ms / 1000.0),
+               modeled(100.0), modeled(500.0), valid ? "ok" : "MISMATCH");
+    }
+    vfs::setParallelFor(nullptr);
+
+    fs::remove(rawPath);
+    fs::remove(lz4Path);
+    return allValid ? 0 : 1;
+}
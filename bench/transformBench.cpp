@@ -0,0 +1,183 @@
+// world matrices for an animated scene: the old node tree that walks the parent chain
+// per query against TransformHierarchy's flattened arrays, full and partial updates.
+//
+//   transformBench [thousand nodes] [percent animated]
+
+#include "../tools/transformHierarchy.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+struct Mat4 {
+    float m[16];
+};
+
+Mat4 multiply(const Mat4& a, const Mat4& b) {
+    Mat4 r {};
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+            }
+            r.m[column * 4 + row] = sum;
+        }
+    }
+    return r;
+}
+
+struct Trs {
+    float t[3];
+    float r[4];
+    float s[3];
+};
+
+Mat4 compose(const Trs& trs) {
+    float x = trs.r[0], y = trs.r[1], z = trs.r[2], w = trs.r[3];
+    Mat4 m {};
+    m.m[0] = (1 - 2 * (y * y + z * z)) * trs.s[0];
+    m.m[1] = 2 * (x * y + w * z) * trs.s[0];
+    m.m[2] = 2 * (x * z - w * y) * trs.s[0];
+    m.m[4] = 2 * (x * y - w * z) * trs.s[1];
+    m.m[5] = (1 - 2 * (x * x + z * z)) * trs.s[1];
+    m.m[6] = 2 * (y * z + w * x) * trs.s[1];
+    m.m[8] = 2 * (x * z + w * y) * trs.s[2];
+    m.m[9] = 2 * (y * z - w * x) * trs.s[2];
+    m.m[10] = (1 - 2 * (x * x + y * y)) * trs.s[2];
+    m.m[12] = trs.t[0];
+    m.m[13] = trs.t[1];
+    m.m[14] = trs.t[2];
+    m.m[15] = 1;
+    return m;
+}
+
+// what GLTFLoader::Node used to be
+struct TreeNode {
+    TreeNode* parent = nullptr;
+    std::vector<std::unique_ptr<TreeNode>> children;
+    Mat4 matrix;
+
+    Mat4 getWorldMatrix() const {
+        Mat4 m = matrix;
+        for (TreeNode* p = parent; p; p = p->parent) {
+            m = multiply(p->matrix, m);
+        }
+        return m;
+    }
+};
+
+Trs randomTrs(std::mt19937& rng) {
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    Trs trs;
+    float q[4] = { unit(rng), unit(rng), unit(rng), unit(rng) };
+    float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (int i = 0; i < 4; i++) {
+        trs.r[i] = q[i] / length;
+    }
+    for (int i = 0; i < 3; i++) {
+        trs.t[i] = unit(rng) * 10.0f;
+        trs.s[i] = 1.0f + unit(rng) * 0.1f;
+    }
+    return trs;
+}
+
+template<typename F>
+double milliseconds(F&& f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    uint32_t nodeCount = static_cast<uint32_t>((argc > 1 ? std::atof(argv[1]) : 50.0) * 1000.0);
+    double animated = (argc > 2 ? std::atof(argv[2]) : 10.0) / 100.0;
+
+    std::mt19937 rng(7);
+
+    // random forest, parents always earlier so both sides see the same scene
+    std::vector<uint32_t> parents(nodeCount);
+    std::vector<Trs> locals(nodeCount);
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        parents[i] = (i < 16) ? TransformHierarchy::noParent : static_cast<uint32_t>(rng() % i);
+        locals[i] = randomTrs(rng);
+    }
+
+    std::vector<std::unique_ptr<TreeNode>> roots;
+    std::vector<TreeNode*> treeNodes(nodeCount);
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        auto node = std::make_unique<TreeNode>();
+        node->matrix = compose(locals[i]);
+        treeNodes[i] = node.get();
+        if (parents[i] == TransformHierarchy::noParent) {
+            roots.push_back(std::move(node));
+        } else {
+            node->parent = treeNodes[parents[i]];
+            treeNodes[parents[i]]->children.push_back(std::move(node));
+        }
+    }
+
+    TransformHierarchy hierarchy;
+    hierarchy.reserve(nodeCount);
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        uint32_t node = hierarchy.add(parents[i]);
+        hierarchy.setTranslation(node, locals[i].t[0], locals[i].t[1], locals[i].t[2]);
+        hierarchy.setRotation(node, locals[i].r[0], locals[i].r[1], locals[i].r[2], locals[i].r[3]);
+        hierarchy.setScale(node, locals[i].s[0], locals[i].s[1], locals[i].s[2]);
+    }
+
+    std::vector<Mat4> treeWorlds(nodeCount);
+    double treeMs = milliseconds([&] {
+        for (uint32_t i = 0; i < nodeCount; i++) {
+            treeWorlds[i] = treeNodes[i]->getWorldMatrix();
+        }
+    });
+    double fullMs = milliseconds([&] { hierarchy.update(); });
+
+    float maxError = 0.0f;
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        const float* world = hierarchy.world(i);
+        for (int k = 0; k < 16; k++) {
+            float scale = std::max(1.0f, std::fabs(treeWorlds[i].m[k]));
+            maxError = std::max(maxError, std::fabs(world[k] - treeWorlds[i].m[k]) / scale);
+        }
+    }
+
+    // a frame of animation: move some nodes, everything under them follows
+    uint32_t moved = static_cast<uint32_t>(nodeCount * animated);
+    std::vector<uint32_t> movedNodes(moved);
+    for (uint32_t& node : movedNodes) {
+        node = rng() % nodeCount;
+    }
+
+    double treeFrameMs = milliseconds([&] {
+        for (uint32_t node : movedNodes) {
+            treeNodes[node]->matrix.m[12] += 1.0f;
+        }
+        for (uint32_t i = 0; i < nodeCount; i++) {
+            treeWorlds[i] = treeNodes[i]->getWorldMatrix();
+        }
+    });
+
+    uint32_t updated = 0;
+    double frameMs = milliseconds([&] {
+        for (uint32_t node : movedNodes) {
+            locals[node].t[0] += 1.0f;
+            hierarchy.setTranslation(node, locals[node].t[0], locals[node].t[1], locals[node].t[2]);
+        }
+        updated = hierarchy.update();
+    });
+
+    std::vector<float> gpu(static_cast<size_t>(nodeCount) * 16);
+    size_t written = hierarchy.writeWorlds(0, gpu.data());
+
+    printf("%u nodes, %u moved, %u worlds recomputed, max relative error %g\n", nodeCount, moved, updated, maxError);
+    printf("  tree walk per node   %8.3f ms   animated frame %8.3f ms\n", treeMs, treeFrameMs);
+    printf("  flattened update     %8.3f ms   animated frame %8.3f ms\n", fullMs, frameMs);
+    printf("  gpu copy             %8.2f MB\n", written / (1024.0 * 1024.0));
+    return 0;
+}
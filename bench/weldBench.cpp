@@ -0,0 +1,168 @@
+// vertex welding throughput: the old unordered_map dedup from loadObj against
+// VertexWelder, single threaded and sharded.
+//
+//   weldBench [million corners] [shards]
+
+#include "../tools/weld.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+// same layout as Vertex without pulling in glm/vulkan
+struct BenchVertex {
+    float position[3];
+    float uv_x;
+    float normal[3];
+    float uv_y;
+    float color[3];
+    float pad;
+
+    bool operator==(const BenchVertex& other) const {
+        return memcmp(this, &other, sizeof(BenchVertex)) == 0;
+    }
+};
+
+// stands in for JobSystem::parallelFor, which would pull the engine's tracing in
+static ParallelFor threadParallelFor(uint32_t threadCount) {
+    return [threadCount](uint32_t count, const std::function<void(uint32_t, uint32_t)>& function) {
+        std::atomic<uint32_t> next { 0 };
+        auto worker = [&] {
+            for (uint32_t i = next++; i < count; i = next++) {
+                function(i, i + 1);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (uint32_t i = 1; i < std::min(threadCount, count); i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+}
+
+// the hash_combine over std::hash<float> from utils.h
+struct LegacyHash {
+    size_t operator()(const BenchVertex& v) const noexcept {
+        auto vec3 = [](const float* f) {
+            size_t h1 = std::hash<float>()(f[0]);
+            size_t h2 = std::hash<float>()(f[1]);
+            size_t h3 = std::hash<float>()(f[2]);
+            return ((h1 ^ (h2 << 1)) >> 1) ^ (h3 << 1);
+        };
+        size_t seed = 0;
+        seed ^= vec3(v.position) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        seed ^= std::hash<float>()(v.uv_x) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        seed ^= vec3(v.normal) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        seed ^= std::hash<float>()(v.uv_y) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        seed ^= vec3(v.color) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        return seed;
+    }
+};
+
+// a grid of quads split into shards, each interior vertex is shared by 6 corners
+// like a typical smooth mesh. corners are shuffled per shard so the table sees
+// realistic access order instead of a perfectly sequential one.
+static std::vector<BenchVertex> makeCorners(size_t targetCorners, uint32_t shardCount, std::vector<WeldRange>& shards) {
+    size_t quads = targetCorners / 6;
+    uint32_t side = static_cast<uint32_t>(std::sqrt(double(quads))) + 1;
+
+    auto vertexAt = [side](uint32_t x, uint32_t y) {
+        BenchVertex v {};
+        v.position[0] = float(x);
+        v.position[2] = float(y);
+        v.uv_x = float(x) / side;
+        v.uv_y = float(y) / side;
+        v.normal[1] = 1.0f;
+        v.color[0] = v.color[1] = v.color[2] = 1.0f;
+        return v;
+    };
+
+    std::vector<BenchVertex> corners;
+    corners.reserve(size_t(side) * side * 6);
+
+    std::mt19937 rng(1234);
+    uint32_t rowsPerShard = (side + shardCount - 1) / shardCount;
+    for (uint32_t y0 = 0; y0 < side; y0 += rowsPerShard) {
+        size_t first = corners.size();
+        for (uint32_t y = y0; y < std::min(side, y0 + rowsPerShard); y++) {
+            for (uint32_t x = 0; x < side; x++) {
+                corners.push_back(vertexAt(x, y));
+                corners.push_back(vertexAt(x + 1, y));
+                corners.push_back(vertexAt(x, y + 1));
+                corners.push_back(vertexAt(x + 1, y));
+                corners.push_back(vertexAt(x + 1, y + 1));
+                corners.push_back(vertexAt(x, y + 1));
+            }
+        }
+
+        // shuffle whole triangles to keep winding intact
+        size_t triangles = (corners.size() - first) / 3;
+        for (size_t t = triangles - 1; t > 0; t--) {
+            size_t other = std::uniform_int_distribution<size_t>(0, t)(rng);
+            for (int c = 0; c < 3; c++) {
+                std::swap(corners[first + t * 3 + c], corners[first + other * 3 + c]);
+            }
+        }
+        shards.push_back({ first, corners.size() - first });
+    }
+    return corners;
+}
+
+template<typename F>
+static double timeMs(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    double millions = argc > 1 ? std::atof(argv[1]) : 6.0;
+    uint32_t shardCount = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 16;
+
+    std::vector<WeldRange> shards;
+    std::vector<BenchVertex> corners = makeCorners(size_t(millions * 1e6), shardCount, shards);
+    printf("%zu corners, %zu shards, %u threads\n", corners.size(), shards.size(), std::thread::hardware_concurrency());
+
+    std::vector<BenchVertex> legacyVertices;
+    std::vector<uint32_t> legacyIndices;
+    double legacyMs = timeMs([&] {
+        std::unordered_map<BenchVertex, uint32_t, LegacyHash> uniqueVertices;
+        for (const auto& vertex : corners) {
+            if (!uniqueVertices.contains(vertex)) {
+                uniqueVertices[vertex] = static_cast<uint32_t>(legacyVertices.size());
+                legacyVertices.push_back(vertex);
+            }
+            legacyIndices.push_back(uniqueVertices[vertex]);
+        }
+    });
+
+    std::vector<BenchVertex> vertices;
+    std::vector<uint32_t> indices;
+    WeldRange whole { 0, corners.size() };
+    double singleMs = timeMs([&] {
+        weldVertices<BenchVertex>(corners, std::span(&whole, 1), vertices, indices);
+    });
+    bool singleMatches = vertices.size() == legacyVertices.size() && indices == legacyIndices;
+
+    double shardedMs = timeMs([&] {
+        weldVertices<BenchVertex>(corners, shards, vertices, indices,
+                                  threadParallelFor(std::max(1u, std::thread::hardware_concurrency())));
+    });
+    bool shardedMatches = vertices.size() == legacyVertices.size() && indices == legacyIndices;
+
+    auto rate = [&](double ms) { return corners.size() / ms / 1e3; };
+    printf("%-24s %10.1f ms %8.1f Mcorners/s\n", "unordered_map", legacyMs, rate(legacyMs));
+    printf("%-24s %10.1f ms %8.1f Mcorners/s  %s\n", "welder", singleMs, rate(singleMs), singleMatches ? "ok" : "MISMATCH");
+    printf("%-24s %10.1f ms %8.1f Mcorners/s  %s\n", "welder sharded", shardedMs, rate(shardedMs), shardedMatches ? "ok" : "MISMATCH");
+    printf("%zu unique vertices\n", legacyVertices.size());
+
+    return singleMatches && shardedMatches ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+// writes the asset pack vfs::mount reads. every file under the given paths goes in,
+// keyed by the normalized path as given, so pack from where the engine runs:
+//
+//   cd build && idkpack idk.pak ../assets ../shaders
+//
+// -c compresses entries with LZ4 where that saves anything worth having, for slow
+// disks. without it every entry is used straight from the mapping.
+//
+// the shaders have to be compiled first, the pack only takes what's on disk.
+
+#include "../tools/packWriter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    bool compress = false;
+    int first = 1;
+    if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+        compress = true;
+        first++;
+    }
+    if (argc - first < 2) {
+        fprintf(stderr, "usage: idkpack [-c] <out.pak> <file or directory>...\n");
+        return 1;
+    }
+
+    std::vector<PackInput> inputs;
+    for (int i = first + 1; i < argc; i++) {
+        if (!collectPackInputs(argv[i], inputs)) {
+            fprintf(stderr, "idkpack: %s doesn't exist\n", argv[i]);
+            return 1;
+        }
+    }
+
+    const char* outPath = argv[first];
+    PackStats stats;
+    if (!writePack(outPath, inputs, compress, &stats)) {
+        return 1;
+    }
+
+    printf("%s: %llu files, %.2f MB", outPath, static_cast<unsigned long long>(stats.files), stats.bytes / (1024.0 * 1024.0));
+    if (compress) {
+        printf(", %.2f MB stored, %llu compressed", stats.storedBytes / (1024.0 * 1024.0),
+               static_cast<unsigned long long>(stats.compressed));
+    }
+    printf("\n");
+    return 0;
+}
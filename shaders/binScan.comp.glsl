@@ -0,0 +1,81 @@
+#version 450
+
+// second binning pass, one workgroup: exclusive prefix sum over the bucket counts
+// cull.comp.glsl left behind. each bucket becomes one indirect draw whose firstInstance
+// is where its instances start in the binned buffer, binScatter reads it back from there.
+// empty buckets still get a command, with instanceCount 0 the GPU skips it.
+
+layout(local_size_x = 256) in;
+
+struct DrawIndexedIndirectCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(set = 0, binding = 2) writeonly buffer IndirectCommands {
+    DrawIndexedIndirectCommand commands[];
+} indirectCommands;
+
+layout(set = 0, binding = 5) readonly buffer BucketCounts {
+    uint counts[];
+} bucketCounts;
+
+// GpuBucket in types.h, the index range every instance in the bucket draws
+struct Bucket {
+    uint firstIndex;
+    uint indexCount;
+};
+
+layout(set = 0, binding = 8) readonly buffer Buckets {
+    Bucket buckets[];
+} bucketBuffer;
+
+// BinningPushConstants in types.h
+layout(push_constant) uniform PushConstants {
+    uint instanceCount;
+    uint bucketCount;
+} pushConstants;
+
+shared uint partialSums[gl_WorkGroupSize.x];
+
+void main() {
+    uint local = gl_LocalInvocationIndex;
+
+    // every invocation sums a run of neighbouring buckets
+    uint perInvocation = (pushConstants.bucketCount + gl_WorkGroupSize.x - 1) / gl_WorkGroupSize.x;
+    uint begin = min(local * perInvocation, pushConstants.bucketCount);
+    uint end = min(begin + perInvocation, pushConstants.bucketCount);
+
+    uint sum = 0;
+    for (uint b = begin; b < end; b++) {
+        sum += bucketCounts.counts[b];
+    }
+    partialSums[local] = sum;
+    barrier();
+
+    // inclusive scan of the runs
+    for (uint offset = 1; offset < gl_WorkGroupSize.x; offset *= 2) {
+        uint add = local >= offset ? partialSums[local - offset] : 0;
+        barrier();
+        partialSums[local] += add;
+        barrier();
+    }
+
+    uint running = partialSums[local] - sum;
+    for (uint b = begin; b < end; b++) {
+        uint count = bucketCounts.counts[b];
+
+        DrawIndexedIndirectCommand command;
+        command.indexCount = bucketBuffer.buckets[b].indexCount;
+        command.instanceCount = count;
+        command.firstIndex = bucketBuffer.buckets[b].firstIndex;
+        command.vertexOffset = 0;
+        command.firstInstance = running;
+        indirectCommands.commands[b] = command;
+
+        running += count;
+    }
+}
@@ -0,0 +1,73 @@
+#version 450
+
+// last binning pass: copies every visible instance to its bucket's offset plus the rank
+// cull.comp.glsl gave it. the mesh pass reads the binned copy as its instance buffer, so
+// a bucket's draw finds its instances at firstInstance onwards.
+
+// same size as cull.comp.glsl, the dispatch is shared
+layout(local_size_x = 128, local_size_x_id = 0) in;
+
+struct InstanceData {
+    vec3 position;
+    float scale;
+    uint surface;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+layout(set = 0, binding = 1) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+} instanceBuffer;
+
+struct DrawIndexedIndirectCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(set = 0, binding = 2) readonly buffer IndirectCommands {
+    DrawIndexedIndirectCommand commands[];
+} indirectCommands;
+
+// GpuSurface in types.h
+struct Surface {
+    uint material;
+    uint node;
+    uint bucket;
+    uint pad;
+};
+
+layout(set = 0, binding = 4) readonly buffer SurfaceBuffer {
+    Surface surfaces[];
+} surfaceBuffer;
+
+layout(set = 0, binding = 6) readonly buffer InstanceRanks {
+    uint ranks[];
+} instanceRanks;
+
+layout(set = 0, binding = 7) writeonly buffer BinnedInstances {
+    InstanceData instances[];
+} binnedInstances;
+
+// BinningPushConstants in types.h
+layout(push_constant) uniform PushConstants {
+    uint instanceCount;
+    uint bucketCount;
+} pushConstants;
+
+const uint notVisible = 0xFFFFFFFFu;
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= pushConstants.instanceCount) return;
+
+    uint rank = instanceRanks.ranks[idx];
+    if (rank == notVisible) return;
+
+    InstanceData instance = instanceBuffer.instances[idx];
+    uint bucket = surfaceBuffer.surfaces[instance.surface].bucket;
+    binnedInstances.instances[indirectCommands.commands[bucket].firstInstance + rank] = instance;
+}
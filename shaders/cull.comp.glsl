@@ -1,6 +1,14 @@
 #version 450
 
-layout(local_size_x = 128) in;
+// first of the three binning passes: frustum cull, then count the survivors per
+// bucket, one per (primitive, material) of the model. every visible instance leaves with its rank inside its bucket,
+// binScan turns the counts into offsets and binScatter moves the instances there.
+//
+// the counts and stats are cleared with vkCmdFillBuffer before this runs.
+
+// the size is specialization constant 0, Mesh picks it per device (WorkgroupTuner)
+// and dispatches with the same number. 128 when nothing sets it
+layout(local_size_x = 128, local_size_x_id = 0) in;
 
 layout(set = 0, binding = 0) uniform CullData {
     mat4 viewProj;
@@ -10,30 +18,58 @@ layout(set = 0, binding = 0) uniform CullData {
 struct InstanceData {
     vec3 position;
     float scale;
+    uint surface;
+    uint pad0;
+    uint pad1;
+    uint pad2;
 };
 
 layout(set = 0, binding = 1) readonly buffer InstanceBuffer {
     InstanceData instances[];
 } instanceBuffer;
 
-struct DrawIndexedIndirectCommand {
-    uint indexCount;
-    uint instanceCount;
-    uint firstIndex;
-    int vertexOffset;
-    uint firstInstance;
-};
-
-layout(set = 0, binding = 2) buffer IndirectCommands {
-    DrawIndexedIndirectCommand commands[];
-} indirectCommands;
-
 layout(set = 0, binding = 3) buffer CullStats {
     uint visibleCount;
     uint occludedCount;
     uint totalCount;
 } stats;
 
+// GpuSurface in types.h
+struct Surface {
+    uint material;
+    uint node;
+    uint bucket;
+    uint pad;
+};
+
+layout(set = 0, binding = 4) readonly buffer SurfaceBuffer {
+    Surface surfaces[];
+} surfaceBuffer;
+
+layout(set = 0, binding = 5) buffer BucketCounts {
+    uint counts[];
+} bucketCounts;
+
+// rank of each instance inside its bucket, culled ones get notVisible
+layout(set = 0, binding = 6) writeonly buffer InstanceRanks {
+    uint ranks[];
+} instanceRanks;
+
+// BinningPushConstants in types.h
+layout(push_constant) uniform PushConstants {
+    uint instanceCount;
+    uint bucketCount;
+} pushConstants;
+
+// MaterialTable::maxBuckets
+const uint maxBuckets = 1024;
+const uint notVisible = 0xFFFFFFFFu;
+
+// counted here first so the global counters see one atomic per bucket per workgroup
+shared uint localCounts[maxBuckets];
+shared uint localBase[maxBuckets];
+shared uint localVisible;
+
 bool isVisible(vec3 center, float radius) {
     for (int i = 0; i < 6; i++) {
         float distance = dot(cullData.frustumPlanes[i].xyz, center) +
@@ -46,23 +82,48 @@ bool isVisible(vec3 center, float radius) {
 }
 
 void main() {
-    if (gl_GlobalInvocationID.x == 0) {
-        stats.visibleCount = 0;
-        stats.occludedCount = 0;
-        stats.totalCount = 8000;
+    uint idx = gl_GlobalInvocationID.x;
+    uint local = gl_LocalInvocationIndex;
+
+    for (uint b = local; b < pushConstants.bucketCount; b += gl_WorkGroupSize.x) {
+        localCounts[b] = 0;
+    }
+    if (local == 0) {
+        localVisible = 0;
     }
+    if (idx == 0) {
+        stats.totalCount = pushConstants.instanceCount;
+    }
+    barrier();
 
-    uint idx = gl_GlobalInvocationID.x;
-    if (idx >= 8000) return;
+    // no early out, every invocation has to reach the barriers
+    bool visible = false;
+    uint bucket = 0;
+    uint localRank = 0;
+    if (idx < pushConstants.instanceCount) {
+        InstanceData instance = instanceBuffer.instances[idx];
+        float radius = instance.scale * 1.732; // Conservative bounding sphere
 
-    vec3 position = instanceBuffer.instances[idx].position;
-    float scale = instanceBuffer.instances[idx].scale;
-    float radius = scale * 1.732; // Conservative bounding sphere
+        if (isVisible(instance.position, radius)) {
+            visible = true;
+            bucket = surfaceBuffer.surfaces[instance.surface].bucket;
+            localRank = atomicAdd(localCounts[bucket], 1);
+            atomicAdd(localVisible, 1);
+        }
+    }
+    barrier();
+
+    for (uint b = local; b < pushConstants.bucketCount; b += gl_WorkGroupSize.x) {
+        if (localCounts[b] > 0) {
+            localBase[b] = atomicAdd(bucketCounts.counts[b], localCounts[b]);
+        }
+    }
+    if (local == 0 && localVisible > 0) {
+        atomicAdd(stats.visibleCount, localVisible);
+    }
+    barrier();
 
-    if (isVisible(position, radius)) {
-        indirectCommands.commands[idx].instanceCount = 1;
-        atomicAdd(stats.visibleCount, 1);
-    } else {
-        indirectCommands.commands[idx].instanceCount = 0;
+    if (idx < pushConstants.instanceCount) {
+        instanceRanks.ranks[idx] = visible ? localBase[bucket] + localRank : notVisible;
     }
-}
\ No newline at end of file
+}
@@ -1,12 +1,22 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragTextureIndex;
 
 layout(location = 0) out vec4 outColor;
 
-layout(set = 0, binding = 0) uniform sampler2D texSampler;
+// tools/bindlessTextures, one draw covers instances with different textures
+layout(set = 0, binding = 0) uniform sampler2D textures[];
+
+// MaterialTable::noTexture, a material without a base color texture
+const uint noTexture = 0xFFFFFFFFu;
 
 void main() {
-    outColor = texture(texSampler, fragTexCoord);
+    vec4 baseColor = vec4(1.0);
+    if (fragTextureIndex != noTexture) {
+        baseColor = texture(textures[nonuniformEXT(fragTextureIndex)], fragTexCoord);
+    }
+    outColor = baseColor * vec4(fragColor, 1.0);
 }
\ No newline at end of file
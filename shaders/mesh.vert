@@ -14,25 +14,70 @@ layout(buffer_reference, std430) readonly buffer VertexBuffer {
     Vertex vertices[];
 };
 
+// GpuMaterial in types.h
+struct Material {
+    vec4 baseColorFactor;
+    uint baseColorTexture;
+    uint pad;
+    float alphaCutoff;
+    uint flags;
+};
+
+layout(buffer_reference, std430) readonly buffer MaterialBuffer {
+    Material materials[];
+};
+
+// GpuSurface in types.h
+struct Surface {
+    uint material;
+    uint node;
+    uint bucket;
+    uint pad;
+};
+
+layout(buffer_reference, std430) readonly buffer SurfaceBuffer {
+    Surface surfaces[];
+};
+
+// TransformHierarchy's worlds, column major like mat4
+layout(buffer_reference, std430) readonly buffer NodeBuffer {
+    mat4 worlds[];
+};
+
 layout(location = 0) in vec3  instancePos;
 layout(location = 1) in float instanceScale;
+layout(location = 2) in uint  instanceSurface;
 
+// same block as meshPacked.vert, the quantization fields are unused here
 layout(push_constant) uniform PushConstants {
     mat4 worldMatrix;
+    vec4 positionScale;
+    vec4 positionOffset;
     VertexBuffer vertexBuffer;
+    MaterialBuffer materialBuffer;
+    SurfaceBuffer surfaceBuffer;
+    NodeBuffer nodeBuffer;
 } pushConstants;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTextureIndex;
 
 
 void main() {
     Vertex v = pushConstants.vertexBuffer.vertices[gl_VertexIndex];
 
-    vec3 worldPos = v.position * instanceScale + instancePos;
+    // the model's node first, then the instance's place in the grid
+    Surface surface = pushConstants.surfaceBuffer.surfaces[instanceSurface];
+    vec3 modelPos = (pushConstants.nodeBuffer.worlds[surface.node] * vec4(v.position, 1.0)).xyz;
+    vec3 worldPos = modelPos * instanceScale + instancePos;
 
     gl_Position = pushConstants.worldMatrix * vec4(worldPos, 1.0);
 
-    fragColor = v.color;
     fragTexCoord = vec2(v.uv_x, v.uv_y);
+
+    // flat per instance, the fragment shader never touches the material table
+    Material material = pushConstants.materialBuffer.materials[surface.material];
+    fragColor = v.color * material.baseColorFactor.rgb;
+    fragTextureIndex = material.baseColorTexture;
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+
+// PackedVertex in types.h
+struct PackedVertex {
+    uint positionXY;   // unorm16 x2
+    uint positionZW;   // unorm16 z, w unused
+    uint normal;       // octahedral snorm16 x2
+    uint uv;           // half x2
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer {
+    PackedVertex vertices[];
+};
+
+// GpuMaterial in types.h
+struct Material {
+    vec4 baseColorFactor;
+    uint baseColorTexture;
+    uint pad;
+    float alphaCutoff;
+    uint flags;
+};
+
+layout(buffer_reference, std430) readonly buffer MaterialBuffer {
+    Material materials[];
+};
+
+// GpuSurface in types.h
+struct Surface {
+    uint material;
+    uint node;
+    uint bucket;
+    uint pad;
+};
+
+layout(buffer_reference, std430) readonly buffer SurfaceBuffer {
+    Surface surfaces[];
+};
+
+// TransformHierarchy's worlds, column major like mat4
+layout(buffer_reference, std430) readonly buffer NodeBuffer {
+    mat4 worlds[];
+};
+
+layout(location = 0) in vec3  instancePos;
+layout(location = 1) in float instanceScale;
+layout(location = 2) in uint  instanceSurface;
+
+layout(push_constant) uniform PushConstants {
+    mat4 worldMatrix;
+    vec4 positionScale;
+    vec4 positionOffset;
+    VertexBuffer vertexBuffer;
+    MaterialBuffer materialBuffer;
+    SurfaceBuffer surfaceBuffer;
+    NodeBuffer nodeBuffer;
+} pushConstants;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTextureIndex;
+
+// mesh.frag doesn't light yet, nothing reads the normal so far
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main() {
+    PackedVertex v = pushConstants.vertexBuffer.vertices[gl_VertexIndex];
+
+    vec3 position = vec3(unpackUnorm2x16(v.positionXY), unpackUnorm2x16(v.positionZW).x);
+    position = position * pushConstants.positionScale.xyz + pushConstants.positionOffset.xyz;
+
+    // the model's node first, then the instance's place in the grid
+    Surface surface = pushConstants.surfaceBuffer.surfaces[instanceSurface];
+    vec3 modelPos = (pushConstants.nodeBuffer.worlds[surface.node] * vec4(position, 1.0)).xyz;
+    vec3 worldPos = modelPos * instanceScale + instancePos;
+
+    gl_Position = pushConstants.worldMatrix * vec4(worldPos, 1.0);
+
+    fragTexCoord = unpackHalf2x16(v.uv);
+
+    Material material = pushConstants.materialBuffer.materials[surface.material];
+    fragColor = material.baseColorFactor.rgb;
+    fragTextureIndex = material.baseColorTexture;
+}
@@ -0,0 +1,127 @@
+#version 450
+
+// mesh.frag on top of tools/virtualTexture: the texture lives in fixed size pages
+// inside one atlas, the page table says where, and a sixteenth of the pixels every
+// frame write the page they wanted into the feedback list for the CPU to load.
+// missing pages fall back to the next coarser mip that is resident, and that page
+// goes into the feedback too so the LRU doesn't evict what is on screen.
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+// must match VirtualTextures
+const float pageSize = 120.0;
+const float pageBorder = 4.0;
+const float slotSize = 128.0;
+const uint  notResident = 0xFFFFFFFFu;
+
+// one virtual texture per draw for now
+const uint textureId = 0u;
+
+struct VirtualTextureInfo {
+    uint width;
+    uint height;
+    uint mipCount;      // 0 until the texture is registered
+    uint firstEntry;
+};
+
+// Mesh::meshSetVirtual
+layout(set = 2, binding = 0) uniform sampler2D pageAtlas;
+
+layout(set = 2, binding = 1) readonly buffer PageTable {
+    uint               frameStamp;
+    uint               atlasSlots;
+    uint               textureCount;
+    uint               pad;
+    VirtualTextureInfo textures[64];
+    uint               entries[];
+} pageTable;
+
+layout(set = 2, binding = 2) buffer PageStamps {
+    uint stamps[];
+} pageStamps;
+
+layout(set = 2, binding = 3) buffer Feedback {
+    uint count;
+    uint capacity;
+    uint pad0;
+    uint pad1;
+    uint requests[];
+} feedback;
+
+uvec2 mipSize(VirtualTextureInfo info, uint mip) {
+    return max(uvec2(info.width, info.height) >> mip, uvec2(1));
+}
+
+uvec2 pageCount(VirtualTextureInfo info, uint mip) {
+    return (mipSize(info, mip) + uint(pageSize) - 1) / uint(pageSize);
+}
+
+uint entryIndex(VirtualTextureInfo info, uint mip, uvec2 page) {
+    uint index = info.firstEntry;
+    for (uint m = 0; m < mip; m++) {
+        uvec2 count = pageCount(info, m);
+        index += count.x * count.y;
+    }
+    return index + page.y * pageCount(info, mip).x + page.x;
+}
+
+void requestPage(uint entry) {
+    uvec2 pixel = uvec2(gl_FragCoord.xy) & 3u;
+    if (pixel.x + pixel.y * 4u != pageTable.frameStamp % 16u) {
+        return;
+    }
+    // first pixel this frame to want the page gets to append it
+    if (atomicExchange(pageStamps.stamps[entry], pageTable.frameStamp) == pageTable.frameStamp) {
+        return;
+    }
+    uint slot = atomicAdd(feedback.count, 1u);
+    if (slot < feedback.capacity) {
+        feedback.requests[slot] = entry;
+    }
+}
+
+void main() {
+    VirtualTextureInfo info = pageTable.textures[textureId];
+    if (info.mipCount == 0) {
+        outColor = vec4(0.5, 0.5, 0.5, 1.0);
+        return;
+    }
+
+    // repeat addressing, same as the sampler mesh.frag uses
+    vec2 uv = fract(fragTexCoord);
+
+    vec2 texels = fragTexCoord * vec2(info.width, info.height);
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) - 0.25;
+    uint wanted = uint(clamp(lod, 0.0, float(info.mipCount - 1)));
+
+    for (uint mip = wanted; mip < info.mipCount; mip++) {
+        vec2 position = uv * vec2(mipSize(info, mip));
+        uvec2 page = min(uvec2(position / pageSize), pageCount(info, mip) - 1);
+        uint entry = entryIndex(info, mip, page);
+        if (mip == wanted) {
+            requestPage(entry);
+        }
+
+        uint slot = pageTable.entries[entry];
+        if (slot == notResident) {
+            continue;
+        }
+        // the fallback is what this pixel shows, it has to look used as well
+        if (mip != wanted) {
+            requestPage(entry);
+        }
+
+        vec2 slotOrigin = vec2(slot % pageTable.atlasSlots, slot / pageTable.atlasSlots) * slotSize;
+        vec2 atlasUv = (slotOrigin + pageBorder + position - vec2(page) * pageSize) / (pageTable.atlasSlots * slotSize);
+        outColor = textureLod(pageAtlas, atlasUv, 0.0);
+        return;
+    }
+
+    // the coarsest mip is pinned, this only happens before its first page has landed
+    outColor = vec4(0.5, 0.5, 0.5, 1.0);
+}
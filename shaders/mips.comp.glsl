@@ -0,0 +1,140 @@
+#version 450
+
+// whole mip chain in one dispatch, single pass downsampler style. every workgroup
+// reduces a 64x64 tile of level 0 to one texel of level 6 out of shared memory,
+// and the last workgroup to finish reads level 6 back and does the rest.
+// sizes halve with floor like vkCmdBlitImage chains, an odd last row or column
+// of a level gets dropped, and a side that's down to 1 repeats its texel.
+
+layout(local_size_x = 256) in;
+
+layout(set = 0, binding = 0, rgba8) uniform readonly image2D source;
+layout(set = 0, binding = 1, rgba8) uniform coherent image2D levels[12];
+
+layout(set = 0, binding = 2) coherent buffer Counter {
+    uint finishedGroups;
+} counter;
+
+layout(push_constant) uniform Params {
+    ivec2 size;         // level 0
+    uint  levelCount;   // levels written, level 0 not included
+    uint  groupCount;
+    uint  srgb;
+} params;
+
+shared vec4 tile[32][32];
+shared bool lastGroup;
+
+ivec2 levelSize(uint level) {
+    return max(params.size >> level, ivec2(1));
+}
+
+vec4 toLinear(vec4 c) {
+    if (params.srgb == 0) {
+        return c;
+    }
+    vec3 rgb = mix(c.rgb / 12.92, pow((c.rgb + 0.055) / 1.055, vec3(2.4)), step(0.04045, c.rgb));
+    return vec4(rgb, c.a);
+}
+
+vec4 fromLinear(vec4 c) {
+    if (params.srgb == 0) {
+        return c;
+    }
+    vec3 rgb = mix(c.rgb * 12.92, 1.055 * pow(c.rgb, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, c.rgb));
+    return vec4(rgb, c.a);
+}
+
+// the array index has to be a constant without shaderStorageImageArrayDynamicIndexing
+void store(uint level, ivec2 p, vec4 value) {
+    if (level > params.levelCount || any(greaterThanEqual(p, levelSize(level)))) {
+        return;
+    }
+    value = fromLinear(value);
+    switch (level) {
+        case 1:  imageStore(levels[0], p, value);  break;
+        case 2:  imageStore(levels[1], p, value);  break;
+        case 3:  imageStore(levels[2], p, value);  break;
+        case 4:  imageStore(levels[3], p, value);  break;
+        case 5:  imageStore(levels[4], p, value);  break;
+        case 6:  imageStore(levels[5], p, value);  break;
+        case 7:  imageStore(levels[6], p, value);  break;
+        case 8:  imageStore(levels[7], p, value);  break;
+        case 9:  imageStore(levels[8], p, value);  break;
+        case 10: imageStore(levels[9], p, value);  break;
+        case 11: imageStore(levels[10], p, value); break;
+        case 12: imageStore(levels[11], p, value); break;
+    }
+}
+
+vec4 load(uint level, ivec2 p) {
+    p = min(p, levelSize(level) - 1);
+    return toLinear(level == 0 ? imageLoad(source, p) : imageLoad(levels[5], p));
+}
+
+// level + 1 straight from the image into the tile, 32x32 texels starting at origin
+void downsampleImage(uint level, ivec2 origin) {
+    for (uint i = gl_LocalInvocationIndex; i < 32 * 32; i += 256) {
+        ivec2 local = ivec2(i % 32, i / 32);
+        ivec2 p = (origin + local) * 2;
+        vec4 value = (load(level, p) + load(level, p + ivec2(1, 0)) +
+                      load(level, p + ivec2(0, 1)) + load(level, p + ivec2(1, 1))) * 0.25;
+        store(level + 1, origin + local, value);
+        tile[local.y][local.x] = value;
+    }
+    barrier();
+}
+
+// the tile holds level with 32x32 texels from origin, keep halving it down to one texel
+void downsampleTile(uint level, ivec2 origin) {
+    uint last = min(level + 5, params.levelCount);
+    for (uint dst = level + 1, width = 16; dst <= last; dst++, width /= 2) {
+        ivec2 local = ivec2(gl_LocalInvocationIndex % width, gl_LocalInvocationIndex / width);
+        bool active = gl_LocalInvocationIndex < width * width;
+        ivec2 dstOrigin = origin >> (dst - level);
+        ivec2 srcOrigin = dstOrigin * 2;
+        ivec2 srcMax = levelSize(dst - 1) - 1 - srcOrigin;
+
+        vec4 value = vec4(0.0);
+        if (active) {
+            ivec2 p = local * 2;
+            ivec2 q = min(p + 1, srcMax);
+            value = (tile[p.y][p.x] + tile[p.y][q.x] + tile[q.y][p.x] + tile[q.y][q.x]) * 0.25;
+            store(dst, dstOrigin + local, value);
+        }
+        barrier();
+        if (active) {
+            tile[local.y][local.x] = value;
+        }
+        barrier();
+    }
+}
+
+void main() {
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * 32;
+    downsampleImage(0, origin);
+    downsampleTile(1, origin);
+
+    if (params.levelCount <= 6) {
+        return;
+    }
+
+    // level 6 from every group has to be visible before the last one reads it
+    memoryBarrierImage();
+    barrier();
+    if (gl_LocalInvocationIndex == 0) {
+        lastGroup = atomicAdd(counter.finishedGroups, 1) == params.groupCount - 1;
+    }
+    barrier();
+    if (!lastGroup) {
+        return;
+    }
+
+    // level 6 is at most 64x64 since level 0 is at most 4096
+    downsampleImage(6, ivec2(0));
+    downsampleTile(7, ivec2(0));
+
+    if (gl_LocalInvocationIndex == 0) {
+        counter.finishedGroups = 0;
+    }
+}
@@ -0,0 +1,25 @@
+#version 450
+
+// overdraw capture without quad stats, for devices without fragment-stage quad ops.
+// early tests so only fragments that actually get shaded are counted.
+layout(early_fragment_tests) in;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+// Mesh::meshSetOverdraw, set 0 is the bindless textures this variant doesn't use
+layout(set = 1, binding = 0, r32ui) uniform uimage2D overdrawImage;
+
+layout(set = 1, binding = 1) buffer QuadStats {
+    uint shadedLanes;
+    uint helperLanes;
+    uint quads;
+} quadStats;
+
+void main() {
+    uint count = imageAtomicAdd(overdrawImage, ivec2(gl_FragCoord.xy), 1u) + 1u;
+
+    outColor = vec4(vec3(min(float(count) / 8.0, 1.0)), 1.0);
+}
@@ -0,0 +1,45 @@
+#version 450
+#extension GL_KHR_shader_subgroup_quad : require
+
+// overdraw capture plus quad occupancy. helper lanes don't run side effects,
+// so the first live lane of every quad books the whole quad.
+layout(early_fragment_tests) in;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+// Mesh::meshSetOverdraw, like overdraw.frag
+layout(set = 1, binding = 0, r32ui) uniform uimage2D overdrawImage;
+
+layout(set = 1, binding = 1) buffer QuadStats {
+    uint shadedLanes;
+    uint helperLanes;
+    uint quads;
+} quadStats;
+
+void main() {
+    uint live = gl_HelperInvocation ? 0u : 1u;
+
+    uint lane0 = subgroupQuadBroadcast(live, 0);
+    uint lane1 = subgroupQuadBroadcast(live, 1);
+    uint lane2 = subgroupQuadBroadcast(live, 2);
+    uint lane3 = subgroupQuadBroadcast(live, 3);
+    uint liveInQuad = lane0 + lane1 + lane2 + lane3;
+
+    uint firstLive = lane0 == 1u ? 0u : (lane1 == 1u ? 1u : (lane2 == 1u ? 2u : 3u));
+
+    uint count = 0u;
+    if (live == 1u) {
+        count = imageAtomicAdd(overdrawImage, ivec2(gl_FragCoord.xy), 1u) + 1u;
+
+        if ((gl_SubgroupInvocationID & 3u) == firstLive) {
+            atomicAdd(quadStats.shadedLanes, liveInQuad);
+            atomicAdd(quadStats.helperLanes, 4u - liveInQuad);
+            atomicAdd(quadStats.quads, 1u);
+        }
+    }
+
+    outColor = vec4(vec3(min(float(count) / 8.0, 1.0)), 1.0);
+}
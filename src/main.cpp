@@ -1,5 +1,6 @@
 #include <iostream>
 #include "mesh.h"
+#include "../tools/startupProfiler.h"
 
 
 int main() {
@@ -10,5 +11,5 @@ int main() {
 
     mesh.run();
 
-    return 0;
+    return startup::report() ? 0 : 1;
 }
\ No newline at end of file
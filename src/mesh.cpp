@@ -1,74 +1,131 @@
 #include "mesh.h"
 
 #include "GLFW/glfw3.h"
-#include "../tools/gltfLoader.h"
 #include "../tools/inits.h"
+#include "../tools/overdraw.h"
+#include "../tools/settings.h"
+#include "../tools/startupProfiler.h"
 
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <unordered_map>
 
 Mesh::Mesh(uint32_t _width, uint32_t _height, const char* _windowName)
     : Base(_width, _height, _windowName) {
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (window) {
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
     initCamera(0.0f, 20.0f, 50.0f);
-    initDepthImage();
 
-    loadObj("../assets/barrel/Barrel.obj");
-    textureImage = loadTextureImage("../assets/barrel/Barrel_Base_Color.png");
+    STARTUP_STAGE("Mesh::Mesh");
 
-    createInstances();
-    createCullBuffers();
-    createIndirectCmdBuffer();
+    // layouts first, they're all the pipelines need from the asset side
+    initDescriptorLayouts();
 
-    initDescriptorSets();
+    cullTuner.init(physicalDevice, indices.graphicsFamily, "cull", 128);
 
-    initInstancePipeline();
-    initCullPipeline();
-}
+    // independent loads and pipeline builds go wide, their GPU copies queue up on the upload thread
+    {
+        STARTUP_STAGE("parallel load");
+        JobCounter loads;
+
+        jobs.run(loads, [this] {
+            STARTUP_STAGE("initDepthImage");
+            initDepthImage();
+        });
+        jobs.run(loads, [this] {
+            // IDK_MESH swaps the barrel for any .obj/.gltf/.glb, one bucket per primitive and material
+            STARTUP_STAGE("loadModel");
+            loadModel(envString("IDK_MESH", "../assets/barrel/Barrel.obj").c_str());
+        });
+        jobs.run(loads, [this] {
+            STARTUP_STAGE("initInstancePipeline");
+            initInstancePipeline();
+        });
+        jobs.run(loads, [this] {
+            STARTUP_STAGE("initCullPipeline");
+            initCullPipeline();
+        });
+
+        jobs.wait(loads);
+
+        // the pipelines went to the compiler's jobs, the first frame needs them. blocking here
+        // and not in a load job, so no worker sits on a future that's queued behind it
+        cullPipeline = cullBuild.get();
+        binScanPipeline = binScanBuild.get();
+        binScatterPipeline = binScatterBuild.get();
+        meshPipeline.fast.get();
+    }
 
-void Mesh::initDescriptorSets() {
-    // texture descriptor set
+    // these need the model's surfaces and materials, and then the instance count
     {
-        DescriptorLayout builder;
-        builder.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-        meshDescriptorLayout = builder.build(device, VK_SHADER_STAGE_FRAGMENT_BIT);
-    }
-
-    VkSamplerCreateInfo sampler = {.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
-    sampler.magFilter = VK_FILTER_LINEAR;
-    sampler.minFilter = VK_FILTER_LINEAR;
-    sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    sampler.minLod = 0.0f;
-    sampler.maxLod = VK_LOD_CLAMP_NONE;
-    sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler.mipLodBias = -0.25f;
-    sampler.anisotropyEnable = VK_TRUE;
-    sampler.maxAnisotropy = 16.0f;
-    sampler.compareEnable = VK_FALSE;
-    sampler.compareOp = VK_COMPARE_OP_ALWAYS;
-
-    VK_CHECK(vkCreateSampler(device, &sampler, nullptr, &texSampler));
+        STARTUP_STAGE("createMaterials");
+        createMaterials();
+    }
+    {
+        STARTUP_STAGE("createNodeBuffers");
+        createNodeBuffers();
+    }
+    {
+        STARTUP_STAGE("createInstances");
+        createInstances();
+    }
+    {
+        STARTUP_STAGE("createCullBuffers");
+        createCullBuffers();
+    }
+    {
+        STARTUP_STAGE("createBinningBuffers");
+        createBinningBuffers();
+    }
+    {
+        STARTUP_STAGE("initDescriptorSets");
+        initDescriptorSets();
+    }
+    if (envFlag("IDK_VIRTUAL_TEXTURES")) {
+        STARTUP_STAGE("initVirtualTexturing");
+        initVirtualTexturing();
+    }
 
-    std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = {
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f },
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f }
-    };
+    // every copy queued above goes out in one submit, and this is the only wait on it
+    {
+        STARTUP_STAGE("upload flush");
+        uploads.wait(uploads.flush());
+    }
 
-    // tex descriptor set is the same for every instance.
-    // just allocate them to each frame ig.
-    for (uint32_t i = 0; i < MAX_FRAMES; i++) {
-        frames[i]._frameDescriptors.init(device, 10, sizes);
+    if (cullTuner.wantsTuning()) {
+        STARTUP_STAGE("tuneCullWorkgroup");
+        tuneCullWorkgroup();
+    }
 
-        imageDescriptorSets[i] = frames[i]._frameDescriptors.allocate(device, meshDescriptorLayout);
-        DescriptorWriter writer;
-        writer.writeImage(0, textureImage.imageView, texSampler,
-                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-        writer.updateSet(device, imageDescriptorSets[i]);
+    pipelineStats.init(device, physicalDevice, MAX_FRAMES);
+
+    if (envFlag("IDK_OVERDRAW")) {
+        initOverdrawCapture();
+    }
+}
+
+void Mesh::initDescriptorLayouts() {
+    // textures come from the bindless table Base owns
+
+    // the debug variants' sets, built whether or not their mode is on since the shared mesh
+    // pipeline layout has a slot for each
+    {
+        DescriptorLayout builder;
+        builder.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+        builder.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        overdrawDescriptorLayout = builder.build(device, VK_SHADER_STAGE_FRAGMENT_BIT);
+    }
+    {
+        DescriptorLayout builder;
+        builder.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        builder.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        builder.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        builder.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        virtualDescriptorLayout = builder.build(device, VK_SHADER_STAGE_FRAGMENT_BIT);
     }
 
     // cull descriptor set
@@ -78,23 +135,139 @@ void Mesh::initDescriptorSets() {
         builder.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
         builder.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
         builder.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        builder.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        builder.addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        builder.addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        builder.addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        builder.addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
         cullDescriptorLayout = builder.build(device, VK_SHADER_STAGE_COMPUTE_BIT);
     }
+}
+
+void Mesh::initDescriptorSets() {
+    std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f }
+    };
+
+    for (uint32_t i = 0; i < MAX_FRAMES; i++) {
+        frames[i]._frameDescriptors.init(device, 10, sizes);
+    }
 
     for (uint32_t i = 0; i < MAX_FRAMES; i++) {
         cullDescriptorSets[i] = frames[i]._frameDescriptors.allocate(device, cullDescriptorLayout);
         DescriptorWriter writer;
         writer.writeBuffer(0, cullDataBuffers[i].buffer, sizeof(CullData), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
         writer.writeBuffer(1, instanceBuffer.buffer, sizeof(InstanceData) * trueInstanceCount, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-        writer.writeBuffer(2, drawCmdBuffer.buffer, sizeof(DrawIndexedIndirectCommand) * trueInstanceCount, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.writeBuffer(2, drawCmdBuffers[i].buffer, sizeof(DrawIndexedIndirectCommand) * materials.bucketCount(), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
         writer.writeBuffer(3, cullStatsBuffers[i].buffer, sizeof(CullStats), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.writeBuffer(4, surfaceBuffer.buffer, sizeof(GpuSurface) * materials.surfaceCount(), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.writeBuffer(5, bucketCountBuffers[i].buffer, sizeof(uint32_t) * materials.bucketCount(), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.writeBuffer(6, instanceRankBuffers[i].buffer, sizeof(uint32_t) * trueInstanceCount, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.writeBuffer(7, binnedInstanceBuffers[i].buffer, sizeof(InstanceData) * trueInstanceCount, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.writeBuffer(8, bucketBuffer.buffer, sizeof(GpuBucket) * materials.bucketCount(), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
         writer.updateSet(device, cullDescriptorSets[i]);
     }
 }
 
+// GPU only, filled through the upload queue like the instances
+AllocatedBuffer Mesh::createTableBuffer(const void* data, size_t size, VkBufferUsageFlags usage, const char* name) {
+    AllocatedBuffer buffer = createAllocatedBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Instance, name);
+    if (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+        VkBufferDeviceAddressInfo deviceAddressInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,.buffer = buffer.buffer };
+        buffer.bufferAddress = vkGetBufferDeviceAddress(device, &deviceAddressInfo);
+    }
+
+    StagingSlice staging = uploads.allocateStaging(size);
+    memcpy(staging.data, data, size);
+
+    uploads.enqueue([staging, size, dst = buffer.buffer](VkCommandBuffer cmd) {
+        VkBufferCopy copy{};
+        copy.srcOffset = staging.offset;
+        copy.size = size;
+        vkCmdCopyBuffer(cmd, staging.buffer, dst, 1, &copy);
+    }, staging);
+
+    return buffer;
+}
+
+// the model's own materials, one surface per primitive and material. a glTF's textures
+// stream in behind the first frames, their bindless slots point at the placeholder until they land
+void Mesh::createMaterials() {
+    std::vector<uint32_t> textureIndices;
+    std::unordered_map<std::string, uint32_t> requested;
+    for (const std::string& path : modelMaterialTextures) {
+        if (path.empty()) {
+            textureIndices.push_back(MaterialTable::noTexture);
+            continue;
+        }
+        auto found = requested.find(path);
+        if (found == requested.end()) {
+            found = requested.emplace(path, textureStreamer.bindlessIndex(textureStreamer.request(path.c_str()))).first;
+        }
+        textureIndices.push_back(found->second);
+    }
+
+    // everything goes through meshPipeline, so every material has pipeline key 0
+    for (size_t i = 0; i < modelMaterials.size(); i++) {
+        materials.add(modelMaterials[i], textureIndices[i]);
+    }
+
+    // surfaces without a material. an obj's .mtl isn't read, it gets the barrel's texture
+    uint32_t defaultMaterial = UINT32_MAX;
+    for (const MeshSurface& surface : modelSurfaces) {
+        if (surface.materialIndex < 0 && defaultMaterial == UINT32_MAX) {
+            uint32_t texture = MaterialTable::noTexture;
+            if (modelMaterials.empty()) {
+                barrelTexture = textureStreamer.request("../assets/barrel/Barrel_Base_Color.png");
+                texture = textureStreamer.bindlessIndex(barrelTexture);
+            }
+            defaultMaterial = materials.add(Material {}, texture);
+        }
+        materials.addSurface(surface.firstIndex, surface.indexCount,
+                             surface.materialIndex < 0 ? defaultMaterial : static_cast<uint32_t>(surface.materialIndex),
+                             surface.node);
+    }
+    materials.build();
+
+    materialBuffer = createTableBuffer(materials.data().data(), sizeof(GpuMaterial) * materials.size(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, "materials");
+    surfaceBuffer = createTableBuffer(materials.surfaceData().data(), sizeof(GpuSurface) * materials.surfaceCount(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, "surfaces");
+    bucketBuffer = createTableBuffer(materials.bucketData().data(), sizeof(GpuBucket) * materials.bucketCount(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "buckets");
+
+    std::cout << "Material table: " << materials.size() << " materials, " << materials.surfaceCount() << " surfaces, "
+              << materials.bucketCount() << " buckets, " << materials.pipelineRanges().size() << " pipelines" << std::endl;
+}
+
+void Mesh::createNodeBuffers() {
+    for (uint32_t i = 0; i < MAX_FRAMES; i++) {
+        nodeBuffers[i] = createAllocatedBuffer(sizeof(float) * 16 * modelNodes.size(),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::PerFrame, "node worlds");
+        VkBufferDeviceAddressInfo deviceAddressInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,.buffer = nodeBuffers[i].buffer };
+        nodeBuffers[i].bufferAddress = vkGetBufferDeviceAddress(device, &deviceAddressInfo);
+    }
+}
+
+// recomposes whatever moved, then copies the worlds this frame's buffer hasn't seen yet.
+// nothing animates the nodes so far, so past the first frames in flight this writes nothing
+void Mesh::updateNodeWorlds(uint32_t frameIndex) {
+    modelNodes.update();
+
+    void* mapped;
+    vmaMapMemory(allocator, nodeBuffers[frameIndex].allocation, &mapped);
+    modelNodes.writeWorlds(frameIndex, mapped);
+    vmaUnmapMemory(allocator, nodeBuffers[frameIndex].allocation);
+}
+
 void Mesh::createInstances() {
     instances.clear();
-    instances.reserve(8000);
+    instances.reserve(size_t(INSTANCE_COUNT) * materials.surfaceCount());
 
     const int gridDim = 20;
     const float spacing = 5.0f;
@@ -112,7 +285,12 @@ void Mesh::createInstances() {
                 );
 
                 instance.scale = cubeScale;
-                instances.push_back(instance);
+
+                // a copy of the model is one instance per surface, each culls and bins on its own
+                for (uint32_t surface = 0; surface < materials.surfaceCount(); surface++) {
+                    instance.surface = surface;
+                    instances.push_back(instance);
+                }
             }
         }
     }
@@ -127,27 +305,19 @@ void Mesh::createInstances() {
     instanceBuffer = createAllocatedBuffer(
         bufferSize,
         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VMA_MEMORY_USAGE_GPU_ONLY
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        MemoryCategory::Instance, "instances"
     );
 
-    AllocatedBuffer staging = createAllocatedBuffer(
-        bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VMA_MEMORY_USAGE_CPU_TO_GPU
-    );
+    StagingSlice staging = uploads.allocateStaging(bufferSize);
+    memcpy(staging.data, instances.data(), bufferSize);
 
-    void* data;
-    vmaMapMemory(allocator, staging.allocation, &data);
-    memcpy(data, instances.data(), bufferSize);
-    vmaUnmapMemory(allocator, staging.allocation);
-
-    immediateSubmit([&](VkCommandBuffer cmd) {
+    uploads.enqueue([staging, bufferSize, dst = instanceBuffer.buffer](VkCommandBuffer cmd) {
         VkBufferCopy copy{};
+        copy.srcOffset = staging.offset;
         copy.size = bufferSize;
-        vkCmdCopyBuffer(cmd, staging.buffer, instanceBuffer.buffer, 1, &copy);
-    });
-
-    vmaDestroyBuffer(allocator, staging.buffer, staging.allocation);
+        vkCmdCopyBuffer(cmd, staging.buffer, dst, 1, &copy);
+    }, staging);
 
     // useful if number of instances is really high -- save space
     instances.clear();
@@ -157,10 +327,10 @@ void Mesh::createInstances() {
 void Mesh::createCullBuffers() {
     for (uint32_t i = 0; i < MAX_FRAMES; i++) {
         cullDataBuffers[i] = createAllocatedBuffer(sizeof(CullData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VMA_MEMORY_USAGE_CPU_TO_GPU);
+            VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::PerFrame, "cull data");
         cullStatsBuffers[i] = createAllocatedBuffer(sizeof(CullStats),
    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-   VMA_MEMORY_USAGE_GPU_TO_CPU);
+   VMA_MEMORY_USAGE_GPU_TO_CPU, MemoryCategory::PerFrame, "cull stats");
 
         CullStats stats {0, 0, trueInstanceCount};
         void* data;
@@ -171,31 +341,40 @@ void Mesh::createCullBuffers() {
 }
 
 void Mesh::initInstancePipeline() {
-    VkShaderModule vertShader { VK_NULL_HANDLE };
-    vertShader = loadShader(device, "../shaders/mesh.vert.spv");
-    assert(vertShader);
-
-    VkShaderModule fragShader { VK_NULL_HANDLE };
-    fragShader = loadShader(device, "../shaders/mesh.frag.spv");
-    assert(fragShader);
-
-    // only need PCs for vertex stage
+    // only need PCs for vertex stage, the fragment stage gets the material from there
     VkPushConstantRange range;
     range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     range.offset = 0;
     range.size = sizeof(MeshPushConstants);
 
+    // one layout for the mesh pipeline and every debug variant, each fragment shader has
+    // its own set and only that one is bound. the same layout means the same
+    // pre-rasterization library, so a variant only compiles its fragment shader
+    VkDescriptorSetLayout setLayouts[meshSetCount] {};
+    setLayouts[meshSetTextures] = bindlessTextures.layout();
+    setLayouts[meshSetOverdraw] = overdrawDescriptorLayout;
+    setLayouts[meshSetVirtual] = virtualDescriptorLayout;
+
     VkPipelineLayoutCreateInfo info {};
     info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     info.pNext = nullptr;
     info.flags = 0;
     info.pushConstantRangeCount = 1;
     info.pPushConstantRanges = &range;
-    info.pSetLayouts = &meshDescriptorLayout;
-    info.setLayoutCount = 1;
+    info.pSetLayouts = setLayouts;
+    info.setLayoutCount = meshSetCount;
 
     VK_CHECK(vkCreatePipelineLayout(device, &info, nullptr, &meshPipelineLayout));
 
+    meshPipeline = buildMeshPipeline("../shaders/mesh.frag.spv");
+}
+
+// everything but the fragment stage is the same for the mesh pipeline and its debug variants,
+// the layout included. with pipeline libraries only the fragment shader part compiles per variant
+AsyncPipeline Mesh::buildMeshPipeline(const char* fragShaderPath) {
+    // the vertex shader has to match the layout loadObj uploaded
+    const char* vertShaderPath = vertexFormat == VertexFormat::Packed ? "../shaders/meshPacked.vert.spv" : "../shaders/mesh.vert.spv";
+
     vertexBindings = {
         {0, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE}
     };
@@ -203,11 +382,11 @@ void Mesh::initInstancePipeline() {
     vertexAttributes = {
         {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceData, position)},
         {1, 0, VK_FORMAT_R32_SFLOAT, offsetof(InstanceData, scale)},
+        {2, 0, VK_FORMAT_R32_UINT, offsetof(InstanceData, surface)},
     };
 
     PipelineBuilder pipelineBuilder;
     pipelineBuilder.pipelineLayout = meshPipelineLayout;
-    pipelineBuilder.setShaders(vertShader, fragShader);
     pipelineBuilder.setInputTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
     pipelineBuilder.setPolygonMode(VK_POLYGON_MODE_FILL);
     pipelineBuilder.setCullMode(VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE);
@@ -225,93 +404,140 @@ void Mesh::initInstancePipeline() {
     pipelineBuilder.vertexInputInfo.vertexAttributeDescriptionCount = vertexAttributes.size();
     pipelineBuilder.vertexInputInfo.pVertexAttributeDescriptions = vertexAttributes.data();
 
-    meshPipeline = pipelineBuilder.buildPipeline(device);
-
-    vkDestroyShaderModule(device, fragShader, nullptr);
-    vkDestroyShaderModule(device, vertShader, nullptr);
+    return pipelineCompiler.compileGraphics(pipelineBuilder, vertShaderPath, fragShaderPath);
 }
 
 void Mesh::initCullPipeline() {
-    VkShaderModule cullShader;
-    cullShader = loadShader(device, "../shaders/cull.comp.glsl.spv");
-    assert(cullShader);
+    VkPushConstantRange range;
+    range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    range.offset = 0;
+    range.size = sizeof(BinningPushConstants);
 
     VkPipelineLayoutCreateInfo info {};
     info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     info.pNext = nullptr;
     info.flags = 0;
+    info.pushConstantRangeCount = 1;
+    info.pPushConstantRanges = &range;
     info.pSetLayouts = &cullDescriptorLayout;
     info.setLayoutCount = 1;
 
     VK_CHECK(vkCreatePipelineLayout(device, &info, nullptr, &cullPipelineLayout));
 
-    VkPipelineShaderStageCreateInfo stageInfo = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
-    stageInfo.pNext = nullptr;
-    stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    stageInfo.module = cullShader;
-    stageInfo.pName = "main";
-
-    VkComputePipelineCreateInfo pipelineInfo = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
-    pipelineInfo.pNext = nullptr;
-    pipelineInfo.layout = cullPipelineLayout;
-    pipelineInfo.stage = stageInfo;
+    cullBuild = pipelineCompiler.compileCompute(cullPipelineLayout, "../shaders/cull.comp.glsl.spv", { cullTuner.size() });
+    binScanBuild = pipelineCompiler.compileCompute(cullPipelineLayout, "../shaders/binScan.comp.glsl.spv");
+    binScatterBuild = pipelineCompiler.compileCompute(cullPipelineLayout, "../shaders/binScatter.comp.glsl.spv",
+                                                      { cullTuner.size() });
+}
 
-    VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &cullPipeline));
+// IDK_TUNE_WORKGROUPS=1: cull with every size the device allows and keep the fastest.
+// needs the instances and the descriptor sets, so it runs after the uploads
+void Mesh::tuneCullWorkgroup() {
+    std::vector<std::shared_future<VkPipeline>> builds;
+    for (uint32_t size : cullTuner.candidates()) {
+        builds.push_back(pipelineCompiler.compileCompute(cullPipelineLayout, "../shaders/cull.comp.glsl.spv", { size }));
+    }
+    std::vector<VkPipeline> candidates;
+    for (auto& build : builds) {
+        candidates.push_back(build.get());
+    }
 
-    vkDestroyShaderModule(device, cullShader, nullptr);
+    // a real frustum, culling everything or nothing isn't what a frame does
+    updatePerFrameData(0);
+
+    uint32_t previous = cullTuner.size();
+    std::cout << "Tuning cull workgroup size over " << trueInstanceCount << " instances" << std::endl;
+    uint32_t tuned = cullTuner.tune(device,
+        [this](std::function<void(VkCommandBuffer)>&& function) { immediateSubmit(std::move(function)); },
+        [&](VkCommandBuffer cmd, uint32_t candidate) {
+            recordCull(cmd, 0, candidates[candidate], cullTuner.candidates()[candidate]);
+        });
+
+    if (tuned != previous) {
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (cullTuner.candidates()[i] == tuned) {
+                cullPipeline = candidates[i];
+            }
+        }
+        binScatterPipeline = pipelineCompiler.compileCompute(cullPipelineLayout, "../shaders/binScatter.comp.glsl.spv",
+                                                             { tuned }).get();
+    }
 }
 
-void Mesh::createIndirectCmdBuffer() {
-    drawIndirectCmds.resize(trueInstanceCount);
-    size_t bufferSize = sizeof(DrawIndexedIndirectCommand) * trueInstanceCount;
+void Mesh::createBinningBuffers() {
+    // nothing to upload, binScan rewrites every command each frame
+    uint32_t bucketCount = materials.bucketCount();
 
-    for (uint32_t i = 0; i < trueInstanceCount; i++) {
-        drawIndirectCmds[i].indexCount = indexCount;
-        drawIndirectCmds[i].instanceCount = 0;
-        drawIndirectCmds[i].firstIndex = 0;
-        drawIndirectCmds[i].vertexOffset = 0;
-        drawIndirectCmds[i].firstInstance = i;
+    for (uint32_t i = 0; i < MAX_FRAMES; i++) {
+        drawCmdBuffers[i] = createAllocatedBuffer(sizeof(DrawIndexedIndirectCommand) * bucketCount,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::PerFrame, "indirect commands");
+        bucketCountBuffers[i] = createAllocatedBuffer(sizeof(uint32_t) * bucketCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::PerFrame, "bucket counts");
+        instanceRankBuffers[i] = createAllocatedBuffer(sizeof(uint32_t) * trueInstanceCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::PerFrame, "instance ranks");
+        binnedInstanceBuffers[i] = createAllocatedBuffer(sizeof(InstanceData) * trueInstanceCount,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::PerFrame, "binned instances");
     }
+}
 
-    drawCmdBuffer = createAllocatedBuffer(
-       bufferSize,
-       VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
-       VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-       VMA_MEMORY_USAGE_GPU_ONLY
-   );
+static void memoryBarrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                          VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
 
-    AllocatedBuffer staging = createAllocatedBuffer(
-        bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VMA_MEMORY_USAGE_CPU_TO_GPU
-    );
+// the cull pass on its own, the workgroup tuner times just this
+void Mesh::recordCull(VkCommandBuffer cmd, uint32_t frameIndex, VkPipeline pipeline, uint32_t workgroupSize) {
+    vkCmdFillBuffer(cmd, bucketCountBuffers[frameIndex].buffer, 0, VK_WHOLE_SIZE, 0);
+    vkCmdFillBuffer(cmd, cullStatsBuffers[frameIndex].buffer, 0, VK_WHOLE_SIZE, 0);
 
-    void* data;
-    vmaMapMemory(allocator, staging.allocation, &data);
-    memcpy(data, drawIndirectCmds.data(), bufferSize);
-    vmaUnmapMemory(allocator, staging.allocation);
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
 
-    immediateSubmit([&](VkCommandBuffer cmd) {
-        VkBufferCopy copy{};
-        copy.size = bufferSize;
-        vkCmdCopyBuffer(cmd, staging.buffer, drawCmdBuffer.buffer, 1, &copy);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                           cullPipelineLayout, 0, 1,
+                           &cullDescriptorSets[frameIndex], 0, nullptr);
 
-        VkMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    BinningPushConstants binning { trueInstanceCount, materials.bucketCount() };
+    vkCmdPushConstants(cmd, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BinningPushConstants), &binning);
 
-        vkCmdPipelineBarrier(cmd,
-        VK_PIPELINE_STAGE_TRANSFER_BIT,
-        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-        0, 1, &barrier, 0, nullptr, 0, nullptr);
-    });
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdDispatch(cmd, (trueInstanceCount + workgroupSize - 1) / workgroupSize, 1, 1);
+}
+
+// cull -> count per bucket, scan -> one indirect command per bucket, scatter -> instances
+// grouped by bucket. no CPU work per instance or per material
+void Mesh::recordBinning(VkCommandBuffer cmd, uint32_t frameIndex) {
+    // cull and binScatter are both built with cullTuner's size
+    uint32_t workgroupSize = cullTuner.size();
+    recordCull(cmd, frameIndex, cullPipeline, workgroupSize);
+
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, binScanPipeline);
+    vkCmdDispatch(cmd, 1, 1, 1);
 
-    vmaDestroyBuffer(allocator, staging.buffer, staging.allocation);
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, binScatterPipeline);
+    vkCmdDispatch(cmd, (trueInstanceCount + workgroupSize - 1) / workgroupSize, 1, 1);
+
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                  VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
 }
 
 void Mesh::recordCommands(VkCommandBuffer cmd, uint32_t frameNumber, VkImageView swapchainImageView) {
+    TRACE_FUNCTION();
+
     uint32_t frameIndex = frameNumber % MAX_FRAMES;
 
     beginCommands(cmd, swapchainImageView);
@@ -321,47 +547,102 @@ void Mesh::recordCommands(VkCommandBuffer cmd, uint32_t frameNumber, VkImageView
     VkRect2D scissor = initScissor(viewport);
     vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline);
+    // the fast link until the optimized one is done. the virtual texture variant draws as
+    // the plain mesh while it compiles
+    VkPipeline pipeline = meshPipeline.current();
+    uint32_t set = meshSetTextures;
+    VkDescriptorSet descriptorSet = bindlessTextures.descriptorSet(frameIndex);
+    if (overdrawMode) {
+        pipeline = overdrawPipeline.current();
+        set = meshSetOverdraw;
+        descriptorSet = overdrawDescriptorSet;
+    } else if (virtualTextureMode && virtualPipeline.current() != VK_NULL_HANDLE) {
+        pipeline = virtualPipeline.current();
+        set = meshSetVirtual;
+        descriptorSet = virtualDescriptorSets[frameIndex];
+    }
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
     VkDeviceSize offset = 0;
 
-    // send draw params to GPU
-    vkCmdBindVertexBuffers(cmd, 0, 1, &instanceBuffer.buffer, &offset);
+    // the instances binScatter grouped by material, each bucket's draw starts at its firstInstance
+    vkCmdBindVertexBuffers(cmd, 0, 1, &binnedInstanceBuffers[frameIndex].buffer, &offset);
 
-    vkCmdBindIndexBuffer(cmd, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdBindIndexBuffer(cmd, indexBuffer.buffer, 0, indexType);
 
     pushConstants.worldMatrix = transform;
     pushConstants.vertexBuffer = vertexBuffer.bufferAddress;
+    pushConstants.materialBuffer = materialBuffer.bufferAddress;
+    pushConstants.surfaceBuffer = surfaceBuffer.bufferAddress;
+    pushConstants.nodeBuffer = nodeBuffers[frameIndex].bufferAddress;
+    pushConstants.positionScale = vertexScale;
+    pushConstants.positionOffset = vertexOffset;
 
     vkCmdPushConstants(cmd, meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
         0, sizeof(MeshPushConstants), &pushConstants);
 
     vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipelineLayout,
-                                   0, 1, &imageDescriptorSets[frameIndex], 0, nullptr);
+                                   set, 1, &descriptorSet, 0, nullptr);
 
-    // use draw params on GPU to render all blocks.
-    // no need to iterate 0 -> object count. one call very nice.
-    vkCmdDrawIndexedIndirect(cmd, drawCmdBuffer.buffer, 0, trueInstanceCount, sizeof(DrawIndexedIndirectCommand));
+    pipelineStats.begin(cmd, frameIndex);
+
+    // one indirect command per material bucket, and a pipeline's buckets are next to each
+    // other so it's one call per pipeline. there's only meshPipeline so far
+    for (const MaterialTable::PipelineRange& range : materials.pipelineRanges()) {
+        vkCmdDrawIndexedIndirect(cmd, drawCmdBuffers[frameIndex].buffer,
+            range.firstBucket * sizeof(DrawIndexedIndirectCommand), range.bucketCount, sizeof(DrawIndexedIndirectCommand));
+    }
+
+    pipelineStats.end(cmd, frameIndex);
 
     endCommands(cmd);
 }
 
 void Mesh::drawFrame() {
+    TRACE_FUNCTION();
+
     uint32_t frameIndex = currentFrame % MAX_FRAMES;
     FrameData& frame = frames[frameIndex];
 
-    camera.processEvent(window);
+    memoryTelemetry.onFrame(currentFrame);
+
+    if (window) {
+        camera.processEvent(window);
+    }
     camera.velocity *= 0.01f;
 
     updatePerFrameData(frameIndex);
 
-    VK_CHECK(vkWaitForFences(device, 1, &frame.renderFence, VK_TRUE, UINT64_MAX));
+    {
+        TRACE_ZONE("wait render fence");
+        VK_CHECK(vkWaitForFences(device, 1, &frame.renderFence, VK_TRUE, UINT64_MAX));
+    }
+
+    // the slot's previous frame is done now, so its feedback, cull stats and queries are safe to read
+    if (virtualTextureMode) {
+        virtualTextures.update(frameIndex, currentFrame);
+    }
+    if (currentFrame % 1000 == 0 && currentFrame >= MAX_FRAMES) {
+        readCullStats(frameIndex);
+    }
 
-    uint32_t swapchainImageIndex;
-    VkResult result = swapchain.acquireNextImage(frame.imgAvailable, swapchainImageIndex);
+    // headless draws every frame into the one offscreen target, the queue orders them
+    uint32_t swapchainImageIndex = 0;
+    VkImage targetImage = headlessTarget.image;
+    VkImageView targetView = headlessTarget.imageView;
+    if (!headless) {
+        VkResult result;
+        {
+            TRACE_ZONE("acquire image");
+            result = swapchain.acquireNextImage(frame.imgAvailable, swapchainImageIndex);
+        }
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-        // think it's out of date or suboptimal . . . anyways . . . accommodate resizes
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+            // think it's out of date or suboptimal . . . anyways . . . accommodate resizes
+        }
+        targetImage = swapchain.images[swapchainImageIndex];
+        targetView = swapchain.imageViews[swapchainImageIndex];
     }
 
     VK_CHECK(vkResetFences(device, 1, &frame.renderFence));
@@ -373,36 +654,42 @@ void Mesh::drawFrame() {
 
     VK_CHECK(vkBeginCommandBuffer(frame.commandBuffer, &beginInfo));
 
-    vkCmdBindPipeline(frame.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
-    vkCmdBindDescriptorSets(frame.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
-                           cullPipelineLayout, 0, 1,
-                           &cullDescriptorSets[frameIndex], 0, nullptr);
+    // acquires whatever finished streaming. this slot's copy of the bindless table is only
+    // rewritten now that its previous frame is done with it, the others catch up when they come around
+    uint64_t textureWaitValue = textureStreamer.update(frame.commandBuffer);
+    bindlessTextures.flush(frameIndex);
 
-    // can change # depending on capabilities . . . 64, 128, 256
-    uint32_t optimalLocalSize = 128;
-    uint32_t workgroupCount = (trueInstanceCount + optimalLocalSize - 1) / optimalLocalSize;
-    vkCmdDispatch(frame.commandBuffer, workgroupCount, 1, 1);
+    gpuProfiler.beginFrame(frame.commandBuffer, frameIndex);
+    pipelineStats.reset(frame.commandBuffer, frameIndex);
 
-    VkMemoryBarrier barrier = {};
-    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    uint32_t cullZone = gpuProfiler.beginZone(frame.commandBuffer, "cull");
+
+    recordBinning(frame.commandBuffer, frameIndex);
 
-    vkCmdPipelineBarrier(frame.commandBuffer,
-                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
-                        0, 1, &barrier,
-                        0, nullptr,
-                        0, nullptr);
+    gpuProfiler.endZone(frame.commandBuffer, cullZone);
+
+    if (overdrawMode) {
+        recordOverdrawClear(frame.commandBuffer);
+    }
 
-    transitionImage(frame.commandBuffer, swapchain.images[swapchainImageIndex],
+    transitionImage(frame.commandBuffer, targetImage,
         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-    recordCommands(frame.commandBuffer, frameIndex, swapchain.imageViews[swapchainImageIndex]);
+    {
+        TRACE_GPU_ZONE(gpuProfiler, frame.commandBuffer, "mesh pass");
+        recordCommands(frame.commandBuffer, frameIndex, targetView);
+    }
 
-    transitionImage(frame.commandBuffer, swapchain.images[swapchainImageIndex],
-         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    bool captureOverdraw = overdrawMode && currentFrame == overdrawCaptureFrame;
+    if (captureOverdraw) {
+        recordOverdrawReadback(frame.commandBuffer);
+    }
+
+    if (!headless) {
+        transitionImage(frame.commandBuffer, targetImage,
+             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    }
 
     VK_CHECK(vkEndCommandBuffer(frame.commandBuffer));
 
@@ -420,23 +707,61 @@ void Mesh::drawFrame() {
     signalSemaphoreInfo.semaphore = frame.renderComplete;
     signalSemaphoreInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT;
 
-    VkSubmitInfo2 submitInfo = createSubmitInfo(&cmdInfo, &signalSemaphoreInfo, &waitSemaphoreInfo);
+    // headless has no acquire to wait on and no present to signal
+    VkSemaphoreSubmitInfo waitSemaphoreInfos[2];
+    uint32_t waitCount = 0;
+    if (!headless) {
+        waitSemaphoreInfos[waitCount++] = waitSemaphoreInfo;
+    }
+    if (textureWaitValue > 0) {
+        waitSemaphoreInfos[waitCount++] = textureStreamer.waitInfo(textureWaitValue);
+    }
 
-    VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submitInfo, frame.renderFence));
+    VkSubmitInfo2 submitInfo = createSubmitInfo(&cmdInfo, headless ? nullptr : &signalSemaphoreInfo, waitSemaphoreInfos);
+    submitInfo.waitSemaphoreInfoCount = waitCount;
 
-    if (currentFrame % 1000 == 0) {
-        readCullStats(frameIndex);
+    {
+        TRACE_ZONE("submit");
+        std::lock_guard lock(graphicsQueueMutex);
+        VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submitInfo, frame.renderFence));
+    }
+
+    if (captureOverdraw) {
+        // debug capture, stalling here is fine
+        VK_CHECK(vkWaitForFences(device, 1, &frame.renderFence, VK_TRUE, UINT64_MAX));
+        writeOverdrawReport();
+        requestClose();
     }
 
-    VkPresentInfoKHR presentInfo = getPresentInfoKHR(&frame.renderComplete, &swapchain.swapchain, swapchainImageIndex);
+    if (!headless) {
+        VkPresentInfoKHR presentInfo = getPresentInfoKHR(&frame.renderComplete, &swapchain.swapchain, swapchainImageIndex);
 
-    VkResult presentResult = vkQueuePresentKHR(presentQueue, &presentInfo);
+        VkResult presentResult;
+        {
+            TRACE_ZONE("present");
+            // usually the same VkQueue as graphics
+            std::lock_guard lock(graphicsQueueMutex);
+            presentResult = vkQueuePresentKHR(presentQueue, &presentInfo);
+        }
+
+        if (presentResult == VK_ERROR_OUT_OF_DATE_KHR) {
+            // need to handle swapchain resizes
+        }
+    }
 
-    if (presentResult == VK_ERROR_OUT_OF_DATE_KHR) {
-        // need to handle swapchain resizes
+    if (!startup::firstFrameDone()) {
+        startup::markFirstFrame();
+        if (envFlag("IDK_STARTUP_EXIT")) {
+            requestClose();
+        }
     }
 
     currentFrame++;
+
+    // nobody is there to press escape
+    if (headless && headlessFrames > 0 && currentFrame >= headlessFrames) {
+        requestClose();
+    }
 }
 
 void Mesh::updateCullData(uint32_t frameIndex) {
@@ -461,11 +786,14 @@ void Mesh::updatePerFrameData(uint32_t frameIndex) {
 
     camera.updateFrustum(proj);
     updateCullData(frameIndex);
+    updateNodeWorlds(frameIndex);
 
     transform = camera.getFrustumData().viewProj * model;
 }
 
 void Mesh::readCullStats(uint32_t frameIndex) {
+    TRACE_FUNCTION();
+
     CullStats stats;
     void* data;
     vmaMapMemory(allocator, cullStatsBuffers[frameIndex].allocation, &data);
@@ -475,48 +803,223 @@ void Mesh::readCullStats(uint32_t frameIndex) {
     std::cout << "Inside Frustum: " << stats.visibleCount
               << " / " << stats.totalCount
               << " (" << (100.0f * stats.visibleCount / stats.totalCount) << "%)" << std::endl;
+
+    PipelineStats pipeline;
+    if (!pipelineStats.read(frameIndex, pipeline)) {
+        return;
+    }
+
+    // what the draw would have cost without the cull pass vs. what actually went in. an
+    // instance is one surface, so this is the model's average
+    uint64_t trianglesPerInstance = indexCount / 3 / materials.surfaceCount();
+    uint64_t allTriangles = trianglesPerInstance * stats.totalCount;
+    uint64_t visibleTriangles = trianglesPerInstance * stats.visibleCount;
+    uint64_t pixels = uint64_t(swapchain.swapchainExtent.width) * swapchain.swapchainExtent.height;
+
+    std::cout << "  IA primitives:        " << pipeline.inputAssemblyPrimitives
+              << " (expected " << visibleTriangles << ", instance culling removed "
+              << allTriangles - std::min(allTriangles, pipeline.inputAssemblyPrimitives) << ")" << std::endl;
+    std::cout << "  VS invocations:       " << pipeline.vertexInvocations
+              << " (" << (pipeline.inputAssemblyPrimitives ? double(pipeline.vertexInvocations) / pipeline.inputAssemblyPrimitives : 0.0)
+              << " per triangle)" << std::endl;
+    std::cout << "  clipping in / out:    " << pipeline.clippingInvocations << " / " << pipeline.clippingPrimitives << std::endl;
+    std::cout << "  FS invocations:       " << pipeline.fragmentInvocations
+              << " (" << double(pipeline.fragmentInvocations) / pixels << " per pixel)" << std::endl;
+}
+
+void Mesh::initOverdrawCapture() {
+    // the overdraw shaders count with image and buffer atomics in the fragment stage
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    if (!features.fragmentStoresAndAtomics) {
+        std::cerr << "fragmentStoresAndAtomics not supported, overdraw capture disabled" << std::endl;
+        return;
+    }
+
+    overdrawMode = true;
+    overdrawCaptureFrame = static_cast<uint32_t>(envNumber("IDK_OVERDRAW_FRAMES", 60.0));
+
+    // quad stats need quad ops in the fragment stage, otherwise only count fragments
+    VkPhysicalDeviceSubgroupProperties subgroupProps { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES };
+    VkPhysicalDeviceProperties2 props2 { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+    props2.pNext = &subgroupProps;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &props2);
+
+    overdrawQuadStats = (subgroupProps.supportedStages & VK_SHADER_STAGE_FRAGMENT_BIT) &&
+                        (subgroupProps.supportedOperations & VK_SUBGROUP_FEATURE_QUAD_BIT);
+
+    VkExtent3D extent = { swapchain.swapchainExtent.width, swapchain.swapchainExtent.height, 1 };
+
+    overdrawImage = createAllocatedImage(extent, VK_FORMAT_R32_UINT,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, false,
+        MemoryCategory::RenderTarget, "overdraw");
+
+    overdrawCounters = createAllocatedBuffer(sizeof(QuadCounters),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_TO_CPU, MemoryCategory::PerFrame, "overdraw counters");
+
+    overdrawReadback = createAllocatedBuffer(sizeof(uint32_t) * extent.width * extent.height,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_TO_CPU, MemoryCategory::Staging, "overdraw readback");
+
+    immediateSubmit([&](VkCommandBuffer cmd) {
+        transitionImage(cmd, overdrawImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    });
+
+    overdrawDescriptorSet = frames[0]._frameDescriptors.allocate(device, overdrawDescriptorLayout);
+    DescriptorWriter writer;
+    writer.writeImage(0, overdrawImage.imageView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    writer.writeBuffer(1, overdrawCounters.buffer, sizeof(QuadCounters), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    writer.updateSet(device, overdrawDescriptorSet);
+
+    overdrawPipeline = buildMeshPipeline(overdrawQuadStats ? "../shaders/overdrawQuad.frag.spv" : "../shaders/overdraw.frag.spv");
+    // the capture frame counts whatever was drawn, that has to be the overdraw shader
+    overdrawPipeline.fast.get();
+
+    std::cout << "Overdraw capture at frame " << overdrawCaptureFrame
+              << (overdrawQuadStats ? " (with quad stats)" : " (no quad stats)") << std::endl;
+}
+
+void Mesh::recordOverdrawClear(VkCommandBuffer cmd) {
+    // the previous frame may still be adding into the same image
+    VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmd,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkClearColorValue clear = {};
+    VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdClearColorImage(cmd, overdrawImage.image, VK_IMAGE_LAYOUT_GENERAL, &clear, 1, &range);
+    vkCmdFillBuffer(cmd, overdrawCounters.buffer, 0, VK_WHOLE_SIZE, 0);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmd,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void Mesh::recordOverdrawReadback(VkCommandBuffer cmd) {
+    VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    vkCmdPipelineBarrier(cmd,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = overdrawImage.imageExtent;
+
+    vkCmdCopyImageToBuffer(cmd, overdrawImage.image, VK_IMAGE_LAYOUT_GENERAL, overdrawReadback.buffer, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(cmd,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void Mesh::writeOverdrawReport() {
+    TRACE_FUNCTION();
+
+    vmaInvalidateAllocation(allocator, overdrawReadback.allocation, 0, VK_WHOLE_SIZE);
+    vmaInvalidateAllocation(allocator, overdrawCounters.allocation, 0, VK_WHOLE_SIZE);
+
+    uint32_t width = overdrawImage.imageExtent.width;
+    uint32_t height = overdrawImage.imageExtent.height;
+    std::span<const uint32_t> counts(static_cast<const uint32_t*>(overdrawReadback.info.pMappedData), size_t(width) * height);
+
+    QuadCounters quads;
+    memcpy(&quads, overdrawCounters.info.pMappedData, sizeof(QuadCounters));
+
+    OverdrawReport report = analyzeOverdraw(counts, overdrawQuadStats ? &quads : nullptr);
+    printOverdrawReport(report);
+
+    std::string path = envString("IDK_OVERDRAW_OUTPUT", "overdraw.png");
+    uint32_t scale = static_cast<uint32_t>(envNumber("IDK_OVERDRAW_SCALE", 8.0));
+    writeOverdrawHeatmap(path.c_str(), counts, width, height, scale);
+}
+
+void Mesh::initVirtualTexturing() {
+    virtualTextureMode = true;
+
+    initVirtualTextures();
+    barrelVirtualTexture = virtualTextures.add("../assets/barrel/Barrel_Base_Color.png");
+
+    for (uint32_t i = 0; i < MAX_FRAMES; i++) {
+        virtualDescriptorSets[i] = frames[i]._frameDescriptors.allocate(device, virtualDescriptorLayout);
+        virtualTextures.writeDescriptors(virtualDescriptorSets[i], i);
+    }
+
+    virtualPipeline = buildMeshPipeline("../shaders/meshVirtual.frag.spv");
 }
 
 void Mesh::run() {
-    while (!glfwWindowShouldClose(window)) {
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-            break;
-        }
+    headlessFrames = static_cast<uint32_t>(envNumber("IDK_HEADLESS_FRAMES", 0.0));
 
-        glfwPollEvents();
+    while (!shouldClose()) {
+        if (window) {
+            if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+                break;
+            }
+            glfwPollEvents();
+        }
         drawFrame();
     }
 
     vkDeviceWaitIdle(device);
+
+    memoryTelemetry.dumpJson();
 }
 
 Mesh::~Mesh() {
+    // a compile job may still be using the layouts below, the pipelines are the compiler's
+    pipelineCompiler.wait();
     vkDeviceWaitIdle(device);
 
     swapchain.cleanup();
-    vkDestroyImageView(device, textureImage.imageView, nullptr);
-    vmaDestroyImage(allocator, textureImage.image, textureImage.allocation);
     vkDestroyImageView(device, depthImage.imageView, nullptr);
-    vmaDestroyImage(allocator, depthImage.image, depthImage.allocation);
-
-    vkDestroySampler(device, texSampler, nullptr);
+    destroyAllocatedImage(depthImage.image, depthImage.allocation);
 
     for (uint32_t i = 0; i < MAX_FRAMES; i++) {
         frames[i]._frameDescriptors.destroyPools(device);
-        vmaDestroyBuffer(allocator, cullDataBuffers[i].buffer, cullDataBuffers[i].allocation);
-        vmaDestroyBuffer(allocator, cullStatsBuffers[i].buffer, cullStatsBuffers[i].allocation);
+        destroyAllocatedBuffer(cullDataBuffers[i].buffer, cullDataBuffers[i].allocation);
+        destroyAllocatedBuffer(cullStatsBuffers[i].buffer, cullStatsBuffers[i].allocation);
+        destroyAllocatedBuffer(drawCmdBuffers[i].buffer, drawCmdBuffers[i].allocation);
+        destroyAllocatedBuffer(bucketCountBuffers[i].buffer, bucketCountBuffers[i].allocation);
+        destroyAllocatedBuffer(instanceRankBuffers[i].buffer, instanceRankBuffers[i].allocation);
+        destroyAllocatedBuffer(binnedInstanceBuffers[i].buffer, binnedInstanceBuffers[i].allocation);
+        destroyAllocatedBuffer(nodeBuffers[i].buffer, nodeBuffers[i].allocation);
     }
 
-    vmaDestroyBuffer(allocator, vertexBuffer.buffer, vertexBuffer.allocation);
-    vmaDestroyBuffer(allocator, indexBuffer.buffer, indexBuffer.allocation);
-    vmaDestroyBuffer(allocator, drawCmdBuffer.buffer, drawCmdBuffer.allocation);
-    vmaDestroyBuffer(allocator, instanceBuffer.buffer, instanceBuffer.allocation);
+    destroyAllocatedBuffer(vertexBuffer.buffer, vertexBuffer.allocation);
+    destroyAllocatedBuffer(indexBuffer.buffer, indexBuffer.allocation);
+    destroyAllocatedBuffer(instanceBuffer.buffer, instanceBuffer.allocation);
+    destroyAllocatedBuffer(materialBuffer.buffer, materialBuffer.allocation);
+    destroyAllocatedBuffer(surfaceBuffer.buffer, surfaceBuffer.allocation);
+    destroyAllocatedBuffer(bucketBuffer.buffer, bucketBuffer.allocation);
 
-    vkDestroyDescriptorSetLayout(device, meshDescriptorLayout, nullptr);
     vkDestroyPipelineLayout(device, meshPipelineLayout, nullptr);
-    vkDestroyPipeline(device, meshPipeline, nullptr);
 
+    pipelineStats.destroy();
+
+    if (overdrawMode) {
+        vkDestroyImageView(device, overdrawImage.imageView, nullptr);
+        destroyAllocatedImage(overdrawImage.image, overdrawImage.allocation);
+        destroyAllocatedBuffer(overdrawCounters.buffer, overdrawCounters.allocation);
+        destroyAllocatedBuffer(overdrawReadback.buffer, overdrawReadback.allocation);
+    }
+
+    vkDestroyDescriptorSetLayout(device, overdrawDescriptorLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, virtualDescriptorLayout, nullptr);
     vkDestroyDescriptorSetLayout(device, cullDescriptorLayout, nullptr);
     vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
-    vkDestroyPipeline(device, cullPipeline, nullptr);
 }
@@ -4,9 +4,11 @@
 #include <memory>
 #include <array>
 #include "../base/base.h"
+#include "../tools/pipelineStats.h"
+#include "../tools/materialTable.h"
+#include "../tools/workgroupTuner.h"
 
 #define INSTANCE_COUNT 8000
-class GLTFLoader;
 
 using namespace std::chrono;
 
@@ -18,45 +20,101 @@ public:
     void run();
 
 private:
+    AllocatedBuffer createTableBuffer(const void* data, size_t size, VkBufferUsageFlags usage, const char* name);
+    void createMaterials();
+    void createNodeBuffers();
+    void updateNodeWorlds(uint32_t frameIndex);
     void createInstances();
     void createCullBuffers();
+    void initDescriptorLayouts();
     void initDescriptorSets();
     void initInstancePipeline();
+    AsyncPipeline buildMeshPipeline(const char* fragShaderPath);
     void initCullPipeline();
-    void createIndirectCmdBuffer();
+    void tuneCullWorkgroup();
+    void createBinningBuffers();
+    void recordCull(VkCommandBuffer cmd, uint32_t frameIndex, VkPipeline pipeline, uint32_t workgroupSize);
+    void recordBinning(VkCommandBuffer cmd, uint32_t frameIndex);
     void recordCommands(VkCommandBuffer cmd, uint32_t frameNumber, VkImageView swapchainImageView);
     void drawFrame();
     void updateCullData(uint32_t frameIndex);
     void updatePerFrameData(uint32_t frameIndex) override;
     void readCullStats(uint32_t frameIndex);
+    void initOverdrawCapture();
+    void recordOverdrawClear(VkCommandBuffer cmd);
+    void recordOverdrawReadback(VkCommandBuffer cmd);
+    void writeOverdrawReport();
+    void initVirtualTexturing();
+
+    // meshPipelineLayout's sets, one per fragment shader variant
+    enum MeshSet : uint32_t {
+        meshSetTextures,
+        meshSetOverdraw,
+        meshSetVirtual,
+        meshSetCount,
+    };
 
     VkPipelineLayout              meshPipelineLayout;
-    VkPipeline                    meshPipeline;
+    AsyncPipeline                 meshPipeline;
 
+    // cull, binScan and binScatter share the layout and the descriptor sets
     VkPipelineLayout              cullPipelineLayout;
     VkPipeline                    cullPipeline;
+    VkPipeline                    binScanPipeline;
+    VkPipeline                    binScatterPipeline;
+    // compiling until the constructor's parallel load is done
+    std::shared_future<VkPipeline> cullBuild;
+    std::shared_future<VkPipeline> binScanBuild;
+    std::shared_future<VkPipeline> binScatterBuild;
+    // the one place the cull and binScatter workgroup size comes from
+    WorkgroupTuner                cullTuner;
 
     MeshPushConstants             pushConstants;
 
-    VkDescriptorSetLayout                   meshDescriptorLayout;
-    std::array<VkDescriptorSet, MAX_FRAMES> imageDescriptorSets;
-
     VkDescriptorSetLayout                   cullDescriptorLayout;
     std::array<AllocatedBuffer, MAX_FRAMES> cullDataBuffers;
     std::array<AllocatedBuffer, MAX_FRAMES> cullStatsBuffers;
     std::array<VkDescriptorSet, MAX_FRAMES> cullDescriptorSets;
 
-    VkSampler                  texSampler;
+    // visible instances binned by material, one indirect command per bucket
+    std::array<AllocatedBuffer, MAX_FRAMES> drawCmdBuffers;
+    std::array<AllocatedBuffer, MAX_FRAMES> bucketCountBuffers;
+    std::array<AllocatedBuffer, MAX_FRAMES> instanceRankBuffers;
+    std::array<AllocatedBuffer, MAX_FRAMES> binnedInstanceBuffers;
+
+    PipelineStatsQuery                      pipelineStats;
+
+    // IDK_OVERDRAW=1 swaps the mesh pipeline for one that counts fragments per pixel
+    bool                       overdrawMode { false };
+    uint32_t                   overdrawCaptureFrame { 0 };
+    VkDescriptorSetLayout      overdrawDescriptorLayout { VK_NULL_HANDLE };
+    VkDescriptorSet            overdrawDescriptorSet { VK_NULL_HANDLE };
+    AsyncPipeline              overdrawPipeline;
+    AllocatedImage             overdrawImage;
+    AllocatedBuffer            overdrawCounters;
+    AllocatedBuffer            overdrawReadback;
+    bool                       overdrawQuadStats { false };
+
+    // IDK_VIRTUAL_TEXTURES=1 samples the barrel texture through the page atlas instead
+    bool                                    virtualTextureMode { false };
+    VirtualTextureId                        barrelVirtualTexture { 0 };
+    VkDescriptorSetLayout                   virtualDescriptorLayout { VK_NULL_HANDLE };
+    std::array<VkDescriptorSet, MAX_FRAMES> virtualDescriptorSets {};
+    AsyncPipeline                           virtualPipeline;
 
     glm::mat4                  transformMatrix;
     glm::mat4                  viewProj;
 
-    std::vector<DrawIndexedIndirectCommand> drawIndirectCmds;
     AllocatedBuffer            instanceBuffer;
-    AllocatedImage             textureImage;
+    TextureHandle              barrelTexture;              // the obj's default material, it has no .mtl read
+
+    MaterialTable              materials;
+    AllocatedBuffer            materialBuffer;
+    AllocatedBuffer            surfaceBuffer;
+    AllocatedBuffer            bucketBuffer;               // GpuBucket per bucket, binScan's index ranges
 
-    AllocatedBuffer            drawCmdBuffer;
-    DrawIndexedIndirectCommand indirectCommand;
+    // modelNodes' worlds, host visible so a moved node is a memcpy into the next frame's copy
+    std::array<AllocatedBuffer, MAX_FRAMES> nodeBuffers;
 
     std::vector<InstanceData>                      instances;
     uint32_t                                       trueInstanceCount;
@@ -64,4 +122,6 @@ private:
     std::vector<VkVertexInputAttributeDescription> vertexAttributes;
 
     uint32_t                   currentFrame { 0 };
+    // IDK_HEADLESS_FRAMES=n stops a headless run after n frames, 0 leaves it to the capture modes
+    uint32_t                   headlessFrames { 0 };
 };
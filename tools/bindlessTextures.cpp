@@ -0,0 +1,151 @@
+#include "bindlessTextures.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+void BindlessTextures::init(VkDevice _device, VkPhysicalDevice physicalDevice) {
+    device = _device;
+
+    VkPhysicalDeviceVulkan12Properties properties12 { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES };
+    VkPhysicalDeviceProperties2 properties { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+    properties.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    // combined image samplers count against both the sampler and the sampled image limits
+    slotCount = std::min({ maxTextures,
+                           properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+                           properties12.maxDescriptorSetUpdateAfterBindSamplers,
+                           properties12.maxPerStageDescriptorUpdateAfterBindSampledImages - sharedSamplers,
+                           properties12.maxPerStageDescriptorUpdateAfterBindSamplers - sharedSamplers });
+
+    // the same filtering the mesh pass always had, every texture shares it
+    VkSamplerCreateInfo samplerInfo = {.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.mipLodBias = -0.25f;
+    samplerInfo.anisotropyEnable = VK_TRUE;
+    samplerInfo.maxAnisotropy = std::min(16.0f, properties.properties.limits.maxSamplerAnisotropy);
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &sampler));
+
+    VkDescriptorSetLayoutBinding binding {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = slotCount;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
+    flagsInfo.bindingCount = 1;
+    flagsInfo.pBindingFlags = &bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    layoutInfo.pNext = &flagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout));
+
+    // update after bind sets need a pool of their own with the matching flag
+    VkDescriptorPoolSize poolSize { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, slotCount * MAX_FRAMES };
+
+    VkDescriptorPoolCreateInfo poolInfo { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = MAX_FRAMES;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool));
+
+    std::array<VkDescriptorSetLayout, MAX_FRAMES> layouts;
+    layouts.fill(setLayout);
+
+    VkDescriptorSetAllocateInfo allocInfo { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = MAX_FRAMES;
+    allocInfo.pSetLayouts = layouts.data();
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, sets.data()));
+
+    std::cout << "bindless texture table: " << slotCount << " slots" << std::endl;
+}
+
+void BindlessTextures::destroy() {
+    if (device == VK_NULL_HANDLE) {
+        return;
+    }
+
+    // the sets go with the pool
+    vkDestroyDescriptorPool(device, pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+    vkDestroySampler(device, sampler, nullptr);
+
+    views.clear();
+    for (auto& slots : dirty) {
+        slots.clear();
+    }
+    device = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessTextures::add(VkImageView view) {
+    std::lock_guard lock(mutex);
+    if (views.size() >= slotCount) {
+        throw std::runtime_error("bindless texture table is full");
+    }
+
+    uint32_t index = static_cast<uint32_t>(views.size());
+    views.push_back(view);
+    for (auto& slots : dirty) {
+        slots.push_back(index);
+    }
+    return index;
+}
+
+void BindlessTextures::set(uint32_t index, VkImageView view) {
+    std::lock_guard lock(mutex);
+    if (views[index] == view) {
+        return;
+    }
+
+    views[index] = view;
+    for (auto& slots : dirty) {
+        slots.push_back(index);
+    }
+}
+
+void BindlessTextures::flush(uint32_t frameIndex) {
+    std::lock_guard lock(mutex);
+    std::vector<uint32_t>& slots = dirty[frameIndex];
+    if (slots.empty()) {
+        return;
+    }
+
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+
+    std::vector<VkDescriptorImageInfo> imageInfos(slots.size());
+    std::vector<VkWriteDescriptorSet> writes(slots.size());
+    for (size_t i = 0; i < slots.size(); i++) {
+        imageInfos[i] = { sampler, views[slots[i]], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+        VkWriteDescriptorSet& write = writes[i];
+        write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        write.dstSet = sets[frameIndex];
+        write.dstBinding = 0;
+        write.dstArrayElement = slots[i];
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &imageInfos[i];
+    }
+
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    slots.clear();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "utils.h"
+
+// one descriptor table holding every texture that has been loaded, so draws stop
+// binding a set per texture and the shaders pick one with nonuniformEXT through
+// whatever index their instance or material carries (shaders/mesh.frag).
+//
+// the binding is PARTIALLY_BOUND so slots nobody has written yet are fine as long
+// as nothing indexes them, and UPDATE_AFTER_BIND so a slot can be written while the
+// set is bound. a slot a frame in flight might still read can't be touched though,
+// so every frame slot gets its own copy and set() only reaches a copy once flush()
+// runs for it after its fence.
+
+class BindlessTextures {
+public:
+    // upper bound, the device's update after bind limits can make it smaller
+    static constexpr uint32_t maxTextures { 4096 };
+    // left under the per stage limits for the other sets of a pipeline layout the table is in
+    static constexpr uint32_t sharedSamplers { 16 };
+
+    void init(VkDevice _device, VkPhysicalDevice physicalDevice);
+    void destroy();
+
+    // takes the next free slot and points it at view, any thread
+    uint32_t add(VkImageView view);
+    // repoints a slot, e.g. from the placeholder to the streamed image. any thread
+    void set(uint32_t index, VkImageView view);
+
+    // main thread, after the fence for frameIndex and before its draws are recorded
+    void flush(uint32_t frameIndex);
+
+    VkDescriptorSetLayout layout() const { return setLayout; }
+    VkDescriptorSet descriptorSet(uint32_t frameIndex) const { return sets[frameIndex]; }
+    uint32_t capacity() const { return slotCount; }
+
+private:
+    VkDevice                                         device    { VK_NULL_HANDLE };
+    VkSampler                                        sampler   { VK_NULL_HANDLE };
+    VkDescriptorSetLayout                            setLayout { VK_NULL_HANDLE };
+    VkDescriptorPool                                 pool      { VK_NULL_HANDLE };
+    std::array<VkDescriptorSet, MAX_FRAMES>          sets      {};
+    uint32_t                                         slotCount { 0 };
+
+    std::mutex                                       mutex;
+    std::vector<VkImageView>                         views;
+    std::array<std::vector<uint32_t>, MAX_FRAMES>    dirty;     // slots each frame's copy hasn't seen yet
+};
@@ -0,0 +1,376 @@
+#include "blockCompress.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// largest eigenvector of the covariance by power iteration, good enough for 16 points
+template<int N>
+void principalAxis(const float (*points)[N], int count, float mean[N], float axis[N]) {
+    for (int c = 0; c < N; c++) {
+        mean[c] = 0.0f;
+        for (int i = 0; i < count; i++) {
+            mean[c] += points[i][c];
+        }
+        mean[c] /= float(count);
+    }
+
+    float cov[N][N] = {};
+    for (int i = 0; i < count; i++) {
+        for (int a = 0; a < N; a++) {
+            for (int b = 0; b < N; b++) {
+                cov[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+            }
+        }
+    }
+
+    for (int c = 0; c < N; c++) {
+        axis[c] = 1.0f;
+    }
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[N] = {};
+        float length = 0.0f;
+        for (int a = 0; a < N; a++) {
+            for (int b = 0; b < N; b++) {
+                next[a] += cov[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f) {
+            break;
+        }
+        length = 1.0f / std::sqrt(length);
+        for (int c = 0; c < N; c++) {
+            axis[c] = next[c] * length;
+        }
+    }
+}
+
+// endpoints at the extremes of the block projected onto its principal axis
+template<int N>
+void axisEndpoints(const float (*points)[N], int count, float low[N], float high[N]) {
+    float mean[N];
+    float axis[N];
+    principalAxis<N>(points, count, mean, axis);
+
+    float tMin = 0.0f;
+    float tMax = 0.0f;
+    for (int i = 0; i < count; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < N; c++) {
+            t += (points[i][c] - mean[c]) * axis[c];
+        }
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    for (int c = 0; c < N; c++) {
+        low[c] = std::clamp(mean[c] + axis[c] * tMin, 0.0f, 255.0f);
+        high[c] = std::clamp(mean[c] + axis[c] * tMax, 0.0f, 255.0f);
+    }
+}
+
+// solves for the endpoints that best reproduce the block given fixed interpolation weights
+// (weight = how much of endpoint 0 each texel gets). false if the weights are degenerate
+template<int N>
+bool refitEndpoints(const float (*points)[N], const float* weights, int count, float e0[N], float e1[N]) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[N] = {}, bx[N] = {};
+    for (int i = 0; i < count; i++) {
+        float a = weights[i];
+        float b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < N; c++) {
+            ax[c] += a * points[i][c];
+            bx[c] += b * points[i][c];
+        }
+    }
+
+    float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f) {
+        return false;
+    }
+    det = 1.0f / det;
+    for (int c = 0; c < N; c++) {
+        e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) * det, 0.0f, 255.0f);
+        e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) * det, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+// little endian bit packing, the way every BC format lays out its fields
+struct BitWriter {
+    uint8_t* out;
+    uint32_t bit { 0 };
+
+    void put(uint32_t value, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++, bit++) {
+            out[bit >> 3] |= uint8_t(((value >> i) & 1u) << (bit & 7));
+        }
+    }
+};
+
+uint16_t packRgb565(const float rgb[3]) {
+    uint32_t r = static_cast<uint32_t>(std::lround(rgb[0] * 31.0f / 255.0f));
+    uint32_t g = static_cast<uint32_t>(std::lround(rgb[1] * 63.0f / 255.0f));
+    uint32_t b = static_cast<uint32_t>(std::lround(rgb[2] * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpackRgb565(uint16_t c, int rgb[3]) {
+    int r = (c >> 11) & 31;
+    int g = (c >> 5) & 63;
+    int b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+struct BC1Candidate {
+    uint16_t c0;
+    uint16_t c1;
+    uint8_t  indices[16];
+    int      error;
+};
+
+BC1Candidate evaluateBC1(const float (*points)[3], const float e0[3], const float e1[3]) {
+    BC1Candidate candidate {};
+    candidate.c0 = packRgb565(e0);
+    candidate.c1 = packRgb565(e1);
+    // four colour mode needs c0 > c1
+    if (candidate.c0 < candidate.c1) {
+        std::swap(candidate.c0, candidate.c1);
+    }
+
+    int palette[4][3];
+    unpackRgb565(candidate.c0, palette[0]);
+    unpackRgb565(candidate.c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    // c0 == c1 falls into three colour mode, where index 0 is still c0
+    int paletteSize = candidate.c0 == candidate.c1 ? 1 : 4;
+    for (int i = 0; i < 16; i++) {
+        int bestError = INT32_MAX;
+        for (int p = 0; p < paletteSize; p++) {
+            int error = 0;
+            for (int c = 0; c < 3; c++) {
+                int d = int(points[i][c]) - palette[p][c];
+                error += d * d;
+            }
+            if (error < bestError) {
+                bestError = error;
+                candidate.indices[i] = static_cast<uint8_t>(p);
+            }
+        }
+        candidate.error += bestError;
+    }
+    return candidate;
+}
+
+struct BC7Candidate {
+    uint8_t endpoints[2][4];   // 7 bit
+    uint8_t pbits[2];
+    uint8_t indices[16];
+    int     error;
+};
+
+constexpr int bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+BC7Candidate evaluateBC7Mode6(const float (*points)[4], const float e0[4], const float e1[4], int p0, int p1) {
+    BC7Candidate candidate {};
+    candidate.pbits[0] = static_cast<uint8_t>(p0);
+    candidate.pbits[1] = static_cast<uint8_t>(p1);
+
+    int expanded[2][4];
+    for (int c = 0; c < 4; c++) {
+        int q0 = std::clamp(static_cast<int>(std::lround((e0[c] - p0) * 0.5f)), 0, 127);
+        int q1 = std::clamp(static_cast<int>(std::lround((e1[c] - p1) * 0.5f)), 0, 127);
+        candidate.endpoints[0][c] = static_cast<uint8_t>(q0);
+        candidate.endpoints[1][c] = static_cast<uint8_t>(q1);
+        expanded[0][c] = (q0 << 1) | p0;
+        expanded[1][c] = (q1 << 1) | p1;
+    }
+
+    int palette[16][4];
+    for (int w = 0; w < 16; w++) {
+        for (int c = 0; c < 4; c++) {
+            palette[w][c] = ((64 - bc7Weights4[w]) * expanded[0][c] + bc7Weights4[w] * expanded[1][c] + 32) >> 6;
+        }
+    }
+
+    for (int i = 0; i < 16; i++) {
+        int bestError = INT32_MAX;
+        for (int w = 0; w < 16; w++) {
+            int error = 0;
+            for (int c = 0; c < 4; c++) {
+                int d = int(points[i][c]) - palette[w][c];
+                error += d * d;
+            }
+            if (error < bestError) {
+                bestError = error;
+                candidate.indices[i] = static_cast<uint8_t>(w);
+            }
+        }
+        candidate.error += bestError;
+    }
+    return candidate;
+}
+
+}
+
+uint32_t blockBytes(BlockCodec codec) {
+    return codec == BlockCodec::BC1 ? 8 : 16;
+}
+
+void encodeBC1Block(const uint8_t rgba[64], uint8_t out[8]) {
+    float points[16][3];
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            points[i][c] = rgba[i * 4 + c];
+        }
+    }
+
+    float e0[3], e1[3];
+    axisEndpoints<3>(points, 16, e1, e0);
+    BC1Candidate best = evaluateBC1(points, e0, e1);
+
+    // refit against the indices the first guess picked
+    constexpr float weightOfC0[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float weights[16];
+    for (int i = 0; i < 16; i++) {
+        weights[i] = weightOfC0[best.indices[i]];
+    }
+    if (best.c0 != best.c1 && refitEndpoints<3>(points, weights, 16, e0, e1)) {
+        BC1Candidate refit = evaluateBC1(points, e0, e1);
+        if (refit.error < best.error) {
+            best = refit;
+        }
+    }
+
+    memset(out, 0, 8);
+    BitWriter writer { out };
+    writer.put(best.c0, 16);
+    writer.put(best.c1, 16);
+    for (int i = 0; i < 16; i++) {
+        writer.put(best.indices[i], 2);
+    }
+}
+
+void encodeBC4Block(const uint8_t values[16], uint8_t out[8]) {
+    int high = *std::max_element(values, values + 16);
+    int low = *std::min_element(values, values + 16);
+
+    memset(out, 0, 8);
+    BitWriter writer { out };
+    writer.put(static_cast<uint32_t>(high), 8);
+    writer.put(static_cast<uint32_t>(low), 8);
+
+    // eight value mode (a0 > a1): index 0 = a0, 1 = a1, 2..7 step from a0 towards a1
+    for (int i = 0; i < 16; i++) {
+        uint32_t index = 0;
+        if (high > low) {
+            int step = static_cast<int>(std::lround(float(high - values[i]) * 7.0f / float(high - low)));
+            index = step == 0 ? 0 : step == 7 ? 1 : static_cast<uint32_t>(step + 1);
+        }
+        writer.put(index, 3);
+    }
+}
+
+void encodeBC5Block(const uint8_t rgba[64], uint8_t out[16]) {
+    uint8_t red[16], green[16];
+    for (int i = 0; i < 16; i++) {
+        red[i] = rgba[i * 4 + 0];
+        green[i] = rgba[i * 4 + 1];
+    }
+    encodeBC4Block(red, out);
+    encodeBC4Block(green, out + 8);
+}
+
+void encodeBC7Block(const uint8_t rgba[64], uint8_t out[16]) {
+    float points[16][4];
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            points[i][c] = rgba[i * 4 + c];
+        }
+    }
+
+    float e0[4], e1[4];
+    axisEndpoints<4>(points, 16, e0, e1);
+
+    BC7Candidate best {};
+    best.error = INT32_MAX;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int p = 0; p < 4; p++) {
+            BC7Candidate candidate = evaluateBC7Mode6(points, e0, e1, p & 1, p >> 1);
+            if (candidate.error < best.error) {
+                best = candidate;
+            }
+        }
+        if (best.error == 0 || pass == 1) {
+            break;
+        }
+
+        float weights[16];
+        for (int i = 0; i < 16; i++) {
+            weights[i] = 1.0f - bc7Weights4[best.indices[i]] / 64.0f;
+        }
+        if (!refitEndpoints<4>(points, weights, 16, e0, e1)) {
+            break;
+        }
+    }
+
+    // the first index is stored with its top bit implied zero, flip the block if it isn't
+    if (best.indices[0] & 8) {
+        std::swap(best.endpoints[0], best.endpoints[1]);
+        std::swap(best.pbits[0], best.pbits[1]);
+        for (uint8_t& index : best.indices) {
+            index = static_cast<uint8_t>(15 - index);
+        }
+    }
+
+    memset(out, 0, 16);
+    BitWriter writer { out };
+    writer.put(1u << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        writer.put(best.endpoints[0][c], 7);
+        writer.put(best.endpoints[1][c], 7);
+    }
+    writer.put(best.pbits[0], 1);
+    writer.put(best.pbits[1], 1);
+    writer.put(best.indices[0], 3);
+    for (int i = 1; i < 16; i++) {
+        writer.put(best.indices[i], 4);
+    }
+}
+
+void encodeBlockRows(const uint8_t* rgba, uint32_t width, uint32_t height, BlockCodec codec,
+                     uint32_t blockRowBegin, uint32_t blockRowEnd, uint8_t* out) {
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t stride = blockBytes(codec);
+
+    uint8_t block[64];
+    for (uint32_t by = blockRowBegin; by < blockRowEnd; by++) {
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            for (uint32_t y = 0; y < 4; y++) {
+                uint32_t sy = std::min(by * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t sx = std::min(bx * 4 + x, width - 1);
+                    memcpy(block + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4, 4);
+                }
+            }
+
+            uint8_t* dst = out + (size_t(by) * blocksX + bx) * stride;
+            switch (codec) {
+                case BlockCodec::BC1: encodeBC1Block(block, dst); break;
+                case BlockCodec::BC5: encodeBC5Block(block, dst); break;
+                case BlockCodec::BC7: encodeBC7Block(block, dst); break;
+            }
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+// CPU block compression for the texture cooker. everything works on 4x4 RGBA8 blocks.
+//
+//  BC1  rgb, 4 bpp. principal axis endpoints + one least squares refit
+//  BC5  two independent BC4 channels (normal map xy), 8 bpp
+//  BC7  mode 6 only: one subset, rgba 7.7.7.7 + p-bit endpoints, 4 bit indices, 8 bpp.
+//       no partitions, so sharp multi-colour blocks lose a bit against a full encoder,
+//       but it's fast enough to cook on first run
+
+enum class BlockCodec : uint8_t {
+    BC1,
+    BC5,
+    BC7,
+};
+
+uint32_t blockBytes(BlockCodec codec);
+
+void encodeBC1Block(const uint8_t rgba[64], uint8_t out[8]);
+void encodeBC4Block(const uint8_t values[16], uint8_t out[8]);
+void encodeBC5Block(const uint8_t rgba[64], uint8_t out[16]);
+void encodeBC7Block(const uint8_t rgba[64], uint8_t out[16]);
+
+// blocks for rows [blockRowBegin, blockRowEnd) of a width x height image, edges repeat the last texel
+void encodeBlockRows(const uint8_t* rgba, uint32_t width, uint32_t height, BlockCodec codec,
+                     uint32_t blockRowBegin, uint32_t blockRowEnd, uint8_t* out);
@@ -0,0 +1,185 @@
+#include "files.h"
+#include "hash.h"
+#include "settings.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        bytes = other.bytes;
+        length = other.length;
+        other.bytes = nullptr;
+        other.length = 0;
+#ifdef _WIN32
+        fileHandle = other.fileHandle;
+        mappingHandle = other.mappingHandle;
+        other.fileHandle = nullptr;
+        other.mappingHandle = nullptr;
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* path) {
+    close();
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    bytes = static_cast<const uint8_t*>(view);
+    length = static_cast<size_t>(fileSize.QuadPart);
+    fileHandle = file;
+    mappingHandle = mapping;
+    return true;
+}
+
+void MappedFile::close() {
+    if (bytes) {
+        UnmapViewOfFile(bytes);
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+    }
+    bytes = nullptr;
+    length = 0;
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char* path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+
+    // everything we map gets read front to back. the advice values aren't flags, one call each.
+    // only hints, the mapping works without them
+    if (madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL) != 0) {
+        std::cerr << "madvise(MADV_SEQUENTIAL) failed for " << path << ": " << strerror(errno) << std::endl;
+    }
+    if (madvise(view, static_cast<size_t>(info.st_size), MADV_WILLNEED) != 0) {
+        std::cerr << "madvise(MADV_WILLNEED) failed for " << path << ": " << strerror(errno) << std::endl;
+    }
+
+    bytes = static_cast<const uint8_t*>(view);
+    length = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (bytes) {
+        munmap(const_cast<uint8_t*>(bytes), length);
+    }
+    bytes = nullptr;
+    length = 0;
+}
+
+#endif
+
+bool writeFileAtomic(const std::string& path, std::span<const uint8_t> contents) {
+    std::error_code error;
+    std::filesystem::path target(path);
+    if (target.has_parent_path()) {
+        std::filesystem::create_directories(target.parent_path(), error);
+    }
+
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Could not write " << tmpPath << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+        if (!file.good()) {
+            std::cerr << "Could not write " << tmpPath << std::endl;
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tmpPath, target, error);
+    if (error) {
+        std::cerr << "Could not rename " << tmpPath << " to " << path << ": " << error.message() << std::endl;
+        std::filesystem::remove(tmpPath, error);
+        return false;
+    }
+    return true;
+}
+
+std::string cacheFilePath(const char* sourcePath, const char* extension) {
+    std::string cacheDir = envString("IDK_CACHE_DIR", "cache");
+
+    // the path hash keeps Barrel.obj from two asset folders apart
+    std::string source = std::filesystem::path(sourcePath).lexically_normal().generic_string();
+    uint64_t pathHash = hash64(source.data(), source.size());
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "-%016llx.", static_cast<unsigned long long>(pathHash));
+
+    return cacheDir + "/" + std::filesystem::path(sourcePath).stem().string() + suffix + extension;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+// read-only memory map of a whole file. the OS pages it in on demand, so a loader
+// can copy straight out of it without an intermediate std::vector.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path);
+    void close();
+
+    const uint8_t* data() const { return bytes; }
+    size_t         size() const { return length; }
+    bool           isOpen() const { return bytes != nullptr; }
+
+    std::span<const uint8_t> span() const { return { bytes, length }; }
+
+private:
+    const uint8_t* bytes  { nullptr };
+    size_t         length { 0 };
+#ifdef _WIN32
+    void*          fileHandle    { nullptr };
+    void*          mappingHandle { nullptr };
+#endif
+};
+
+// writes to <path>.tmp then renames over path, so a crash never leaves a half written cache
+bool writeFileAtomic(const std::string& path, std::span<const uint8_t> contents);
+
+// where cooked versions of assets live: $IDK_CACHE_DIR (default "cache") / <name>-<path hash>.<extension>
+std::string cacheFilePath(const char* sourcePath, const char* extension);
@@ -1,610 +1,369 @@
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/transform.hpp>
-#include <glm/gtx/quaternion.hpp>
-#define TINYGLTF_IMPLEMENTATION
-#define STB_IMAGE_IMPLEMENTATION
-#define TINYGLTF_NO_STB_IMAGE_WRITE
-#include "tiny_gltf.h"
 #include "gltfLoader.h"
-#include "../src/mesh.h"
-#include "utils.h"
+#include "hash.h"
+#include "trace.h"
 
+#include <fastgltf/core.hpp>
+#include <fastgltf/glm_element_traits.hpp>
+#include <fastgltf/tools.hpp>
+#include <fastgltf/types.hpp>
 
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
-#include <queue>
-
-glm::mat4 GLTFLoader::Node::getWorldMatrix() const {
-    glm::mat4 m = matrix;
-    Node* p = parent;
-    while (p) {
-        m = p->matrix * m;
-        p = p->parent;
-    }
-    return m;
-}
-
-void GLTFLoader::loadFromFile(const std::string& filename) {
-    tinygltf::Model gltfModel;
-    tinygltf::TinyGLTF loader;
-    std::string err, warn;
-
-    bool ret = false;
-    std::string ext = filename.substr(filename.find_last_of(".") + 1);
-
-    if (ext == "glb") {
-        ret = loader.LoadBinaryFromFile(&gltfModel, &err, &warn, filename);
-    } else if (ext == "gltf") {
-        ret = loader.LoadASCIIFromFile(&gltfModel, &err, &warn, filename);
-    } else {
-        throw std::runtime_error("Unknown file extension: " + ext);
+#include <map>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+// what fastgltf's default adapter does, except external buffers come from our
+// mappings since the parser never loaded them
+struct MappedBufferAdapter {
+    const std::vector<AssetFile>* mapped;
+
+    fastgltf::span<const std::byte> operator()(const fastgltf::Asset& asset, std::size_t bufferViewIndex) const {
+        const fastgltf::BufferView& view = asset.bufferViews[bufferViewIndex];
+        const fastgltf::Buffer& buffer = asset.buffers[view.bufferIndex];
+
+        const std::byte* base = std::visit(fastgltf::visitor {
+            [](const fastgltf::sources::ByteView& source) -> const std::byte* { return source.bytes.data(); },
+            [](const fastgltf::sources::Array& source) -> const std::byte* { return source.bytes.data(); },
+            [](const fastgltf::sources::Vector& source) -> const std::byte* { return source.bytes.data(); },
+            [&](const fastgltf::sources::URI& source) -> const std::byte* {
+                return reinterpret_cast<const std::byte*>((*mapped)[view.bufferIndex].data()) + source.fileByteOffset;
+            },
+            [](const auto&) -> const std::byte* { return nullptr; },
+        }, buffer.data);
+
+        if (!base) {
+            return {};
+        }
+        return fastgltf::span<const std::byte>(base + view.byteOffset, view.byteLength);
     }
+};
 
-    if (!warn.empty()) {
-        std::cout << "glTF Warning: " << warn << std::endl;
+const fastgltf::Accessor* findAccessor(const fastgltf::Asset& asset, const fastgltf::Primitive& primitive, const char* name) {
+    auto attribute = primitive.findAttribute(name);
+    if (attribute == primitive.attributes.end()) {
+        return nullptr;
     }
+    return &asset.accessors[attribute->accessorIndex];
+}
 
-    if (!ret) {
-        throw std::runtime_error("Failed to load glTF: " + err);
+const char* alphaModeName(fastgltf::AlphaMode mode) {
+    switch (mode) {
+        case fastgltf::AlphaMode::Opaque: return "OPAQUE";
+        case fastgltf::AlphaMode::Mask:   return "MASK";
+        case fastgltf::AlphaMode::Blend:  return "BLEND";
     }
+    return "OPAQUE";
+}
 
-    if (gltfModel.scenes.empty()) {
-        throw std::runtime_error("glTF file contains no scenes");
-    }
+}
 
-    loadImages(gltfModel);
-    loadTextures(gltfModel);
-    loadMaterials(gltfModel);
+GLTFLoader::GLTFLoader() = default;
+GLTFLoader::~GLTFLoader() = default;
 
-    int sceneIndex = 0;
-    if (gltfModel.defaultScene >= 0 && gltfModel.defaultScene < static_cast<int>(gltfModel.scenes.size())) {
-        sceneIndex = gltfModel.defaultScene;
-    }
+void GLTFLoader::open(const char* filePath) {
+    TRACE_FUNCTION();
 
-    const tinygltf::Scene& scene = gltfModel.scenes[sceneIndex];
+    path = filePath;
+    std::filesystem::path fsPath(filePath);
+    std::filesystem::path directory = fsPath.parent_path();
 
-    for (size_t i = 0; i < scene.nodes.size(); i++) {
-        int nodeIndex = scene.nodes[i];
-        if (nodeIndex < 0 || nodeIndex >= static_cast<int>(gltfModel.nodes.size())) {
-            std::cerr << "Invalid node index in scene: " << nodeIndex << std::endl;
-            continue;
+    AssetFile source;
+    {
+        TRACE_ZONE("hash source");
+        if (!source.open(filePath)) {
+            throw std::runtime_error(std::string("Could not open ") + filePath);
         }
-        const tinygltf::Node& node = gltfModel.nodes[nodeIndex];
-        loadNode(node, gltfModel, nullptr);
+        hash = hash64(source.data(), source.size());
+        size = source.size();
     }
 
-    if (vertices.empty()) {
-        throw std::runtime_error("No vertices loaded from glTF file");
+    // no LoadExternalBuffers, the .bin files are mapped below instead of read into vectors
+    fastgltf::Parser parser(fastgltf::Extensions::KHR_mesh_quantization);
+    auto parse = [&](auto& file) {
+        if (file.error() != fastgltf::Error::None) {
+            throw std::runtime_error("Failed to read glTF " + path + ": " + std::string(fastgltf::getErrorMessage(file.error())));
+        }
+        return parser.loadGltf(file.get(), directory, fastgltf::Options::DecomposeNodeMatrices);
+    };
+
+    // simdjson wants padding past the end, which a view into the pack doesn't have, so
+    // packed files take one copy of the json (or .glb). loose ones fastgltf maps itself
+    auto loaded = [&] {
+        if (source.isPacked()) {
+            auto file = fastgltf::GltfDataBuffer::FromBytes(reinterpret_cast<const std::byte*>(source.data()), source.size());
+            return parse(file);
+        }
+        auto file = fastgltf::MappedGltfFile::FromPath(fsPath);
+        return parse(file);
+    }();
+    if (loaded.error() != fastgltf::Error::None) {
+        throw std::runtime_error("Failed to load glTF " + path + ": " + std::string(fastgltf::getErrorMessage(loaded.error())));
     }
-    if (indices.empty()) {
-        throw std::runtime_error("No indices loaded from glTF file");
+    asset = std::make_unique<fastgltf::Asset>(std::move(loaded.get()));
+
+    {
+        TRACE_ZONE("map buffers");
+        buffers.clear();
+        buffers.resize(asset->buffers.size());
+        for (size_t i = 0; i < asset->buffers.size(); i++) {
+            const auto* uri = std::get_if<fastgltf::sources::URI>(&asset->buffers[i].data);
+            if (!uri) {
+                continue;
+            }
+            if (!uri->uri.isLocalPath()) {
+                throw std::runtime_error(path + ": buffer " + std::to_string(i) + " isn't a local file");
+            }
+
+            std::string bufferPath = (directory / uri->uri.fspath()).string();
+            if (!buffers[i].open(bufferPath.c_str())) {
+                throw std::runtime_error(std::string("Could not open ") + bufferPath);
+            }
+            hash = hash64(buffers[i].data(), buffers[i].size(), hash);
+            size += buffers[i].size();
+        }
     }
 
+    loadNodes();
+    loadMaterials();
+    loadImages();
 }
 
+// breadth first from the scene's roots, so every parent is in the hierarchy before its children
+void GLTFLoader::loadNodes() {
+    TRACE_FUNCTION();
 
+    if (asset->scenes.empty()) {
+        throw std::runtime_error("glTF file contains no scenes");
+    }
+    const fastgltf::Scene& scene = asset->scenes[asset->defaultScene.value_or(0)];
+
+    transforms.clear();
+    transforms.reserve(static_cast<uint32_t>(asset->nodes.size()));
+    nodeMeshes.clear();
+    draws.clear();
+
+    struct Pending {
+        size_t   source;
+        uint32_t parent;
+    };
+    std::vector<Pending> queue;
+    for (size_t root : scene.nodeIndices) {
+        queue.push_back({ root, TransformHierarchy::noParent });
+    }
 
+    for (size_t i = 0; i < queue.size(); i++) {
+        // a node reachable twice would mean the file isn't a tree, and maybe not even finite
+        if (queue.size() > asset->nodes.size()) {
+            throw std::runtime_error(path + ": node hierarchy isn't a tree");
+        }
 
-void GLTFLoader::loadNode(const tinygltf::Node& inputNode,
-                          const tinygltf::Model& model,
-                          Node* parent) {
-    auto node = std::make_unique<Node>();
-    node->parent = parent;
-    node->matrix = glm::mat4(1.0f);
+        const fastgltf::Node& source = asset->nodes[queue[i].source];
+        uint32_t node = transforms.add(queue[i].parent);
 
-    if (inputNode.matrix.size() == 16) {
+        // DecomposeNodeMatrices turned any matrix into TRS
+        const auto& trs = std::get<fastgltf::TRS>(source.transform);
+        transforms.setTranslation(node, trs.translation[0], trs.translation[1], trs.translation[2]);
+        transforms.setRotation(node, trs.rotation[0], trs.rotation[1], trs.rotation[2], trs.rotation[3]);
+        transforms.setScale(node, trs.scale[0], trs.scale[1], trs.scale[2]);
 
-        for (int col = 0; col < 4; ++col) {
-            for (int row = 0; row < 4; ++row) {
-                node->matrix[col][row] = static_cast<float>(inputNode.matrix[col * 4 + row]);
+        nodeMeshes.push_back(source.meshIndex ? static_cast<int32_t>(*source.meshIndex) : -1);
+        if (source.meshIndex) {
+            const fastgltf::Mesh& mesh = asset->meshes[*source.meshIndex];
+            for (size_t primitive = 0; primitive < mesh.primitives.size(); primitive++) {
+                draws.push_back({ *source.meshIndex, primitive, node });
             }
         }
-    } else {
-
-        if (inputNode.translation.size() == 3) {
-            glm::vec3 translation(
-                static_cast<float>(inputNode.translation[0]),
-                static_cast<float>(inputNode.translation[1]),
-                static_cast<float>(inputNode.translation[2])
-            );
-            node->matrix = glm::translate(node->matrix, translation);
+
+        for (size_t child : source.children) {
+            queue.push_back({ child, node });
         }
-        if (inputNode.rotation.size() == 4) {
-            glm::quat q(
-                static_cast<float>(inputNode.rotation[3]),
-                static_cast<float>(inputNode.rotation[0]),
-                static_cast<float>(inputNode.rotation[1]),
-                static_cast<float>(inputNode.rotation[2])
-            );
-            node->matrix *= glm::mat4_cast(q);
+    }
+
+    transforms.update();
+}
+
+void GLTFLoader::decode(JobSystem& jobs, const MeshOptimizeSettings* optimize) {
+    TRACE_FUNCTION();
+
+    // sizes first, every job gets a fixed slice of the merged arrays. a mesh under several
+    // nodes decodes once, its draws share the slice
+    std::vector<const Draw*> work;
+    std::vector<Primitive> slices;
+    std::map<std::pair<size_t, size_t>, size_t> decoded;
+    primitives.clear();
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    for (const Draw& draw : draws) {
+        const fastgltf::Primitive& primitive = asset->meshes[draw.mesh].primitives[draw.primitive];
+        const fastgltf::Accessor* positions = findAccessor(*asset, primitive, "POSITION");
+        if (primitive.type != fastgltf::PrimitiveType::Triangles || !positions) {
+            std::cerr << path << ": skipping a primitive of mesh " << draw.mesh << " that isn't a triangle list" << std::endl;
+            continue;
         }
-        if (inputNode.scale.size() == 3) {
-            glm::vec3 scale(
-                static_cast<float>(inputNode.scale[0]),
-                static_cast<float>(inputNode.scale[1]),
-                static_cast<float>(inputNode.scale[2])
-            );
-            node->matrix = glm::scale(node->matrix, scale);
+
+        auto found = decoded.find({ draw.mesh, draw.primitive });
+        if (found == decoded.end()) {
+            Primitive range {};
+            range.firstIndex = indexCount;
+            range.firstVertex = vertexCount;
+            range.vertexCount = static_cast<uint32_t>(positions->count);
+            range.indexCount = primitive.indicesAccessor ? static_cast<uint32_t>(asset->accessors[*primitive.indicesAccessor].count)
+                                                         : range.vertexCount;
+            range.materialIndex = primitive.materialIndex ? static_cast<int32_t>(*primitive.materialIndex) : -1;
+
+            found = decoded.emplace(std::make_pair(draw.mesh, draw.primitive), slices.size()).first;
+            slices.push_back(range);
+            work.push_back(&draw);
+            vertexCount += range.vertexCount;
+            indexCount += range.indexCount;
         }
+
+        Primitive range = slices[found->second];
+        range.node = draw.node;
+        primitives.push_back(range);
     }
 
-    if (inputNode.mesh > -1) {
-        if (inputNode.mesh >= model.meshes.size()) {
-            std::cerr << "Invalid mesh index: " << inputNode.mesh << std::endl;
-            return;
-        }
-        const tinygltf::Mesh& mesh = model.meshes[inputNode.mesh];
+    vertices.assign(vertexCount, Vertex {});
+    indices.assign(indexCount, 0);
 
-        for (const auto& primitive : mesh.primitives) {
-            uint32_t firstIndex = static_cast<uint32_t>(indices.size());
-            uint32_t vertexStart = static_cast<uint32_t>(vertices.size());
+    MappedBufferAdapter adapter { &buffers };
 
+    jobs.parallelFor(static_cast<uint32_t>(slices.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            TRACE_ZONE("decode primitive");
+            const Primitive& range = slices[i];
+            const Draw& draw = *work[i];
+            const fastgltf::Primitive& primitive = asset->meshes[draw.mesh].primitives[draw.primitive];
 
-            if (primitive.attributes.find("POSITION") != primitive.attributes.end()) {
-                const tinygltf::Accessor& posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-                const tinygltf::BufferView& posView = model.bufferViews[posAccessor.bufferView];
-                const float* posBuffer = reinterpret_cast<const float*>(
-                    &model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]
-                );
+            std::span<Vertex> out(vertices.data() + range.firstVertex, range.vertexCount);
+            std::span<uint32_t> outIndices(indices.data() + range.firstIndex, range.indexCount);
 
-                size_t vertexCount = posAccessor.count;
+            for (Vertex& vertex : out) {
+                vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+                vertex.color = glm::vec3(1.0f);
+            }
 
-                const float* normalBuffer = nullptr;
-                const float* uvBuffer = nullptr;
+            fastgltf::iterateAccessorWithIndex<glm::vec3>(*asset, *findAccessor(*asset, primitive, "POSITION"),
+                [&](glm::vec3 position, std::size_t index) {
+                    out[index].position = position;
+                }, adapter);
 
-                if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-                    const tinygltf::Accessor& accessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-                    const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
-                    normalBuffer = reinterpret_cast<const float*>(&model.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]);
-                }
+            if (const fastgltf::Accessor* normals = findAccessor(*asset, primitive, "NORMAL")) {
+                fastgltf::iterateAccessorWithIndex<glm::vec3>(*asset, *normals, [&](glm::vec3 normal, std::size_t index) {
+                    out[index].normal = glm::normalize(normal);
+                }, adapter);
+            }
 
-                if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-                    const tinygltf::Accessor& accessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-                    const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
-                    uvBuffer = reinterpret_cast<const float*>(&model.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]);
-                }
+            // glTF's uv origin is already top left, unlike obj's
+            if (const fastgltf::Accessor* uvs = findAccessor(*asset, primitive, "TEXCOORD_0")) {
+                fastgltf::iterateAccessorWithIndex<glm::vec2>(*asset, *uvs, [&](glm::vec2 uv, std::size_t index) {
+                    out[index].uv_x = uv.x;
+                    out[index].uv_y = uv.y;
+                }, adapter);
+            }
 
-                for (size_t v = 0; v < vertexCount; v++) {
-                    Vertex vertex{};
-
-                    vertex.position = glm::vec3(
-                        posBuffer[v * 3 + 0],
-                        posBuffer[v * 3 + 1],
-                        posBuffer[v * 3 + 2]
-                    );
-
-                    if (normalBuffer) {
-                        glm::vec3 normal(
-                            normalBuffer[v * 3 + 0],
-                            normalBuffer[v * 3 + 1],
-                            normalBuffer[v * 3 + 2]
-                        );
-                        vertex.normal = glm::normalize(normal);
-                    } else {
-                        vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
-                    }
-
-                    if (uvBuffer) {
-                        vertex.uv.x = uvBuffer[v * 2 + 0];
-                        vertex.uv.y= uvBuffer[v * 2 + 1];
-                    } else {
-                        vertex.uv.x = 0.0f;
-                        vertex.uv.y = 0.0f;
-                    }
-
-                    vertex.color = glm::vec4(1.0f);
-
-                    vertices.push_back(vertex);
+            if (const fastgltf::Accessor* colors = findAccessor(*asset, primitive, "COLOR_0")) {
+                if (colors->type == fastgltf::AccessorType::Vec3) {
+                    fastgltf::iterateAccessorWithIndex<glm::vec3>(*asset, *colors, [&](glm::vec3 color, std::size_t index) {
+                        out[index].color = color;
+                    }, adapter);
+                } else {
+                    fastgltf::iterateAccessorWithIndex<glm::vec4>(*asset, *colors, [&](glm::vec4 color, std::size_t index) {
+                        out[index].color = glm::vec3(color);
+                    }, adapter);
                 }
             }
 
-            if (primitive.indices >= 0) {
-                const tinygltf::Accessor& accessor = model.accessors[primitive.indices];
-                const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-                const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-
-                const void* dataPtr = &buffer.data[accessor.byteOffset + bufferView.byteOffset];
-
-                switch (accessor.componentType) {
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-                        const uint32_t* buf = static_cast<const uint32_t*>(dataPtr);
-                        for (size_t index = 0; index < accessor.count; index++) {
-                            indices.push_back(buf[index] + vertexStart);
-                        }
-                        break;
-                    }
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-                        const uint16_t* buf = static_cast<const uint16_t*>(dataPtr);
-                        for (size_t index = 0; index < accessor.count; index++) {
-                            indices.push_back(buf[index] + vertexStart);
-                        }
-                        break;
-                    }
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-                        const uint8_t* buf = static_cast<const uint8_t*>(dataPtr);
-                        for (size_t index = 0; index < accessor.count; index++) {
-                            indices.push_back(buf[index] + vertexStart);
-                        }
-                        break;
-                    }
+            if (primitive.indicesAccessor) {
+                fastgltf::copyFromAccessor<uint32_t>(*asset, asset->accessors[*primitive.indicesAccessor], outIndices.data(), adapter);
+                bool inRange = std::all_of(outIndices.begin(), outIndices.end(), [&](uint32_t index) {
+                    return index < range.vertexCount;
+                });
+                if (!inRange) {
+                    std::cerr << path << ": mesh " << draw.mesh << " indexes past its vertices, dropping its triangles" << std::endl;
+                    std::fill(outIndices.begin(), outIndices.end(), 0);
                 }
+            } else {
+                std::iota(outIndices.begin(), outIndices.end(), 0);
+            }
 
-                Primitive prim;
-                prim.firstIndex = firstIndex;
-                prim.indexCount = static_cast<uint32_t>(accessor.count);
-                prim.materialIndex = primitive.material;
-                node->mesh.primitives.push_back(prim);
+            // primitive local, the ranges into the merged arrays stay where they are
+            if (optimize && !outIndices.empty()) {
+                optimizeMesh<Vertex>(outIndices, out, *optimize);
+            }
+            for (uint32_t& index : outIndices) {
+                index += range.firstVertex;
             }
         }
-    }
-
-    Node* nodePtr = node.get();
-    if (parent) {
-        parent->children.push_back(std::move(node));
-    } else {
-        nodes.push_back(std::move(node));
-    }
+    });
 
-    for (size_t i = 0; i < inputNode.children.size(); i++) {
-        loadNode(model.nodes[inputNode.children[i]], model, nodePtr);
+    if (indices.empty()) {
+        throw std::runtime_error("No triangles loaded from glTF file " + path);
     }
-}
 
-void GLTFLoader::loadImages(tinygltf::Model &model) {
-    images.clear();
-    images.resize(model.images.size());
-
-    for (size_t i = 0; i < model.images.size(); i++) {
-        tinygltf::Image& gltfImage = model.images[i];
-        Image& image = images[i];
-
-        image.image = VK_NULL_HANDLE;
-        image.imageView = VK_NULL_HANDLE;
-        image.sampler = VK_NULL_HANDLE;
-        image.allocation = VK_NULL_HANDLE;
-        image.data = gltfImage.image;
-        image.width = gltfImage.width;
-        image.height = gltfImage.height;
-        image.component = gltfImage.component;
-        image.bits = gltfImage.bits;
-        image.pixel_type = gltfImage.pixel_type;
-        image.name = gltfImage.name;
-        image.mimeType = gltfImage.mimeType;
-        image.size = image.data.size();
-    }
+    std::cout << path << ": " << primitives.size() << " primitives (" << slices.size() << " decoded), "
+              << vertices.size() << " vertices, " << indices.size() / 3 << " triangles" << std::endl;
 }
 
-void GLTFLoader::loadTextures(tinygltf::Model &model) {
-    textures.resize(model.textures.size());
-
-    for (size_t i = 0; i < model.textures.size(); i++) {
-        const tinygltf::Texture& gltfTexture = model.textures[i];
-        Texture& texture = textures[i];
+void GLTFLoader::loadMaterials() {
+    materials.clear();
+    materials.resize(asset->materials.size());
 
-        texture.source = gltfTexture.source;
-        texture.sampler = gltfTexture.sampler;
-        texture.name = gltfTexture.name;
-    }
-}
-
-void GLTFLoader::loadMaterials(tinygltf::Model &model) {materials.resize(model.materials.size());
-
-    for (size_t i = 0; i < model.materials.size(); i++) {
-        const tinygltf::Material& gltfMaterial = model.materials[i];
+    for (size_t i = 0; i < asset->materials.size(); i++) {
+        const fastgltf::Material& source = asset->materials[i];
         Material& material = materials[i];
 
-        material.name = gltfMaterial.name;
-
-        const auto& pbr = gltfMaterial.pbrMetallicRoughness;
-
-        if (pbr.baseColorFactor.size() == 4) {
-            material.baseColorFactor = glm::vec4(
-                static_cast<float>(pbr.baseColorFactor[0]),
-                static_cast<float>(pbr.baseColorFactor[1]),
-                static_cast<float>(pbr.baseColorFactor[2]),
-                static_cast<float>(pbr.baseColorFactor[3])
-            );
-        }
-
-        if (pbr.baseColorTexture.index >= 0) {
-            material.baseColorTexture = pbr.baseColorTexture.index;
-        }
+        material.name = std::string(source.name);
 
-        material.metallicFactor = static_cast<float>(pbr.metallicFactor);
-        material.roughnessFactor = static_cast<float>(pbr.roughnessFactor);
+        const auto& pbr = source.pbrData;
+        material.baseColorFactor = glm::vec4(pbr.baseColorFactor[0], pbr.baseColorFactor[1],
+                                             pbr.baseColorFactor[2], pbr.baseColorFactor[3]);
+        material.metallicFactor = pbr.metallicFactor;
+        material.roughnessFactor = pbr.roughnessFactor;
 
-        if (pbr.metallicRoughnessTexture.index >= 0) {
-            material.metallicRoughnessTexture = pbr.metallicRoughnessTexture.index;
+        if (pbr.baseColorTexture) {
+            material.baseColorTexture = static_cast<int>(pbr.baseColorTexture->textureIndex);
         }
-
-        if (gltfMaterial.normalTexture.index >= 0) {
-            material.normalTexture = gltfMaterial.normalTexture.index;
+        if (pbr.metallicRoughnessTexture) {
+            material.metallicRoughnessTexture = static_cast<int>(pbr.metallicRoughnessTexture->textureIndex);
         }
-
-        if (gltfMaterial.occlusionTexture.index >= 0) {
-            material.occlusionTexture = gltfMaterial.occlusionTexture.index;
+        if (source.normalTexture) {
+            material.normalTexture = static_cast<int>(source.normalTexture->textureIndex);
         }
-
-        if (gltfMaterial.emissiveTexture.index >= 0) {
-            material.emissiveTexture = gltfMaterial.emissiveTexture.index;
+        if (source.occlusionTexture) {
+            material.occlusionTexture = static_cast<int>(source.occlusionTexture->textureIndex);
         }
-
-        if (gltfMaterial.emissiveFactor.size() == 3) {
-            material.emissiveFactor = glm::vec3(
-                static_cast<float>(gltfMaterial.emissiveFactor[0]),
-                static_cast<float>(gltfMaterial.emissiveFactor[1]),
-                static_cast<float>(gltfMaterial.emissiveFactor[2])
-            );
+        if (source.emissiveTexture) {
+            material.emissiveTexture = static_cast<int>(source.emissiveTexture->textureIndex);
         }
 
-        material.alphaMode = gltfMaterial.alphaMode;
-        material.alphaCutoff = static_cast<float>(gltfMaterial.alphaCutoff);
-
-        material.doubleSided = gltfMaterial.doubleSided;
+        material.emissiveFactor = glm::vec3(source.emissiveFactor[0], source.emissiveFactor[1], source.emissiveFactor[2]);
+        material.alphaMode = alphaModeName(source.alphaMode);
+        material.alphaCutoff = source.alphaCutoff;
+        material.doubleSided = source.doubleSided;
     }
 }
 
-void GLTFLoader::createVulkanResources(Mesh *mesh, VkDevice device, VkPhysicalDevice physicalDevice,
-    VkCommandPool commandPool, VkQueue queue) {
-        for (size_t i = 0; i < images.size(); i++) {
-            createVulkanImage(mesh, device, commandPool, queue, i);
-        }
-}
-
-void GLTFLoader::cleanup(Mesh *mesh, VkDevice device) {
-    for (auto& img : images) {
-        if (img.sampler) {
-            vkDestroySampler(device, img.sampler, nullptr);
-            img.sampler = VK_NULL_HANDLE;
-        }
-        if (img.imageView) {
-            vkDestroyImageView(device, img.imageView, nullptr);
-            img.imageView = VK_NULL_HANDLE;
-        }
-        if (img.image && img.allocation) {
-            mesh->vmaDestroyImageWrapper(img.image, img.allocation);
-            img.image = VK_NULL_HANDLE;
-            img.allocation = VK_NULL_HANDLE;
-        }
-    }
-}
+// only the paths, the pixels go through TextureStreamer like every other texture
+void GLTFLoader::loadImages() {
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
 
-void GLTFLoader::createVulkanImage(Mesh *mesh, VkDevice device, VkCommandPool commandPool, VkQueue queue,
-    size_t imageIndex) {
-    if (imageIndex >= images.size()) return;
-
-    Image& img = images[imageIndex];
-
-    if (img.image != VK_NULL_HANDLE) return;
-
-    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
-    if (img.component == 1) {
-        format = VK_FORMAT_R8_UNORM;
-    } else if (img.component == 2) {
-        format = VK_FORMAT_R8G8_UNORM;
-    } else if (img.component == 3) {
-        std::vector<unsigned char> rgbaData;
-        rgbaData.resize(img.width * img.height * 4);
-        for (int i = 0; i < img.width * img.height; i++) {
-            rgbaData[i * 4 + 0] = img.data[i * 3 + 0];
-            rgbaData[i * 4 + 1] = img.data[i * 3 + 1];
-            rgbaData[i * 4 + 2] = img.data[i * 3 + 2];
-            rgbaData[i * 4 + 3] = 255;
-        }
-        img.data = std::move(rgbaData);
-        img.component = 4;
-        img.size = img.data.size();
+    textureImages.clear();
+    for (const fastgltf::Texture& texture : asset->textures) {
+        textureImages.push_back(texture.imageIndex ? static_cast<int32_t>(*texture.imageIndex) : -1);
     }
 
-    uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(img.width, img.height)))) + 1;
-
-    VkBuffer stagingBuffer;
-    VmaAllocation stagingAllocation;
-    createGLTFBuffer(mesh, device, img.size,
-                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                     VMA_MEMORY_USAGE_CPU_ONLY,
-                     stagingBuffer, stagingAllocation);
-
-    void* mappedData;
-    mesh->vmaMapMemoryWrapper(stagingAllocation, &mappedData);
-    memcpy(mappedData, img.data.data(), img.size);
-    mesh->vmaUnmapMemoryWrapper(stagingAllocation);
-
-    createGLTFImage(mesh, device, img.width, img.height, format,
-                           VK_IMAGE_TILING_OPTIMAL,
-                           VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                           mipLevels, img.image, img.allocation);
-
-
-    mesh->immediateSubmit([&](VkCommandBuffer cmd) {
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.image = img.image;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.subresourceRange.levelCount = mipLevels;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        vkCmdPipelineBarrier(cmd,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
-        VkBufferImageCopy region{};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {static_cast<uint32_t>(img.width),
-                             static_cast<uint32_t>(img.height), 1};
-
-        vkCmdCopyBufferToImage(cmd, stagingBuffer, img.image,
-                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-        barrier.subresourceRange.levelCount = 1;
-
-        int32_t mipWidth = img.width;
-        int32_t mipHeight = img.height;
-
-        for (uint32_t i = 1; i < mipLevels; i++) {
-            barrier.subresourceRange.baseMipLevel = i - 1;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-            vkCmdPipelineBarrier(cmd,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
-
-            VkImageBlit blit{};
-            blit.srcOffsets[0] = {0, 0, 0};
-            blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
-            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.srcSubresource.mipLevel = i - 1;
-            blit.srcSubresource.baseArrayLayer = 0;
-            blit.srcSubresource.layerCount = 1;
-            blit.dstOffsets[0] = {0, 0, 0};
-            blit.dstOffsets[1] = {mipWidth > 1 ? mipWidth / 2 : 1,
-                                  mipHeight > 1 ? mipHeight / 2 : 1, 1};
-            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.dstSubresource.mipLevel = i;
-            blit.dstSubresource.baseArrayLayer = 0;
-            blit.dstSubresource.layerCount = 1;
-
-            vkCmdBlitImage(cmd,
-                img.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                img.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1, &blit,
-                VK_FILTER_LINEAR);
-
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            vkCmdPipelineBarrier(cmd,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
-
-            if (mipWidth > 1) mipWidth /= 2;
-            if (mipHeight > 1) mipHeight /= 2;
+    imagePaths.clear();
+    for (const fastgltf::Image& image : asset->images) {
+        const auto* uri = std::get_if<fastgltf::sources::URI>(&image.data);
+        if (uri && uri->uri.isLocalPath()) {
+            imagePaths.push_back((directory / uri->uri.fspath()).string());
+        } else {
+            imagePaths.emplace_back();
         }
-
-        barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(cmd,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-    });
-
-    mesh->vmaDestroyBufferWrapper(stagingBuffer, stagingAllocation);
-
-    VkImageViewCreateInfo viewInfo{};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = img.image;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = format;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = mipLevels;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
-
-    VkResult result = vkCreateImageView(device, &viewInfo, nullptr, &img.imageView);
-    if (result != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create texture image view!");
-    }
-
-    VkSamplerCreateInfo samplerInfo{};
-    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.magFilter = VK_FILTER_LINEAR;
-    samplerInfo.minFilter = VK_FILTER_LINEAR;
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.anisotropyEnable = VK_TRUE;
-    samplerInfo.maxAnisotropy = 16.0f;
-    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-    samplerInfo.unnormalizedCoordinates = VK_FALSE;
-    samplerInfo.compareEnable = VK_FALSE;
-    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerInfo.mipLodBias = 0.0f;
-    samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = static_cast<float>(mipLevels);
-
-    result = vkCreateSampler(device, &samplerInfo, nullptr, &img.sampler);
-    if (result != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create texture sampler!");
-    }
-
-}
-
-void GLTFLoader::createGLTFImage(Mesh *mesh, VkDevice device, uint32_t width, uint32_t height, VkFormat format,
-    VkImageTiling tiling, VkImageUsageFlags usage, uint32_t mipLevels, VkImage&image, VmaAllocation&allocation) {
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = width;
-    imageInfo.extent.height = height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = mipLevels;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = format;
-    imageInfo.tiling = tiling;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = usage;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    VmaAllocationCreateInfo allocInfo{};
-    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-
-    if (mesh->vmaCreateImageWrapper(&imageInfo, &allocInfo, &image, &allocation, nullptr) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create image!");
     }
 }
-
-void GLTFLoader::createGLTFBuffer(Mesh *mesh, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage,
-    VmaMemoryUsage memoryUsage, VkBuffer&buffer, VmaAllocation&allocation) {
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size;
-    bufferInfo.usage = usage;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    VmaAllocationCreateInfo allocInfo{};
-    allocInfo.usage = memoryUsage;
-
-    if (mesh->vmaCreateBufferWrapper(&bufferInfo, &allocInfo, &buffer, &allocation, nullptr) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create buffer!");
-    }
-}
-
-
-void GLTFLoader::createMaterialDescriptorSets(VkDevice device, VkDescriptorPool descriptorPool,
-    VkDescriptorSetLayout descriptorSetLayout) {
-    // to do
-}
\ No newline at end of file
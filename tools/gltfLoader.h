@@ -1,110 +1,83 @@
 #pragma once
-#include "types.h"
-#include "utils.h"
-#include "vk_mem_alloc.h"
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
+#include "types.h"
+#include "vfs.h"
+#include "jobSystem.h"
+#include "meshOptimize.h"
+#include "transformHierarchy.h"
 
-class Mesh;
-
-namespace tinygltf {
-    class Node;
-    class Model;
+namespace fastgltf {
+    class Asset;
 }
 
+// glTF import on fastgltf, straight into the merged layout Base::loadMesh and
+// loadObj upload: one Vertex array, one index array already offset into it.
+//
+// nothing is copied into the asset. the .gltf/.glb and every external buffer are
+// memory mapped (or views into the asset pack) and accessors are read out of those,
+// so open() costs a json parse and decode() touches each byte once. the default scene's nodes go into a
+// TransformHierarchy breadth first and every (node, primitive) pair becomes one
+// primitive. vertices stay in mesh space, the renderer applies the node's world: a mesh
+// under several nodes decodes (and optimizes) once, on its own job into its slice of the
+// merged arrays, and its primitives share that slice.
+//
+// only triangle lists, other topologies are skipped with a warning.
+
 class GLTFLoader {
 public:
-    struct Image {
-        std::vector<unsigned char> data;
-        VkDeviceSize size;
-        int width;
-        int height;
-        int component;
-        int bits;
-        int pixel_type;
-        std::string name;
-        std::string mimeType;
-
-
-        VkImage image = VK_NULL_HANDLE;
-        VmaAllocation allocation = VK_NULL_HANDLE;
-        VkImageView imageView = VK_NULL_HANDLE;
-        VkSampler sampler = VK_NULL_HANDLE;
-    };
-
-    struct Texture {
-        int source;
-        int sampler;
-        std::string name;
-    };
-
-
     struct Primitive {
         uint32_t firstIndex;
         uint32_t indexCount;
-        int32_t materialIndex;
+        uint32_t firstVertex;
+        uint32_t vertexCount;
+        int32_t  materialIndex;     // -1 without one
+        uint32_t node;              // in transforms, the world to draw the slice with
     };
 
-    struct GltfMesh {
-        std::vector<Primitive> primitives;
-    };
+    GLTFLoader();
+    ~GLTFLoader();
 
-    struct Node {
-        Node* parent = nullptr;
-        std::vector<std::unique_ptr<Node>> children;
-        GltfMesh mesh;
-        glm::mat4 matrix{1.0f};
-        glm::mat4 getWorldMatrix() const;
-    };
+    // parses the json and maps every buffer, throws if any of it is missing
+    void open(const char* filePath);
 
-    std::vector<Image> images;
-    std::vector<Texture> textures;
-    std::vector<Material> materials;
+    // the file plus every buffer it pulls in, for the mesh cache
+    uint64_t sourceHash() const { return hash; }
+    uint64_t sourceSize() const { return size; }
 
-    std::vector<std::unique_ptr<Node>> nodes;
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+    // optimize is null to keep the source triangle order
+    void decode(JobSystem& jobs, const MeshOptimizeSettings* optimize);
 
-    void loadFromFile(const std::string& filename);
-    void createVulkanResources(Mesh* mesh,
-                              VkDevice device,
-                              VkPhysicalDevice physicalDevice,
-                              VkCommandPool commandPool,
-                              VkQueue queue);
-
-    void cleanup(Mesh* mesh, VkDevice device);
+    std::vector<Material>    materials;
+    std::vector<int32_t>     textureImages;     // texture -> image, -1 if it has none
+    std::vector<std::string> imagePaths;        // empty for images embedded in a buffer
 
+    // the scene's nodes, parents first
+    TransformHierarchy       transforms;
+    std::vector<int32_t>     nodeMeshes;        // per node in transforms, -1 without a mesh
 
+    std::vector<Primitive>   primitives;
+    std::vector<Vertex>      vertices;
+    std::vector<uint32_t>    indices;
 
 private:
-    void loadNode(const tinygltf::Node& inputNode,
-                  const tinygltf::Model& model,
-                  Node* parent);
-
-    void loadImages(tinygltf::Model& model);
-    void loadTextures(tinygltf::Model& model);
-    void loadMaterials(tinygltf::Model& model);
-
-    void createVulkanImage(Mesh* mesh,
-                         VkDevice device,
-                         VkCommandPool commandPool,
-                         VkQueue queue,
-                         size_t imageIndex);
-
-    void createMaterialDescriptorSets(VkDevice device,
-                         VkDescriptorPool descriptorPool,
-                         VkDescriptorSetLayout descriptorSetLayout);
-
-    void createGLTFImage(Mesh* mesh,
-                         VkDevice device,
-                         uint32_t width, uint32_t height, VkFormat format,
-                         VkImageTiling tiling, VkImageUsageFlags usage,
-                         uint32_t mipLevels,
-                         VkImage& image, VmaAllocation& allocation);
+    struct Draw {
+        size_t   mesh;
+        size_t   primitive;
+        uint32_t node;
+    };
 
-    void createGLTFBuffer(Mesh* mesh,
-                          VkDevice device,
-                          VkDeviceSize size, VkBufferUsageFlags usage,
-                          VmaMemoryUsage memoryUsage,
-                          VkBuffer& buffer, VmaAllocation& allocation);
-};
\ No newline at end of file
+    void loadNodes();
+    void loadMaterials();
+    void loadImages();
+
+    std::string                      path;
+    std::unique_ptr<fastgltf::Asset> asset;
+    std::vector<AssetFile>           buffers;     // external buffers, indexed like asset->buffers
+    std::vector<Draw>                draws;
+    uint64_t                         hash { 0 };
+    uint64_t                         size { 0 };
+};
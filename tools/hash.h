@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// xxh64. used to key on-disk caches against their source files, so it has to be
+// stable across runs and platforms (no std::hash).
+
+namespace hash_detail {
+    constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+    constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+    constexpr uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+    inline uint64_t rotl(uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    inline uint64_t read64(const uint8_t* p) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint32_t read32(const uint8_t* p) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint64_t round(uint64_t acc, uint64_t input) {
+        acc += input * prime2;
+        acc = rotl(acc, 31);
+        return acc * prime1;
+    }
+
+    inline uint64_t mergeRound(uint64_t acc, uint64_t val) {
+        acc ^= round(0, val);
+        return acc * prime1 + prime4;
+    }
+}
+
+inline uint64_t hash64(const void* data, size_t size, uint64_t seed = 0) {
+    using namespace hash_detail;
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+
+        const uint8_t* limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));      p += 8;
+            v2 = round(v2, read64(p));      p += 8;
+            v3 = round(v3, read64(p));      p += 8;
+            v4 = round(v4, read64(p));      p += 8;
+        } while (p <= limit);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + prime5;
+    }
+
+    h += static_cast<uint64_t>(size);
+
+    while (p + 8 <= end) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * prime1 + prime4;
+        p += 8;
+    }
+
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(read32(p)) * prime1;
+        h = rotl(h, 23) * prime2 + prime3;
+        p += 4;
+    }
+
+    while (p < end) {
+        h ^= static_cast<uint64_t>(*p) * prime5;
+        h = rotl(h, 11) * prime1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+
+    return h;
+}
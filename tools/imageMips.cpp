@@ -0,0 +1,76 @@
+#include "imageMips.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+
+struct SrgbTables {
+    std::array<float, 256>    toLinear;
+    std::array<uint8_t, 4096> toSrgb;
+
+    SrgbTables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (uint32_t i = 0; i < 4096; i++) {
+            float l = i / 4095.0f;
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            toSrgb[i] = static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+};
+
+}
+
+void downsampleRgba8(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth,
+                     uint32_t dstHeight, bool srgb) {
+    static const SrgbTables tables;
+
+    for (uint32_t y = 0; y < dstHeight; y++) {
+        uint32_t y0 = std::min(y * 2, srcHeight - 1);
+        uint32_t y1 = std::min(y * 2 + 1, srcHeight - 1);
+        for (uint32_t x = 0; x < dstWidth; x++) {
+            uint32_t x0 = std::min(x * 2, srcWidth - 1);
+            uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+
+            const uint8_t* texels[4] = {
+                src + (y0 * srcWidth + x0) * 4, src + (y0 * srcWidth + x1) * 4,
+                src + (y1 * srcWidth + x0) * 4, src + (y1 * srcWidth + x1) * 4,
+            };
+            uint8_t* out = dst + (y * dstWidth + x) * 4;
+
+            for (int c = 0; c < 4; c++) {
+                // alpha is linear already
+                if (!srgb || c == 3) {
+                    out[c] = static_cast<uint8_t>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+                    continue;
+                }
+                float sum = 0.0f;
+                for (const uint8_t* texel : texels) {
+                    sum += tables.toLinear[texel[c]];
+                }
+                out[c] = tables.toSrgb[static_cast<uint32_t>(sum * 0.25f * 4095.0f + 0.5f)];
+            }
+        }
+    }
+}
+
+std::vector<ImageLevel> buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb) {
+    uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+
+    std::vector<ImageLevel> levels(mipLevels);
+    levels[0] = { width, height, std::vector<uint8_t>(rgba, rgba + size_t(width) * height * 4) };
+
+    for (uint32_t level = 1; level < mipLevels; level++) {
+        const ImageLevel& src = levels[level - 1];
+        ImageLevel& dst = levels[level];
+        dst.width = std::max(1u, src.width / 2);
+        dst.height = std::max(1u, src.height / 2);
+        dst.rgba.resize(size_t(dst.width) * dst.height * 4);
+        downsampleRgba8(src.rgba.data(), src.width, src.height, dst.rgba.data(), dst.width, dst.height, srgb);
+    }
+    return levels;
+}
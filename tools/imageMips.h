@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// CPU mip chains for the cookers. 2x2 box filter with sizes halving like a blit
+// chain; colour is averaged in linear space for srgb images, alpha never is, and
+// an odd last row or column repeats its texel.
+
+struct ImageLevel {
+    uint32_t             width;
+    uint32_t             height;
+    std::vector<uint8_t> rgba;
+};
+
+void downsampleRgba8(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth,
+                     uint32_t dstHeight, bool srgb);
+
+// level 0 is a copy of rgba, down to 1x1
+std::vector<ImageLevel> buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb);
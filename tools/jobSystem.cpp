@@ -0,0 +1,167 @@
+#include "jobSystem.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <string>
+
+namespace {
+    // which pool and queue the current thread works on, -1 outside the pool
+    thread_local const void* localPool { nullptr };
+    thread_local int         localQueue { -1 };
+}
+
+void JobSystem::init(uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    }
+    threadCount = std::max(threadCount, 1u);
+
+    stopping = false;
+    for (uint32_t i = 0; i < threadCount; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (uint32_t i = 0; i < threadCount; i++) {
+        threads.emplace_back(&JobSystem::workerMain, this, i);
+    }
+}
+
+void JobSystem::shutdown() {
+    {
+        std::lock_guard lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    queues.clear();
+}
+
+void JobSystem::run(JobCounter& counter, std::function<void()>&& job) {
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t target;
+    if (localPool == this) {
+        target = static_cast<uint32_t>(localQueue);
+    } else {
+        target = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    }
+
+    {
+        std::lock_guard lock(queues[target]->mutex);
+        queues[target]->jobs.push_back({ std::move(job), &counter });
+    }
+    queued.fetch_add(1, std::memory_order_release);
+
+    {
+        // pairs with the predicate check in workerMain so the wakeup can't slip in between
+        std::lock_guard lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+bool JobSystem::tryRunJob() {
+    if (queued.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+
+    Job job;
+    bool found = false;
+
+    // own queue from the back first
+    if (localPool == this) {
+        Queue& own = *queues[localQueue];
+        std::lock_guard lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            found = true;
+        }
+    }
+
+    // then steal from the front of everyone else, starting next door so thieves spread out
+    uint32_t start = localPool == this ? static_cast<uint32_t>(localQueue) + 1 : 0;
+    for (uint32_t i = 0; i < queues.size() && !found; i++) {
+        Queue& victim = *queues[(start + i) % queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            found = true;
+        }
+    }
+
+    if (!found) {
+        return false;
+    }
+    queued.fetch_sub(1, std::memory_order_relaxed);
+
+    try {
+        job.function();
+    } catch (...) {
+        std::lock_guard lock(job.counter->errorMutex);
+        if (!job.counter->error) {
+            job.counter->error = std::current_exception();
+        }
+    }
+
+    if (job.counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // somebody may be sleeping in wait() on this counter
+        {
+            std::lock_guard lock(sleepMutex);
+        }
+        wake.notify_all();
+    }
+    return true;
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    while (counter.pending.load(std::memory_order_acquire) > 0) {
+        if (tryRunJob()) {
+            continue;
+        }
+
+        std::unique_lock lock(sleepMutex);
+        wake.wait(lock, [&] {
+            return counter.pending.load(std::memory_order_acquire) == 0 || queued.load(std::memory_order_acquire) > 0;
+        });
+    }
+
+    std::lock_guard lock(counter.errorMutex);
+    if (counter.error) {
+        std::exception_ptr error = counter.error;
+        counter.error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& function) {
+    batchSize = std::max(batchSize, 1u);
+
+    JobCounter counter;
+    for (uint32_t begin = 0; begin < count; begin += batchSize) {
+        uint32_t end = std::min(count, begin + batchSize);
+        run(counter, [&function, begin, end] { function(begin, end); });
+    }
+    wait(counter);
+}
+
+void JobSystem::workerMain(uint32_t index) {
+    localPool = this;
+    localQueue = static_cast<int>(index);
+    trace::setThreadName(("worker " + std::to_string(index)).c_str());
+
+    while (true) {
+        if (tryRunJob()) {
+            continue;
+        }
+
+        std::unique_lock lock(sleepMutex);
+        wake.wait(lock, [&] { return stopping.load() || queued.load(std::memory_order_acquire) > 0; });
+        if (stopping && queued.load() == 0) {
+            return;
+        }
+    }
+}
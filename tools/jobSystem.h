@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work-stealing job pool. every worker owns a deque: it pushes and pops its own
+// jobs LIFO (hot caches, nested jobs finish first) and steals FIFO from the others
+// when it runs dry. jobs submitted from outside the pool are spread round robin.
+//
+// wait() runs jobs while it waits, so it's fine to wait from inside a job.
+// the first exception thrown by a job is rethrown from wait().
+
+// runs function(begin, end) over [0, count) on whatever threads there are. JobSystem::parallelFor
+// in the engine, so code that benches and tools also build doesn't have to link the pool
+using ParallelFor = std::function<void(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& function)>;
+
+struct JobCounter {
+    std::atomic<uint32_t> pending { 0 };
+    std::mutex            errorMutex;
+    std::exception_ptr    error;
+};
+
+class JobSystem {
+public:
+    // threadCount 0 = one worker per hardware thread minus the caller
+    void init(uint32_t threadCount = 0);
+    void shutdown();
+
+    void run(JobCounter& counter, std::function<void()>&& job);
+    void wait(JobCounter& counter);
+
+    // splits [0, count) into batches of batchSize and runs function(begin, end) on each, then waits
+    void parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& function);
+
+    uint32_t workerCount() const { return static_cast<uint32_t>(threads.size()); }
+
+private:
+    struct Job {
+        std::function<void()> function;
+        JobCounter*           counter;
+    };
+
+    struct Queue {
+        std::mutex      mutex;
+        std::deque<Job> jobs;
+    };
+
+    bool tryRunJob();
+    void workerMain(uint32_t index);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread>            threads;
+
+    std::mutex                          sleepMutex;
+    std::condition_variable             wake;
+    std::atomic<uint32_t>               queued      { 0 };
+    std::atomic<uint32_t>               nextQueue   { 0 };
+    std::atomic<bool>                   stopping    { false };
+};
@@ -0,0 +1,219 @@
+#include "ktx2.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct Header {
+    uint8_t  identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Header) == 80);
+
+struct LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// khr_df.h values
+constexpr uint32_t modelBC1A = 128;
+constexpr uint32_t modelBC5 = 132;
+constexpr uint32_t modelBC7 = 134;
+constexpr uint32_t primariesBT709 = 1;
+constexpr uint32_t transferLinear = 1;
+constexpr uint32_t transferSrgb = 2;
+
+struct BlockFormat {
+    uint32_t model;
+    uint32_t blockBytes;
+    uint32_t channels;      // samples, each one covering blockBytes / channels
+    bool     srgb;
+};
+
+bool blockFormat(VkFormat format, BlockFormat& info) {
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK: info = { modelBC1A, 8, 1, false }; return true;
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:  info = { modelBC1A, 8, 1, true };  return true;
+        case VK_FORMAT_BC5_UNORM_BLOCK:     info = { modelBC5, 16, 2, false }; return true;
+        case VK_FORMAT_BC7_UNORM_BLOCK:     info = { modelBC7, 16, 1, false }; return true;
+        case VK_FORMAT_BC7_SRGB_BLOCK:      info = { modelBC7, 16, 1, true };  return true;
+        default: return false;
+    }
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t value) {
+    uint8_t bytes[4];
+    memcpy(bytes, &value, 4);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+// basic data format descriptor, one sample per channel of the block
+std::vector<uint8_t> buildDfd(const BlockFormat& info) {
+    uint32_t blockSize = 24 + 16 * info.channels;
+
+    std::vector<uint8_t> dfd;
+    put32(dfd, 4 + blockSize);
+    put32(dfd, 0);                                          // vendor khronos, type basic
+    put32(dfd, 2u | (blockSize << 16));                     // version 1.3
+    put32(dfd, info.model | (primariesBT709 << 8) | ((info.srgb ? transferSrgb : transferLinear) << 16));
+    put32(dfd, 3u | (3u << 8));                             // 4x4x1x1 texel block
+    put32(dfd, info.blockBytes);
+    put32(dfd, 0);
+
+    uint32_t sampleBits = info.blockBytes * 8 / info.channels;
+    for (uint32_t channel = 0; channel < info.channels; channel++) {
+        put32(dfd, (channel * sampleBits) | ((sampleBits - 1) << 16) | (channel << 24));
+        put32(dfd, 0);
+        put32(dfd, 0);
+        put32(dfd, UINT32_MAX);
+    }
+    return dfd;
+}
+
+}
+
+std::string_view Ktx2Image::value(std::string_view key) const {
+    for (const auto& [k, v] : keyValues) {
+        if (k == key) {
+            return v;
+        }
+    }
+    return {};
+}
+
+bool parseKtx2(std::span<const uint8_t> bytes, Ktx2Image& image) {
+    image = {};
+    if (bytes.size() < sizeof(Header)) {
+        return false;
+    }
+
+    Header header;
+    memcpy(&header, bytes.data(), sizeof(header));
+    if (memcmp(header.identifier, identifier, sizeof(identifier)) != 0 || header.supercompressionScheme != 0 ||
+        header.pixelDepth != 0 || header.layerCount > 1 || header.faceCount != 1 || header.levelCount == 0 ||
+        header.pixelWidth == 0 || header.pixelHeight == 0) {
+        return false;
+    }
+
+    uint64_t levelIndexEnd = sizeof(Header) + uint64_t(header.levelCount) * sizeof(LevelIndex);
+    if (levelIndexEnd > bytes.size()) {
+        return false;
+    }
+
+    image.format = static_cast<VkFormat>(header.vkFormat);
+    image.width = header.pixelWidth;
+    image.height = header.pixelHeight;
+
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+        LevelIndex index;
+        memcpy(&index, bytes.data() + sizeof(Header) + level * sizeof(LevelIndex), sizeof(index));
+        if (index.byteOffset + index.byteLength > bytes.size() || index.byteOffset < levelIndexEnd) {
+            return false;
+        }
+        image.levels.push_back(bytes.subspan(index.byteOffset, index.byteLength));
+    }
+
+    uint64_t kvdEnd = uint64_t(header.kvdByteOffset) + header.kvdByteLength;
+    if (kvdEnd > bytes.size()) {
+        return false;
+    }
+    uint64_t cursor = header.kvdByteOffset;
+    while (cursor + 4 <= kvdEnd) {
+        uint32_t length;
+        memcpy(&length, bytes.data() + cursor, 4);
+        cursor += 4;
+        if (cursor + length > kvdEnd) {
+            return false;
+        }
+
+        std::string_view entry(reinterpret_cast<const char*>(bytes.data() + cursor), length);
+        size_t split = entry.find('\0');
+        if (split != std::string_view::npos) {
+            // values are stored with their own terminator, keep it out of the view
+            std::string_view value = entry.substr(split + 1);
+            if (!value.empty() && value.back() == '\0') {
+                value.remove_suffix(1);
+            }
+            image.keyValues.emplace_back(entry.substr(0, split), value);
+        }
+        cursor = alignUp(cursor + length, 4);
+    }
+    return true;
+}
+
+std::vector<uint8_t> buildKtx2(VkFormat format, uint32_t width, uint32_t height,
+                               std::span<const std::vector<uint8_t>> levels,
+                               std::span<const std::pair<std::string, std::string>> keyValues) {
+    BlockFormat info;
+    if (!blockFormat(format, info) || levels.empty()) {
+        return {};
+    }
+
+    std::vector<uint8_t> dfd = buildDfd(info);
+
+    std::vector<uint8_t> kvd;
+    for (const auto& [key, value] : keyValues) {
+        put32(kvd, static_cast<uint32_t>(key.size() + 1 + value.size() + 1));
+        kvd.insert(kvd.end(), key.begin(), key.end());
+        kvd.push_back(0);
+        kvd.insert(kvd.end(), value.begin(), value.end());
+        kvd.push_back(0);
+        kvd.resize(alignUp(kvd.size(), 4), 0);
+    }
+
+    Header header {};
+    memcpy(header.identifier, identifier, sizeof(identifier));
+    header.vkFormat = format;
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    header.dfdByteOffset = static_cast<uint32_t>(sizeof(Header) + levels.size() * sizeof(LevelIndex));
+    header.dfdByteLength = static_cast<uint32_t>(dfd.size());
+    header.kvdByteOffset = kvd.empty() ? 0 : header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+    // the spec wants the smallest level first in the file, each aligned to lcm(block size, 4)
+    std::vector<LevelIndex> index(levels.size());
+    uint64_t offset = header.dfdByteOffset + header.dfdByteLength + header.kvdByteLength;
+    for (size_t level = levels.size(); level-- > 0;) {
+        offset = alignUp(offset, info.blockBytes);
+        index[level] = { offset, levels[level].size(), levels[level].size() };
+        offset += levels[level].size();
+    }
+
+    std::vector<uint8_t> file(offset, 0);
+    memcpy(file.data(), &header, sizeof(header));
+    memcpy(file.data() + sizeof(header), index.data(), index.size() * sizeof(LevelIndex));
+    memcpy(file.data() + header.dfdByteOffset, dfd.data(), dfd.size());
+    if (!kvd.empty()) {
+        memcpy(file.data() + header.kvdByteOffset, kvd.data(), kvd.size());
+    }
+    for (size_t level = 0; level < levels.size(); level++) {
+        memcpy(file.data() + index[level].byteOffset, levels[level].data(), levels[level].size());
+    }
+    return file;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// just enough of KTX2 (khronos.org/ktx) for cooked textures: one 2D image with a
+// full set of levels, no supercompression. the key/value block carries whatever
+// the cooker needs to tell a stale file from a good one.
+
+struct Ktx2Image {
+    VkFormat                              format     { VK_FORMAT_UNDEFINED };
+    uint32_t                              width      { 0 };
+    uint32_t                              height     { 0 };
+    std::vector<std::span<const uint8_t>> levels;      // level 0 (largest) first
+    std::vector<std::pair<std::string_view, std::string_view>> keyValues;
+
+    std::string_view value(std::string_view key) const;
+};
+
+// views into bytes, which has to outlive the result. false on anything we can't upload as is
+bool parseKtx2(std::span<const uint8_t> bytes, Ktx2Image& image);
+
+// levels are level 0 first. only the block compressed formats the cooker emits get a DFD
+std::vector<uint8_t> buildKtx2(VkFormat format, uint32_t width, uint32_t height,
+                               std::span<const std::vector<uint8_t>> levels,
+                               std::span<const std::pair<std::string, std::string>> keyValues);
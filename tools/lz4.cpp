@@ -0,0 +1,207 @@
+#include "lz4.h"
+
+#include <cstring>
+#include <memory>
+
+namespace {
+
+constexpr uint32_t hashLog      = 16;
+constexpr size_t   minMatch     = 4;
+constexpr size_t   mfLimit      = 12;    // the last match has to start this far from the end
+constexpr size_t   lastLiterals = 5;     // and the block always ends on this many literals
+constexpr size_t   maxOffset    = 65535;
+
+uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t hashPosition(const uint8_t* p) {
+    return (read32(p) * 2654435761u) >> (32 - hashLog);
+}
+
+// 15 in the token, then 255s until the rest fits in a byte
+uint8_t* writeLength(uint8_t* op, size_t length) {
+    length -= 15;
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = static_cast<uint8_t>(length);
+    return op;
+}
+
+bool readLength(const uint8_t*& ip, const uint8_t* iend, size_t& length) {
+    uint8_t byte;
+    do {
+        if (ip >= iend) {
+            return false;
+        }
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+size_t sequenceBound(size_t literalLength, size_t matchLength) {
+    return 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+}
+
+}
+
+size_t lz4CompressBound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+size_t lz4Compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    const uint8_t* iend = src + size;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + capacity;
+
+    if (size > mfLimit) {
+        const uint8_t* matchLimit = iend - lastLiterals;
+        // positions, so the table is the same size on 32 and 64 bit
+        auto table = std::make_unique<uint32_t[]>(size_t(1) << hashLog);
+
+        table[hashPosition(ip)] = 0;
+        ip++;
+
+        while (ip + mfLimit <= iend) {
+            uint32_t hash = hashPosition(ip);
+            const uint8_t* candidate = src + table[hash];
+            table[hash] = static_cast<uint32_t>(ip - src);
+
+            if (candidate >= ip || size_t(ip - candidate) > maxOffset || read32(candidate) != read32(ip)) {
+                // step further the longer nothing matched, incompressible data goes by quickly
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            while (ip > anchor && candidate > src && ip[-1] == candidate[-1]) {
+                ip--;
+                candidate--;
+            }
+
+            const uint8_t* matchEnd = ip + minMatch;
+            const uint8_t* candidateEnd = candidate + minMatch;
+            while (matchEnd < matchLimit && *matchEnd == *candidateEnd) {
+                matchEnd++;
+                candidateEnd++;
+            }
+
+            size_t literalLength = ip - anchor;
+            size_t matchLength = matchEnd - ip - minMatch;
+            if (sequenceBound(literalLength, matchLength) > size_t(oend - op)) {
+                return 0;
+            }
+
+            uint8_t* token = op++;
+            *token = 0;
+            if (literalLength >= 15) {
+                *token = 15 << 4;
+                op = writeLength(op, literalLength);
+            } else {
+                *token = static_cast<uint8_t>(literalLength << 4);
+            }
+            memcpy(op, anchor, literalLength);
+            op += literalLength;
+
+            size_t offset = ip - candidate;
+            *op++ = static_cast<uint8_t>(offset);
+            *op++ = static_cast<uint8_t>(offset >> 8);
+
+            if (matchLength >= 15) {
+                *token |= 15;
+                op = writeLength(op, matchLength);
+            } else {
+                *token |= static_cast<uint8_t>(matchLength);
+            }
+
+            ip = matchEnd;
+            anchor = ip;
+            if (ip + mfLimit <= iend) {
+                table[hashPosition(ip - 2)] = static_cast<uint32_t>(ip - 2 - src);
+            }
+        }
+    }
+
+    size_t literalLength = iend - anchor;
+    if (1 + literalLength / 255 + 1 + literalLength > size_t(oend - op)) {
+        return 0;
+    }
+    if (literalLength >= 15) {
+        *op++ = 15 << 4;
+        op = writeLength(op, literalLength);
+    } else {
+        *op++ = static_cast<uint8_t>(literalLength << 4);
+    }
+    if (literalLength > 0) {
+        memcpy(op, anchor, literalLength);
+        op += literalLength;
+    }
+
+    return op - dst;
+}
+
+bool lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + srcSize;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dstSize;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(ip, iend, literalLength)) {
+            return false;
+        }
+        if (literalLength > size_t(iend - ip) || literalLength > size_t(oend - op)) {
+            return false;
+        }
+        if (literalLength > 0) {
+            memcpy(op, ip, literalLength);
+            op += literalLength;
+            ip += literalLength;
+        }
+
+        // the last sequence is literals only
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > size_t(op - dst)) {
+            return false;
+        }
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(ip, iend, matchLength)) {
+            return false;
+        }
+        matchLength += minMatch;
+        if (matchLength > size_t(oend - op)) {
+            return false;
+        }
+
+        const uint8_t* match = op - offset;
+        if (offset >= matchLength) {
+            memcpy(op, match, matchLength);
+            op += matchLength;
+        } else {
+            // overlapping, a short offset repeats the last few bytes
+            for (size_t i = 0; i < matchLength; i++) {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    return op == oend;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// LZ4 block format (no frame), byte compatible with liblz4's LZ4_compress_default and
+// LZ4_decompress_safe. small enough to keep in tree like hash.h and the BC encoders,
+// and the pack only ever needs blocks of a known size.
+//
+// the compressor is the greedy single hash table one, it favours speed over ratio.
+// the decompressor checks every length against both buffers, a corrupt block
+// fails instead of writing out of bounds.
+
+// worst case output for size input bytes
+size_t lz4CompressBound(size_t size);
+
+// returns the compressed size, 0 if it doesn't fit in capacity
+size_t lz4Compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+
+// dstSize has to be the exact decompressed size. false on a corrupt block
+bool lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
@@ -0,0 +1,83 @@
+#include "materialTable.h"
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+void MaterialTable::clear() {
+    materials.clear();
+    pipelines.clear();
+    surfaces.clear();
+    surfaceRanges.clear();
+    buckets.clear();
+    ranges.clear();
+}
+
+uint32_t MaterialTable::add(const Material& material, uint32_t baseColorTexture, uint32_t pipeline) {
+    GpuMaterial gpu {};
+    gpu.baseColorFactor = material.baseColorFactor;
+    gpu.baseColorTexture = baseColorTexture;
+    gpu.alphaCutoff = material.alphaCutoff;
+    gpu.flags = material.doubleSided ? MaterialDoubleSided : 0;
+    if (material.alphaMode == "MASK") {
+        gpu.flags |= MaterialAlphaMask;
+    } else if (material.alphaMode == "BLEND") {
+        gpu.flags |= MaterialAlphaBlend;
+    }
+
+    materials.push_back(gpu);
+    pipelines.push_back(pipeline);
+    return static_cast<uint32_t>(materials.size() - 1);
+}
+
+uint32_t MaterialTable::addSurface(uint32_t firstIndex, uint32_t indexCount, uint32_t material, uint32_t node) {
+    surfaces.push_back({ material, node, 0, 0 });
+    surfaceRanges.push_back({ firstIndex, indexCount });
+    return static_cast<uint32_t>(surfaces.size() - 1);
+}
+
+void MaterialTable::build() {
+    // stable so surfaces keep their order inside a pipeline and material
+    std::vector<uint32_t> order(surfaces.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        uint32_t materialA = surfaces[a].material;
+        uint32_t materialB = surfaces[b].material;
+        return std::tie(pipelines[materialA], materialA) < std::tie(pipelines[materialB], materialB);
+    });
+
+    // the same primitive with the same material is one draw, wherever its nodes are
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, uint32_t> shared;
+    buckets.clear();
+    ranges.clear();
+    for (uint32_t index : order) {
+        GpuSurface& surface = surfaces[index];
+        const GpuBucket& range = surfaceRanges[index];
+
+        auto key = std::make_tuple(surface.material, range.firstIndex, range.indexCount);
+        auto found = shared.find(key);
+        if (found != shared.end()) {
+            surface.bucket = found->second;
+            continue;
+        }
+
+        uint32_t bucket = static_cast<uint32_t>(buckets.size());
+        surface.bucket = bucket;
+        shared.emplace(key, bucket);
+        buckets.push_back(range);
+
+        uint32_t pipeline = pipelines[surface.material];
+        if (ranges.empty() || ranges.back().pipeline != pipeline) {
+            ranges.push_back({ pipeline, bucket, 0 });
+        }
+        ranges.back().bucketCount++;
+    }
+
+    if (buckets.size() > maxBuckets) {
+        throw std::runtime_error("material table has " + std::to_string(buckets.size()) + " buckets, the binning passes take " +
+                                 std::to_string(maxBuckets));
+    }
+}
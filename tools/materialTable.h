@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+
+// a model's materials and surfaces packed into storage buffers, so instances carry a
+// surface index instead of the renderer binding a set per material.
+//
+// a surface is one (primitive, material) draw at a node of the model. surfaces with the
+// same index range and material share a binning bucket: after culling, the binning passes
+// group the visible instances by bucket and write one indirect draw per bucket. build()
+// hands out the buckets so the ones that share a pipeline are neighbours, and inside a
+// pipeline the ones that share a material: a pipeline is one bind plus one
+// vkCmdDrawIndexedIndirect over its range, however many materials it has.
+//
+// the pipeline key is whatever the renderer picks its pipelines by, the table only sorts on it.
+
+class MaterialTable {
+public:
+    // cull.comp.glsl keeps a count and a base per bucket in shared memory, 8 KB at this size
+    static constexpr uint32_t maxBuckets { 1024 };
+    // baseColorTexture of a material without one, the shaders sample white instead
+    static constexpr uint32_t noTexture  { UINT32_MAX };
+
+    struct PipelineRange {
+        uint32_t pipeline;
+        uint32_t firstBucket;
+        uint32_t bucketCount;
+    };
+
+    void clear();
+
+    // baseColorTexture is the material's bindless slot. returns the index surfaces refer to
+    uint32_t add(const Material& material, uint32_t baseColorTexture, uint32_t pipeline = 0);
+
+    // returns the index instances refer to
+    uint32_t addSurface(uint32_t firstIndex, uint32_t indexCount, uint32_t material, uint32_t node);
+
+    // assigns the buckets, call after the last add() and addSurface()
+    void build();
+
+    const std::vector<GpuMaterial>&   data() const { return materials; }
+    const std::vector<GpuSurface>&    surfaceData() const { return surfaces; }
+    const std::vector<GpuBucket>&     bucketData() const { return buckets; }
+    const std::vector<PipelineRange>& pipelineRanges() const { return ranges; }
+
+    uint32_t size() const { return static_cast<uint32_t>(materials.size()); }
+    uint32_t surfaceCount() const { return static_cast<uint32_t>(surfaces.size()); }
+    uint32_t bucketCount() const { return static_cast<uint32_t>(buckets.size()); }
+
+private:
+    std::vector<GpuMaterial>   materials;
+    std::vector<uint32_t>      pipelines;     // per material
+    std::vector<GpuSurface>    surfaces;
+    std::vector<GpuBucket>     surfaceRanges; // per surface, until build() folds them into buckets
+    std::vector<GpuBucket>     buckets;
+    std::vector<PipelineRange> ranges;
+};
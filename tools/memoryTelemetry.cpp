@@ -0,0 +1,175 @@
+#include "memoryTelemetry.h"
+#include "settings.h"
+#include "trace.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+static double toMiB(VkDeviceSize bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+const char* memoryCategoryName(MemoryCategory category) {
+    switch (category) {
+        case MemoryCategory::Mesh:         return "mesh";
+        case MemoryCategory::Texture:      return "texture";
+        case MemoryCategory::Instance:     return "instance";
+        case MemoryCategory::Staging:      return "staging";
+        case MemoryCategory::PerFrame:     return "per-frame";
+        case MemoryCategory::RenderTarget: return "render-target";
+        default:                           return "other";
+    }
+}
+
+void MemoryTelemetry::init(VmaAllocator _allocator) {
+    allocator = _allocator;
+
+    const VkPhysicalDeviceMemoryProperties* memProps;
+    vmaGetMemoryProperties(allocator, &memProps);
+    heapCount = memProps->memoryHeapCount;
+    heapWarned.assign(heapCount, false);
+
+    sampleInterval = static_cast<uint32_t>(envNumber("IDK_MEMORY_SAMPLE_FRAMES", 300.0));
+    if (sampleInterval == 0) {
+        sampleInterval = 1;
+    }
+    logSamples = envFlag("IDK_MEMORY_LOG");
+}
+
+void MemoryTelemetry::track(VmaAllocation allocation, MemoryCategory category, const char* name) {
+    if (allocation == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+
+    std::string label = memoryCategoryName(category);
+    if (name) {
+        label += ":";
+        label += name;
+    }
+    vmaSetAllocationName(allocator, allocation, label.c_str());
+
+    std::lock_guard lock(mutex);
+    live[allocation] = { category, info.size, std::move(label) };
+    bytesPerCategory[(size_t)category] += info.size;
+    countPerCategory[(size_t)category]++;
+}
+
+void MemoryTelemetry::untrack(VmaAllocation allocation) {
+    std::lock_guard lock(mutex);
+
+    auto it = live.find(allocation);
+    if (it == live.end()) {
+        return;
+    }
+
+    bytesPerCategory[(size_t)it->second.category] -= it->second.size;
+    countPerCategory[(size_t)it->second.category]--;
+    live.erase(it);
+}
+
+void MemoryTelemetry::onFrame(uint32_t frameNumber) {
+    // budgets are only refreshed from the driver when the frame index moves
+    vmaSetCurrentFrameIndex(allocator, frameNumber);
+
+    if (frameNumber % sampleInterval == 0) {
+        sample();
+    }
+}
+
+void MemoryTelemetry::sample() {
+    TRACE_FUNCTION();
+
+    std::vector<VmaBudget> budgets(heapCount);
+    vmaGetHeapBudgets(allocator, budgets.data());
+
+    for (uint32_t heap = 0; heap < heapCount; heap++) {
+        const VmaBudget& budget = budgets[heap];
+        if (budget.budget == 0) {
+            continue;
+        }
+
+        float ratio = static_cast<float>(budget.usage) / static_cast<float>(budget.budget);
+
+        if (!heapWarned[heap] && ratio >= warnRatio) {
+            heapWarned[heap] = true;
+            std::cerr << "WARNING: memory heap " << heap << " at " << std::fixed << std::setprecision(1)
+                      << ratio * 100.0f << "% of budget ("
+                      << toMiB(budget.usage) << " / " << toMiB(budget.budget) << " MB)" << std::endl;
+        } else if (heapWarned[heap] && ratio < clearRatio) {
+            heapWarned[heap] = false;
+        }
+    }
+
+    if (!logSamples) {
+        return;
+    }
+
+    VmaTotalStatistics stats;
+    vmaCalculateStatistics(allocator, &stats);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Memory: " << stats.total.statistics.allocationCount << " allocations in "
+              << stats.total.statistics.blockCount << " blocks, "
+              << toMiB(stats.total.statistics.allocationBytes) << " / "
+              << toMiB(stats.total.statistics.blockBytes) << " MB used" << std::endl;
+
+    for (uint32_t heap = 0; heap < heapCount; heap++) {
+        std::cout << "  heap " << heap << ": usage " << toMiB(budgets[heap].usage)
+                  << " MB, budget " << toMiB(budgets[heap].budget)
+                  << " MB, ours " << toMiB(budgets[heap].statistics.allocationBytes) << " MB" << std::endl;
+    }
+
+    std::lock_guard lock(mutex);
+    for (size_t c = 0; c < (size_t)MemoryCategory::Count; c++) {
+        if (countPerCategory[c] == 0) {
+            continue;
+        }
+        std::cout << "  " << memoryCategoryName((MemoryCategory)c) << ": "
+                  << countPerCategory[c] << " allocations, " << toMiB(bytesPerCategory[c]) << " MB" << std::endl;
+    }
+}
+
+void MemoryTelemetry::dumpJson() {
+    std::string path = envString("IDK_VMA_JSON");
+    if (path.empty()) {
+        return;
+    }
+
+    char* statsString = nullptr;
+    vmaBuildStatsString(allocator, &statsString, VK_TRUE);
+
+    std::ofstream out(path, std::ios::trunc);
+    if (out.is_open()) {
+        out << statsString;
+        std::cout << "Wrote VMA memory map to " << path << std::endl;
+    } else {
+        std::cerr << "Could not open " << path << std::endl;
+    }
+
+    vmaFreeStatsString(allocator, statsString);
+}
+
+void MemoryTelemetry::reportLeaks() {
+    std::lock_guard lock(mutex);
+
+    if (live.empty()) {
+        return;
+    }
+
+    VkDeviceSize leakedBytes = 0;
+    std::cerr << "Leaked " << live.size() << " VMA allocations:" << std::endl;
+    for (const auto& [allocation, tracked] : live) {
+        std::cerr << "  " << tracked.name << " (" << tracked.size << " bytes)" << std::endl;
+        leakedBytes += tracked.size;
+    }
+    std::cerr << "  total " << std::fixed << std::setprecision(2) << toMiB(leakedBytes) << " MB" << std::endl;
+}
+
+VkDeviceSize MemoryTelemetry::categoryBytes(MemoryCategory category) {
+    std::lock_guard lock(mutex);
+    return bytesPerCategory[(size_t)category];
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <vk_mem_alloc.h>
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class MemoryCategory : uint8_t {
+    Mesh,
+    Texture,
+    Instance,
+    Staging,
+    PerFrame,
+    RenderTarget,
+    Other,
+    Count
+};
+
+const char* memoryCategoryName(MemoryCategory category);
+
+// reads back what VMA knows about our memory. every allocation made through
+// Base is tagged with a category so budget pressure can be pinned on an owner.
+//
+//   IDK_MEMORY_LOG=1            print heap budgets + category totals on every sample
+//   IDK_MEMORY_SAMPLE_FRAMES=n  frames between samples (default 300)
+//   IDK_VMA_JSON=<path>         write vmaBuildStatsString's detailed map at shutdown
+class MemoryTelemetry {
+public:
+    void init(VmaAllocator _allocator);
+
+    void track(VmaAllocation allocation, MemoryCategory category, const char* name = nullptr);
+    void untrack(VmaAllocation allocation);
+
+    void onFrame(uint32_t frameNumber);
+    void sample();
+    void dumpJson();
+    void reportLeaks();
+
+    VkDeviceSize categoryBytes(MemoryCategory category);
+
+private:
+    struct TrackedAllocation {
+        MemoryCategory category;
+        VkDeviceSize   size;
+        std::string    name;
+    };
+
+    static constexpr float warnRatio  { 0.90f };
+    static constexpr float clearRatio { 0.85f };
+
+    VmaAllocator                                          allocator { VK_NULL_HANDLE };
+    uint32_t                                              heapCount { 0 };
+    uint32_t                                              sampleInterval { 300 };
+    bool                                                  logSamples { false };
+    std::vector<bool>                                     heapWarned;
+
+    std::mutex                                            mutex;
+    std::unordered_map<VmaAllocation, TrackedAllocation>  live;
+    std::array<VkDeviceSize, (size_t)MemoryCategory::Count> bytesPerCategory {};
+    std::array<uint32_t, (size_t)MemoryCategory::Count>   countPerCategory {};
+};
@@ -0,0 +1,94 @@
+#include "meshCache.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+bool CookedMesh::open(const std::string& path, uint64_t sourceHash, uint64_t sourceSize, uint32_t cookFlags) {
+    head = {};
+    if (!file.open(path.c_str(), false)) {
+        return false;
+    }
+
+    if (file.size() < sizeof(MeshCacheHeader) || !file.readInto(&head, 0, sizeof(MeshCacheHeader))) {
+        std::cerr << "Mesh cache " << path << " is truncated, recooking" << std::endl;
+        file.close();
+        return false;
+    }
+
+    uint32_t expectedStride = (cookFlags & MeshCookPackedVertices) ? sizeof(PackedVertex) : sizeof(Vertex);
+    if (head.magic != MeshCacheHeader::magicValue || head.formatVersion != MeshCacheHeader::version ||
+        head.vertexStride != expectedStride || (head.indexStride != 2 && head.indexStride != 4)) {
+        std::cout << "Mesh cache " << path << " is from another version, recooking" << std::endl;
+        file.close();
+        return false;
+    }
+
+    if (head.sourceHash != sourceHash || head.sourceSize != sourceSize || head.cookFlags != cookFlags) {
+        std::cout << "Mesh cache " << path << " is stale, recooking" << std::endl;
+        file.close();
+        return false;
+    }
+
+    uint64_t vertexEnd = head.vertexOffset + uint64_t(head.vertexCount) * head.vertexStride;
+    uint64_t indexEnd = head.indexOffset + uint64_t(head.indexCount) * head.indexStride;
+    uint64_t surfaceEnd = head.surfaceOffset + uint64_t(head.surfaceCount) * sizeof(MeshSurface);
+    if (vertexEnd > file.size() || indexEnd > file.size() || surfaceEnd > file.size()) {
+        std::cerr << "Mesh cache " << path << " is truncated, recooking" << std::endl;
+        file.close();
+        return false;
+    }
+
+    return true;
+}
+
+bool CookedMesh::readVertices(std::byte* dst) const {
+    return file.readInto(dst, head.vertexOffset, vertexBytes());
+}
+
+bool CookedMesh::readIndices(std::byte* dst) const {
+    return file.readInto(dst, head.indexOffset, indexBytes());
+}
+
+bool CookedMesh::readSurfaces(std::vector<MeshSurface>& surfaces) const {
+    surfaces.resize(head.surfaceCount);
+    return file.readInto(surfaces.data(), head.surfaceOffset, surfaces.size() * sizeof(MeshSurface));
+}
+
+bool writeMeshCache(const std::string& path, uint64_t sourceHash, uint64_t sourceSize, uint32_t cookFlags,
+                    std::span<const std::byte> vertexBytes, uint32_t vertexStride, const MeshBounds& bounds,
+                    std::span<const std::byte> indexBytes, uint32_t indexStride, std::span<const MeshSurface> surfaces) {
+    MeshCacheHeader header {};
+    header.magic = MeshCacheHeader::magicValue;
+    header.formatVersion = MeshCacheHeader::version;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.vertexStride = vertexStride;
+    header.vertexCount = static_cast<uint32_t>(vertexBytes.size() / vertexStride);
+    header.indexCount = static_cast<uint32_t>(indexBytes.size() / indexStride);
+    header.indexStride = indexStride;
+    header.surfaceCount = static_cast<uint32_t>(surfaces.size());
+    header.cookFlags = cookFlags;
+
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = bounds.min[i];
+        header.boundsMax[i] = bounds.max[i];
+    }
+
+    // keep every block 16 byte aligned so they can be copied with wide loads straight out of the map
+    header.vertexOffset = alignUp(sizeof(MeshCacheHeader), 16);
+    header.indexOffset = alignUp(header.vertexOffset + vertexBytes.size(), 16);
+    header.surfaceOffset = alignUp(header.indexOffset + indexBytes.size(), 16);
+
+    std::vector<uint8_t> contents(header.surfaceOffset + surfaces.size_bytes(), 0);
+    memcpy(contents.data(), &header, sizeof(header));
+    memcpy(contents.data() + header.vertexOffset, vertexBytes.data(), vertexBytes.size());
+    memcpy(contents.data() + header.indexOffset, indexBytes.data(), indexBytes.size());
+    memcpy(contents.data() + header.surfaceOffset, surfaces.data(), surfaces.size_bytes());
+
+    return writeFileAtomic(path, contents);
+}
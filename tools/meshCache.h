@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "files.h"
+#include "vfs.h"
+#include "types.h"
+#include "vertexPacking.h"
+
+// cooked mesh file: header, then welded vertices, then uint16 or uint32 indices, then the
+// MeshSurface ranges into them. written the first time a source mesh is loaded and reused
+// for as long as the source hash matches, so later loads are one mmap plus one memcpy into
+// staging (or a parallel decompress, if it comes from a compressed pack).
+//
+// bump version whenever Vertex, PackedVertex, MeshSurface or the welding changes.
+
+enum MeshCookFlags : uint32_t {
+    MeshCookOptimized         = 1 << 0,
+    MeshCookOverdrawOptimized = 1 << 1,
+    MeshCookPackedVertices    = 1 << 2,  // vertices are PackedVertex, bounds are the dequantization range
+};
+
+struct MeshCacheHeader {
+    static constexpr uint32_t magicValue = 0x48534D49; // "IMSH"
+    static constexpr uint32_t version = 7;
+
+    uint32_t magic;
+    uint32_t formatVersion;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t vertexStride;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t cookFlags;      // MeshCookFlags the file was cooked with
+    uint32_t indexStride;    // 2 or 4, picked from the vertex count
+    uint32_t surfaceCount;
+    float    boundsMin[3];
+    float    boundsMax[3];
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t surfaceOffset;
+};
+
+class CookedMesh {
+public:
+    // false if the file is missing, stale, cooked with other flags or truncated
+    bool open(const std::string& path, uint64_t sourceHash, uint64_t sourceSize, uint32_t cookFlags);
+
+    const MeshCacheHeader& header() const { return head; }
+
+    size_t vertexBytes() const { return size_t(head.vertexCount) * head.vertexStride; }
+    size_t indexBytes() const { return size_t(head.indexCount) * head.indexStride; }
+
+    // vertexBytes() / indexBytes() into dst, false if a compressed pack entry is corrupt
+    bool readVertices(std::byte* dst) const;
+    bool readIndices(std::byte* dst) const;
+    bool readSurfaces(std::vector<MeshSurface>& surfaces) const;
+
+private:
+    // not decompressed on open, the reads go straight to wherever the caller wants them
+    AssetFile       file;
+    MeshCacheHeader head {};
+};
+
+bool writeMeshCache(const std::string& path, uint64_t sourceHash, uint64_t sourceSize, uint32_t cookFlags,
+                    std::span<const std::byte> vertexBytes, uint32_t vertexStride, const MeshBounds& bounds,
+                    std::span<const std::byte> indexBytes, uint32_t indexStride, std::span<const MeshSurface> surfaces);
@@ -0,0 +1,258 @@
+#include "meshOptimize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+
+VertexCacheStats analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize) {
+    VertexCacheStats stats {};
+    if (indices.empty()) {
+        return stats;
+    }
+
+    // a vertex is in the fifo if it was pushed less than cacheSize misses ago
+    std::vector<uint32_t> pushedAt(vertexCount, 0);
+    std::vector<bool> seen(vertexCount, false);
+    uint32_t misses = 0;
+    uint32_t unique = 0;
+
+    for (uint32_t index : indices) {
+        if (!seen[index]) {
+            seen[index] = true;
+            unique++;
+        } else if (misses - pushedAt[index] < cacheSize) {
+            continue;
+        }
+        misses++;
+        pushedAt[index] = misses;
+    }
+
+    stats.acmr = float(misses) / float(indices.size() / 3);
+    stats.atvr = unique ? float(misses) / float(unique) : 0.0f;
+    return stats;
+}
+
+void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount, uint32_t cacheSize,
+                         std::vector<uint32_t>* clusterStarts) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // vertex -> triangles adjacency, flattened
+    std::vector<uint32_t> live(vertexCount, 0);
+    for (uint32_t index : indices) {
+        live[index]++;
+    }
+
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool>     emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    deadEnd.reserve(indices.size());
+
+    uint32_t timestamp = cacheSize + 1;
+    size_t cursor = 0;
+
+    // next fanning vertex when the candidates are exhausted: most recent dead end, then input order
+    auto skipDeadEnd = [&]() -> int64_t {
+        while (!deadEnd.empty()) {
+            uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0) {
+                return v;
+            }
+        }
+        while (cursor < vertexCount && live[cursor] == 0) {
+            cursor++;
+        }
+        return cursor < vertexCount ? static_cast<int64_t>(cursor) : -1;
+    };
+
+    int64_t fanning = skipDeadEnd();
+    while (fanning >= 0) {
+        candidates.clear();
+
+        for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = true;
+
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = indices[t * 3 + c];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (timestamp - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = timestamp++;
+                }
+            }
+        }
+
+        // prefer the candidate that'll still be in cache after its remaining triangles are emitted,
+        // and among those the one that's been in there longest
+        int64_t next = -1;
+        int64_t best = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+            int64_t priority = 0;
+            if (timestamp - cacheTime[v] + 2 * live[v] <= cacheSize) {
+                priority = timestamp - cacheTime[v];
+            }
+            if (priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+
+        if (next == -1) {
+            next = skipDeadEnd();
+            if (clusterStarts && next >= 0) {
+                clusterStarts->push_back(static_cast<uint32_t>(output.size() / 3));
+            }
+        }
+        fanning = next;
+    }
+
+    if (clusterStarts) {
+        clusterStarts->insert(clusterStarts->begin(), 0);
+        // the last restart can land after every triangle was emitted
+        while (clusterStarts->size() > 1 && clusterStarts->back() >= triangleCount) {
+            clusterStarts->pop_back();
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void optimizeOverdraw(std::span<uint32_t> indices, std::span<const uint32_t> clusterStarts,
+                      const float* positions, size_t positionStride, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (clusterStarts.size() < 2) {
+        return;
+    }
+
+    auto position = [&](uint32_t v, int axis) {
+        return *reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + v * positionStride + axis * sizeof(float));
+    };
+
+    float meshCentroid[3] = {};
+    for (size_t v = 0; v < vertexCount; v++) {
+        for (int axis = 0; axis < 3; axis++) {
+            meshCentroid[axis] += position(static_cast<uint32_t>(v), axis);
+        }
+    }
+    for (float& c : meshCentroid) {
+        c /= float(vertexCount);
+    }
+
+    // clusters that face away from the centre occlude the rest, so they go first
+    struct Cluster {
+        uint32_t first;
+        uint32_t count;
+        float    sortKey;
+    };
+    std::vector<Cluster> clusters;
+    clusters.reserve(clusterStarts.size());
+
+    for (size_t c = 0; c < clusterStarts.size(); c++) {
+        uint32_t first = clusterStarts[c];
+        uint32_t last = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : static_cast<uint32_t>(triangleCount);
+
+        float centroid[3] = {};
+        float normal[3] = {};
+        float area = 0.0f;
+
+        for (uint32_t t = first; t < last; t++) {
+            float p[3][3];
+            for (int k = 0; k < 3; k++) {
+                for (int axis = 0; axis < 3; axis++) {
+                    p[k][axis] = position(indices[t * 3 + k], axis);
+                }
+            }
+
+            float e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+            float e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float a = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            // area weighted, n is already 2 * area * unit normal
+            for (int axis = 0; axis < 3; axis++) {
+                centroid[axis] += (p[0][axis] + p[1][axis] + p[2][axis]) / 3.0f * a;
+                normal[axis] += n[axis];
+            }
+            area += a;
+        }
+
+        float key = 0.0f;
+        if (area > 0.0f) {
+            for (int axis = 0; axis < 3; axis++) {
+                key += (centroid[axis] / area - meshCentroid[axis]) * normal[axis];
+            }
+            key /= area;
+        }
+        clusters.push_back({ first, last - first, key });
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+    for (const Cluster& cluster : clusters) {
+        auto begin = indices.begin() + cluster.first * 3;
+        sorted.insert(sorted.end(), begin, begin + cluster.count * 3);
+    }
+    std::copy(sorted.begin(), sorted.end(), indices.begin());
+}
+
+std::vector<uint32_t> optimizeVertexFetchRemap(std::span<uint32_t> indices, size_t vertexCount) {
+    constexpr uint32_t unassigned = UINT32_MAX;
+    std::vector<uint32_t> remap(vertexCount, unassigned);
+
+    uint32_t next = 0;
+    for (uint32_t& index : indices) {
+        if (remap[index] == unassigned) {
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+
+    for (uint32_t& slot : remap) {
+        if (slot == unassigned) {
+            slot = next++;
+        }
+    }
+    return remap;
+}
+
+void printMeshOptimizeReport(const char* name, const MeshOptimizeReport& report) {
+    char line[256];
+    snprintf(line, sizeof(line), "%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f%s", name,
+        report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr,
+        report.overdrawApplied ? " (overdraw sorted)" : "");
+    std::cout << line << std::endl;
+}
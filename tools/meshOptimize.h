@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// index/vertex reordering done once at import time:
+//  - tipsify (Sander et al. 2007) reorders triangles for the post-transform vertex cache
+//  - optional overdraw pass sorts tipsify's clusters so outward-facing ones draw first
+//  - vertices are renumbered in first-use order so fetches walk the buffer linearly
+//
+// ACMR = vertex shader runs per triangle (0.5 is the ideal on a big regular mesh, 3 is no reuse)
+// ATVR = vertex shader runs per unique vertex (1.0 is ideal)
+
+struct VertexCacheStats {
+    float acmr;
+    float atvr;
+};
+
+struct MeshOptimizeSettings {
+    uint32_t cacheSize          { 16 };
+    bool     optimizeOverdraw   { false };
+    // overdraw sorting is dropped if it pushes ACMR above this many times the tipsify result
+    float    overdrawThreshold  { 1.05f };
+};
+
+struct MeshOptimizeReport {
+    VertexCacheStats before;
+    VertexCacheStats after;
+    bool             overdrawApplied;
+};
+
+// simulates a FIFO cache of cacheSize entries
+VertexCacheStats analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize = 16);
+
+// clusterStarts (optional) receives the first triangle of every cluster tipsify had to restart at
+void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount, uint32_t cacheSize = 16,
+                         std::vector<uint32_t>* clusterStarts = nullptr);
+
+void optimizeOverdraw(std::span<uint32_t> indices, std::span<const uint32_t> clusterStarts,
+                      const float* positions, size_t positionStride, size_t vertexCount);
+
+// rewrites indices in first-use order and returns old -> new. unreferenced vertices go to the
+// end instead of being dropped so the vertex count (and any ranges into it) stays the same
+std::vector<uint32_t> optimizeVertexFetchRemap(std::span<uint32_t> indices, size_t vertexCount);
+
+void printMeshOptimizeReport(const char* name, const MeshOptimizeReport& report);
+
+template<typename V>
+MeshOptimizeReport optimizeMesh(std::span<uint32_t> indices, std::span<V> vertices, const MeshOptimizeSettings& settings = {}) {
+    MeshOptimizeReport report {};
+    report.before = analyzeVertexCache(indices, vertices.size(), settings.cacheSize);
+
+    std::vector<uint32_t> clusterStarts;
+    optimizeVertexCache(indices, vertices.size(), settings.cacheSize, &clusterStarts);
+
+    if (settings.optimizeOverdraw && !vertices.empty()) {
+        std::vector<uint32_t> cacheOrder(indices.begin(), indices.end());
+        float cacheAcmr = analyzeVertexCache(indices, vertices.size(), settings.cacheSize).acmr;
+
+        optimizeOverdraw(indices, clusterStarts, &vertices[0].position[0], sizeof(V), vertices.size());
+
+        report.overdrawApplied = true;
+        if (analyzeVertexCache(indices, vertices.size(), settings.cacheSize).acmr > cacheAcmr * settings.overdrawThreshold) {
+            std::copy(cacheOrder.begin(), cacheOrder.end(), indices.begin());
+            report.overdrawApplied = false;
+        }
+    }
+
+    std::vector<uint32_t> remap = optimizeVertexFetchRemap(indices, vertices.size());
+    std::vector<V> reordered(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        reordered[remap[i]] = vertices[i];
+    }
+    std::copy(reordered.begin(), reordered.end(), vertices.begin());
+
+    report.after = analyzeVertexCache(indices, vertices.size(), settings.cacheSize);
+    return report;
+}
@@ -0,0 +1,217 @@
+#include "mipGenerator.h"
+#include "inits.h"
+#include "settings.h"
+#include "startupProfiler.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// the storage views are always unorm, the shader encodes srgb on its own
+bool isSrgb(VkFormat format) {
+    return format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+}
+
+void MipGenerator::init(VkDevice _device, VmaAllocator _allocator, MemoryTelemetry* _telemetry, PipelineCache* cache,
+                        VkShaderModule shader) {
+    device = _device;
+    allocator = _allocator;
+    telemetry = _telemetry;
+
+    DescriptorLayout layout;
+    layout.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    layout.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    layout.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    layout.bindings[1].descriptorCount = maxLevels;
+    // pushed per texture, so there's no pool to size or sets to keep alive until the upload retires
+    setLayout = layout.build(device, VK_SHADER_STAGE_COMPUTE_BIT, nullptr,
+                             VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT);
+
+    VkPushConstantRange pushConstant {};
+    pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstant.size = sizeof(Params);
+
+    VkPipelineLayoutCreateInfo layoutInfo { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &setLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstant;
+    VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout));
+
+    VkPipelineShaderStageCreateInfo stageInfo = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+    stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    stageInfo.module = shader;
+    stageInfo.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineInfo = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.stage = stageInfo;
+
+    startup::PipelineFeedback feedback;
+    pipelineInfo.pNext = feedback.chain(nullptr, 1);
+    uint64_t startNs = trace::nowNs();
+    VK_CHECK(vkCreateComputePipelines(device, cache->handle(), 1, &pipelineInfo, nullptr, &pipeline));
+    startup::recordPipeline("vkCreateComputePipelines", feedback, startNs, trace::nowNs());
+    cache->record(feedback.pipeline);
+
+    VkBufferCreateInfo bufferInfo { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.size = sizeof(uint32_t);
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &counter.buffer, &counter.allocation, &counter.info));
+    telemetry->track(counter.allocation, MemoryCategory::Other, "mip generator counter");
+    memset(counter.info.pMappedData, 0, sizeof(uint32_t));
+    vmaFlushAllocation(allocator, counter.allocation, 0, VK_WHOLE_SIZE);
+}
+
+void MipGenerator::destroy() {
+    if (pipeline == VK_NULL_HANDLE) {
+        return;
+    }
+
+    telemetry->untrack(counter.allocation);
+    vmaDestroyBuffer(allocator, counter.buffer, counter.allocation);
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+    pipeline = VK_NULL_HANDLE;
+}
+
+bool MipGenerator::supports(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) {
+    // the last workgroup reads level 6 back as one 64x64 tile
+    return (format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM) &&
+           std::max(width, height) <= 4096 && mipLevels > 1 && mipLevels <= maxLevels + 1;
+}
+
+bool MipGenerator::useCompute(MipMode mode) {
+    if (mode == MipMode::Default) {
+        return envFlag("IDK_MIP_COMPUTE", true);
+    }
+    return mode == MipMode::Compute;
+}
+
+MipGenerator::Views MipGenerator::createViews(VkImage image, VkFormat format, uint32_t mipLevels) const {
+    Views views;
+    views.count = mipLevels;
+
+    VkImageViewUsageCreateInfo usageInfo { VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO };
+    usageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+
+    for (uint32_t level = 0; level < mipLevels; level++) {
+        VkImageViewCreateInfo viewInfo = imageviewCreateInfo(isSrgb(format) ? VK_FORMAT_R8G8B8A8_UNORM : format,
+                                                             image, VK_IMAGE_ASPECT_COLOR_BIT);
+        viewInfo.pNext = &usageInfo;
+        viewInfo.subresourceRange.baseMipLevel = level;
+        VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &views.levels[level]));
+    }
+    return views;
+}
+
+void MipGenerator::destroyViews(Views& views) const {
+    for (uint32_t level = 0; level < views.count; level++) {
+        vkDestroyImageView(device, views.levels[level], nullptr);
+    }
+    views = {};
+}
+
+void MipGenerator::record(VkCommandBuffer cmd, VkImage image, VkFormat format, const Views& views, uint32_t width,
+                          uint32_t height) const {
+    uint32_t levelCount = views.count - 1;
+
+    VkImageMemoryBarrier2 before[2] {};
+    before[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    before[0].srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    before[0].srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    before[0].dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    before[0].dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+    before[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    before[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    before[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    before[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    before[0].image = image;
+    before[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    // whatever is in the other levels gets overwritten
+    before[1] = before[0];
+    before[1].srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    before[1].srcAccessMask = VK_ACCESS_2_NONE;
+    before[1].dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    before[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    before[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, levelCount, 0, 1 };
+
+    // the previous dispatch's reset of the counter
+    VkBufferMemoryBarrier2 counterBarrier { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2 };
+    counterBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    counterBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    counterBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    counterBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    counterBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    counterBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    counterBarrier.buffer = counter.buffer;
+    counterBarrier.size = VK_WHOLE_SIZE;
+
+    VkDependencyInfo dependency { VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    dependency.bufferMemoryBarrierCount = 1;
+    dependency.pBufferMemoryBarriers = &counterBarrier;
+    dependency.imageMemoryBarrierCount = 2;
+    dependency.pImageMemoryBarriers = before;
+    vkCmdPipelineBarrier2(cmd, &dependency);
+
+    // the shader statically touches all twelve, levels past the end just repeat the last view
+    VkDescriptorImageInfo imageInfos[1 + maxLevels];
+    for (uint32_t i = 0; i < 1 + maxLevels; i++) {
+        imageInfos[i] = { VK_NULL_HANDLE, views.levels[std::min(i, levelCount)], VK_IMAGE_LAYOUT_GENERAL };
+    }
+    VkDescriptorBufferInfo counterInfo { counter.buffer, 0, VK_WHOLE_SIZE };
+
+    VkWriteDescriptorSet writes[3] {};
+    for (VkWriteDescriptorSet& write : writes) {
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    }
+    writes[0].dstBinding = 0;
+    writes[0].pImageInfo = &imageInfos[0];
+    writes[1].dstBinding = 1;
+    writes[1].descriptorCount = maxLevels;
+    writes[1].pImageInfo = &imageInfos[1];
+    writes[2].dstBinding = 2;
+    writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[2].pBufferInfo = &counterInfo;
+
+    uint32_t groupsX = (width + 63) / 64;
+    uint32_t groupsY = (height + 63) / 64;
+
+    Params params {};
+    params.width = static_cast<int32_t>(width);
+    params.height = static_cast<int32_t>(height);
+    params.levelCount = levelCount;
+    params.groupCount = groupsX * groupsY;
+    params.srgb = isSrgb(format) ? 1 : 0;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdPushDescriptorSet(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 3, writes);
+    vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    vkCmdDispatch(cmd, groupsX, groupsY, 1);
+
+    VkImageMemoryBarrier2 after = before[0];
+    after.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    after.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    after.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    after.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    after.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    after.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    after.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, views.count, 0, 1 };
+
+    VkDependencyInfo afterDependency { VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    afterDependency.imageMemoryBarrierCount = 1;
+    afterDependency.pImageMemoryBarriers = &after;
+    vkCmdPipelineBarrier2(cmd, &afterDependency);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+
+#include <array>
+#include <cstdint>
+
+#include "memoryTelemetry.h"
+#include "pipelineCache.h"
+#include "types.h"
+
+// builds a whole mip chain with one dispatch of shaders/mips.comp.glsl instead of
+// a blit and two barriers per level. the shader writes every level through its own
+// unorm storage view and does the srgb conversion itself, so srgb images need
+// VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT and
+// STORAGE usage next to SAMPLED.
+//
+// only R8G8B8A8 up to 4096x4096, anything else stays on Base::createMipmaps.
+
+enum class MipMode : uint8_t {
+    Default,    // compute unless IDK_MIP_COMPUTE=0
+    Blit,
+    Compute,
+};
+
+class MipGenerator {
+public:
+    // levels one dispatch writes after level 0, enough for 4096
+    static constexpr uint32_t maxLevels { 12 };
+
+    struct Views {
+        std::array<VkImageView, maxLevels + 1> levels {};
+        uint32_t                               count  { 0 };
+    };
+
+    void init(VkDevice _device, VmaAllocator _allocator, MemoryTelemetry* _telemetry, PipelineCache* cache,
+              VkShaderModule shader);
+    void destroy();
+
+    static bool supports(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+    static bool useCompute(MipMode mode);
+
+    Views createViews(VkImage image, VkFormat format, uint32_t mipLevels) const;
+    void destroyViews(Views& views) const;
+
+    // level 0 has to be in TRANSFER_DST_OPTIMAL after its copy, the others can be in anything.
+    // every level ends up SHADER_READ_ONLY_OPTIMAL for the fragment shader
+    void record(VkCommandBuffer cmd, VkImage image, VkFormat format, const Views& views, uint32_t width,
+                uint32_t height) const;
+
+private:
+    struct Params {
+        int32_t  width;
+        int32_t  height;
+        uint32_t levelCount;
+        uint32_t groupCount;
+        uint32_t srgb;
+    };
+
+    VkDevice              device         { VK_NULL_HANDLE };
+    VmaAllocator          allocator      { VK_NULL_HANDLE };
+    MemoryTelemetry*      telemetry      { nullptr };
+    VkDescriptorSetLayout setLayout      { VK_NULL_HANDLE };
+    VkPipelineLayout      pipelineLayout { VK_NULL_HANDLE };
+    VkPipeline            pipeline       { VK_NULL_HANDLE };
+    AllocatedBuffer       counter        {};     // finished workgroups, the last one puts it back to 0
+};
@@ -0,0 +1,109 @@
+#include "overdraw.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+static uint32_t percentile(const std::vector<uint32_t>& histogram, uint64_t total, double fraction) {
+    uint64_t target = static_cast<uint64_t>(fraction * total);
+    uint64_t seen = 0;
+    for (uint32_t count = 1; count < histogram.size(); count++) {
+        seen += histogram[count];
+        if (seen > target) {
+            return count;
+        }
+    }
+    return static_cast<uint32_t>(histogram.size() - 1);
+}
+
+OverdrawReport analyzeOverdraw(std::span<const uint32_t> counts, const QuadCounters* quads) {
+    OverdrawReport report {};
+
+    for (uint32_t count : counts) {
+        report.totalFragments += count;
+        report.max = std::max(report.max, count);
+        if (count > 0) {
+            report.coveredPixels++;
+        }
+    }
+
+    // per-pixel counts are small, a histogram gets exact percentiles without sorting the screen
+    std::vector<uint32_t> histogram(report.max + 1, 0);
+    for (uint32_t count : counts) {
+        histogram[count]++;
+    }
+
+    if (!counts.empty()) {
+        report.coverage = double(report.coveredPixels) / counts.size();
+        report.meanPerPixel = double(report.totalFragments) / counts.size();
+    }
+
+    if (report.coveredPixels > 0) {
+        report.meanOverdraw = double(report.totalFragments) / report.coveredPixels;
+        report.p50 = percentile(histogram, report.coveredPixels, 0.50);
+        report.p99 = percentile(histogram, report.coveredPixels, 0.99);
+    }
+
+    if (quads && quads->quads > 0) {
+        uint64_t lanes = uint64_t(quads->shadedLanes) + quads->helperLanes;
+        report.hasQuadStats = true;
+        report.helperLaneRatio = double(quads->helperLanes) / lanes;
+        report.quadOccupancy = double(quads->shadedLanes) / (4.0 * quads->quads);
+    }
+
+    return report;
+}
+
+void printOverdrawReport(const OverdrawReport& report) {
+    std::cout << "Overdraw:" << std::endl;
+    std::cout << "  fragments shaded:   " << report.totalFragments << std::endl;
+    std::cout << "  coverage:           " << report.coverage * 100.0 << "%" << std::endl;
+    std::cout << "  mean (covered):     " << report.meanOverdraw << std::endl;
+    std::cout << "  mean (screen):      " << report.meanPerPixel << std::endl;
+    std::cout << "  p50 / p99 / max:    " << report.p50 << " / " << report.p99 << " / " << report.max << std::endl;
+
+    if (report.hasQuadStats) {
+        std::cout << "  helper lanes:       " << report.helperLaneRatio * 100.0 << "%" << std::endl;
+        std::cout << "  quad occupancy:     " << report.quadOccupancy * 100.0 << "%" << std::endl;
+    } else {
+        std::cout << "  helper lanes:       n/a (no fragment quad ops)" << std::endl;
+    }
+}
+
+bool writeOverdrawHeatmap(const char* path, std::span<const uint32_t> counts,
+                          uint32_t width, uint32_t height, uint32_t scaleMax) {
+    static constexpr std::array<std::array<float, 3>, 6> ramp = {{
+        { 0.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f },
+        { 0.0f, 1.0f, 0.0f },
+        { 1.0f, 1.0f, 0.0f },
+        { 1.0f, 0.0f, 0.0f },
+        { 1.0f, 1.0f, 1.0f },
+    }};
+
+    scaleMax = std::max(scaleMax, 1u);
+
+    std::vector<uint8_t> pixels(size_t(width) * height * 3);
+    for (size_t i = 0; i < size_t(width) * height; i++) {
+        float t = std::min(float(counts[i]) / scaleMax, 1.0f) * (ramp.size() - 1);
+        size_t stop = std::min(static_cast<size_t>(t), ramp.size() - 2);
+        float f = t - stop;
+
+        for (int c = 0; c < 3; c++) {
+            float value = ramp[stop][c] * (1.0f - f) + ramp[stop + 1][c] * f;
+            pixels[i * 3 + c] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+        }
+    }
+
+    if (!stbi_write_png(path, width, height, 3, pixels.data(), width * 3)) {
+        std::cerr << "Could not write overdraw heatmap " << path << std::endl;
+        return false;
+    }
+
+    std::cout << "Wrote overdraw heatmap to " << path << " (white = " << scaleMax << "+ fragments)" << std::endl;
+    return true;
+}
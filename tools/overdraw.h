@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+// mirrors QuadStats in overdraw*.frag
+struct QuadCounters {
+    uint32_t shadedLanes;
+    uint32_t helperLanes;
+    uint32_t quads;
+};
+
+struct OverdrawReport {
+    uint64_t totalFragments;
+    uint32_t coveredPixels;
+    double   coverage;        // covered / all pixels
+    double   meanOverdraw;    // fragments per covered pixel
+    double   meanPerPixel;    // fragments per screen pixel
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+    bool     hasQuadStats;
+    double   helperLaneRatio; // helper lanes / all lanes launched
+    double   quadOccupancy;   // live lanes per quad / 4
+};
+
+OverdrawReport analyzeOverdraw(std::span<const uint32_t> counts, const QuadCounters* quads);
+void printOverdrawReport(const OverdrawReport& report);
+
+// counts are clamped to scaleMax and mapped onto a black -> blue -> green -> yellow -> red -> white ramp
+bool writeOverdrawHeatmap(const char* path, std::span<const uint32_t> counts,
+                          uint32_t width, uint32_t height, uint32_t scaleMax);
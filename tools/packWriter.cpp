@@ -0,0 +1,190 @@
+#include "packWriter.h"
+#include "vfs.h"
+#include "hash.h"
+#include "lz4.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void pad(std::ofstream& out, uint64_t alignment) {
+    static const char zeros[64] = {};
+    uint64_t position = static_cast<uint64_t>(out.tellp());
+    uint64_t padding = (alignment - position % alignment) % alignment;
+    out.write(zeros, static_cast<std::streamsize>(padding));
+}
+
+// the chunk end table and chunk data from vfs.h. empty if compressing doesn't save at
+// least an eighth, then the entry stays raw and AssetFile can hand out the mapping as is
+std::vector<uint8_t> compressEntry(const uint8_t* data, uint64_t size, uint32_t& chunkCount) {
+    constexpr uint64_t chunkSize = AssetPack::chunkSize;
+    chunkCount = static_cast<uint32_t>((size + chunkSize - 1) / chunkSize);
+
+    std::vector<uint8_t> stored(chunkCount * sizeof(uint32_t));
+    std::vector<uint8_t> block(lz4CompressBound(chunkSize));
+    std::vector<uint32_t> ends(chunkCount);
+    uint64_t payload = 0;
+
+    for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+        const uint8_t* source = data + uint64_t(chunk) * chunkSize;
+        size_t rawSize = static_cast<size_t>(std::min(chunkSize, size - uint64_t(chunk) * chunkSize));
+
+        // readChunk tells the two apart by size, so compressed has to be strictly smaller
+        size_t compressedSize = lz4Compress(source, rawSize, block.data(), rawSize - 1);
+        if (compressedSize > 0) {
+            stored.insert(stored.end(), block.data(), block.data() + compressedSize);
+            payload += compressedSize;
+        } else {
+            stored.insert(stored.end(), source, source + rawSize);
+            payload += rawSize;
+        }
+        ends[chunk] = static_cast<uint32_t>(payload);
+    }
+
+    if (stored.size() > size - size / 8) {
+        return {};
+    }
+    memcpy(stored.data(), ends.data(), ends.size() * sizeof(uint32_t));
+    return stored;
+}
+
+}
+
+bool collectPackInputs(const char* root, std::vector<PackInput>& inputs) {
+    fs::path rootPath(root);
+    std::error_code error;
+    if (fs::is_regular_file(rootPath, error)) {
+        inputs.push_back({ vfs::normalize(root), rootPath });
+        return true;
+    }
+    if (!fs::is_directory(rootPath, error)) {
+        return false;
+    }
+    for (const auto& file : fs::recursive_directory_iterator(rootPath)) {
+        if (file.is_regular_file()) {
+            inputs.push_back({ vfs::normalize(file.path().string().c_str()), file.path() });
+        }
+    }
+    return true;
+}
+
+bool writePack(const char* outPath, std::vector<PackInput>& inputs, bool compress, PackStats* stats) {
+    // same input, same pack
+    std::sort(inputs.begin(), inputs.end(), [](const PackInput& a, const PackInput& b) { return a.key < b.key; });
+    for (size_t i = 1; i < inputs.size(); i++) {
+        if (inputs[i].key == inputs[i - 1].key) {
+            fprintf(stderr, "idkpack: %s given twice\n", inputs[i].key.c_str());
+            return false;
+        }
+    }
+
+    std::string tmpPath = std::string(outPath) + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        fprintf(stderr, "idkpack: can't write %s\n", tmpPath.c_str());
+        return false;
+    }
+
+    PackHeader header {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<PackEntry> entries(inputs.size());
+    std::string names;
+    PackStats totals {};
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        PackEntry& entry = entries[i];
+        entry.pathHash = hash64(inputs[i].key.data(), inputs[i].key.size());
+        entry.nameOffset = static_cast<uint32_t>(names.size());
+        entry.nameLength = static_cast<uint32_t>(inputs[i].key.size());
+        names += inputs[i].key;
+
+        pad(out, AssetPack::alignment);
+        entry.offset = static_cast<uint64_t>(out.tellp());
+
+        // MappedFile won't map an empty file, those just stay empty
+        if (fs::file_size(inputs[i].path) > 0) {
+            MappedFile source;
+            if (!source.open(inputs[i].path.string().c_str())) {
+                fprintf(stderr, "idkpack: can't read %s\n", inputs[i].path.string().c_str());
+                return false;
+            }
+            entry.size = source.size();
+
+            std::vector<uint8_t> stored;
+            if (compress) {
+                stored = compressEntry(source.data(), source.size(), entry.chunkCount);
+            }
+            if (!stored.empty()) {
+                entry.compression = uint32_t(PackCompression::LZ4);
+                entry.storedSize = stored.size();
+                out.write(reinterpret_cast<const char*>(stored.data()), static_cast<std::streamsize>(stored.size()));
+                totals.compressed++;
+            } else {
+                entry.chunkCount = 0;
+                entry.storedSize = source.size();
+                out.write(reinterpret_cast<const char*>(source.data()), static_cast<std::streamsize>(source.size()));
+            }
+        }
+        totals.files++;
+        totals.bytes += entry.size;
+        totals.storedBytes += entry.storedSize;
+    }
+
+    // open addressing at most half full
+    uint32_t slotCount = 1;
+    while (slotCount < entries.size() * 2) {
+        slotCount *= 2;
+    }
+    if (slotCount <= entries.size()) {
+        slotCount *= 2;
+    }
+    std::vector<uint32_t> slots(slotCount, AssetPack::emptySlot);
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        uint32_t slot = static_cast<uint32_t>(entries[i].pathHash) & (slotCount - 1);
+        while (slots[slot] != AssetPack::emptySlot) {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        slots[slot] = i;
+    }
+
+    pad(out, alignof(PackEntry));
+    header.magic = AssetPack::magic;
+    header.version = AssetPack::version;
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.slotCount = slotCount;
+    header.entriesOffset = static_cast<uint64_t>(out.tellp());
+    out.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(PackEntry)));
+    header.slotsOffset = static_cast<uint64_t>(out.tellp());
+    out.write(reinterpret_cast<const char*>(slots.data()), static_cast<std::streamsize>(slots.size() * sizeof(uint32_t)));
+    header.namesOffset = static_cast<uint64_t>(out.tellp());
+    header.namesSize = names.size();
+    out.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (!out) {
+        fprintf(stderr, "idkpack: can't write %s\n", tmpPath.c_str());
+        return false;
+    }
+
+    // same as writeFileAtomic
+    std::error_code error;
+    fs::rename(tmpPath, outPath, error);
+    if (error) {
+        fprintf(stderr, "idkpack: can't rename %s to %s: %s\n", tmpPath.c_str(), outPath, error.message().c_str());
+        fs::remove(tmpPath, error);
+        return false;
+    }
+
+    if (stats) {
+        *stats = totals;
+    }
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// writes the pack format in vfs.h, for idkpack and the pack benchmark. not part of the engine
+
+struct PackInput {
+    std::string           key;    // vfs::normalize of the path the engine will ask for
+    std::filesystem::path path;
+};
+
+struct PackStats {
+    uint64_t files       { 0 };
+    uint64_t bytes       { 0 };   // of the assets
+    uint64_t storedBytes { 0 };   // of the same assets in the pack
+    uint64_t compressed  { 0 };   // entries that ended up LZ4
+};
+
+// every file under root, keyed by its normalized path, or root itself if it's a file.
+// false if root doesn't exist
+bool collectPackInputs(const char* root, std::vector<PackInput>& inputs);
+
+// sorts inputs so the same files always make the same pack, and writes it through a
+// temporary file so a failed run never leaves half a pack behind. compress tries LZ4
+// on every entry and keeps it where it pays. errors go to stderr
+bool writePack(const char* outPath, std::vector<PackInput>& inputs, bool compress, PackStats* stats = nullptr);
@@ -0,0 +1,131 @@
+#include "pipelineCache.h"
+#include "files.h"
+#include "hash.h"
+#include "settings.h"
+#include "utils.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+void PipelineCache::init(VkDevice _device, VkPhysicalDevice physicalDevice) {
+    device = _device;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    if (!envFlag("IDK_PIPELINE_CACHE", true)) {
+        return;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "pipelines-%04x-%04x", properties.vendorID, properties.deviceID);
+    path = cacheFilePath(name, "vkpc");
+
+    VkPipelineCacheCreateInfo createInfo { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+
+    MappedFile file;
+    if (file.open(path.c_str())) {
+        FileHeader header {};
+        if (file.size() >= sizeof(header)) {
+            memcpy(&header, file.data(), sizeof(header));
+        }
+        const uint8_t* blob = file.data() + sizeof(header);
+        bool valid = file.size() >= sizeof(header) && header.magic == magic && header.version == version &&
+                     header.dataSize == file.size() - sizeof(header) && hash64(blob, header.dataSize) == header.dataHash;
+
+        if (!valid) {
+            std::cerr << "Pipeline cache " << path << " is corrupt, starting empty" << std::endl;
+        } else if (!matchesDevice(blob, header.dataSize)) {
+            std::cout << "Pipeline cache " << path << " is from another driver, starting empty" << std::endl;
+        } else {
+            createInfo.initialDataSize = header.dataSize;
+            createInfo.pInitialData = blob;
+            loadedSize = header.dataSize;
+            loadedHash = header.dataHash;
+        }
+    }
+
+    VkResult result = vkCreatePipelineCache(device, &createInfo, nullptr, &cache);
+    if (result != VK_SUCCESS && createInfo.pInitialData) {
+        // the driver can still turn down data that passed the header check
+        std::cerr << "Driver rejected pipeline cache " << path << ", starting empty" << std::endl;
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        loadedSize = 0;
+        loadedHash = 0;
+        result = vkCreatePipelineCache(device, &createInfo, nullptr, &cache);
+    }
+    VK_CHECK(result);
+
+    if (loadedSize > 0) {
+        std::cout << "Loaded pipeline cache " << path << " (" << loadedSize / 1024 << " KB)" << std::endl;
+    }
+}
+
+void PipelineCache::destroy() {
+    if (cache == VK_NULL_HANDLE) {
+        return;
+    }
+
+    save();
+
+    uint32_t total = hits + misses + unknown;
+    std::cout << "Pipeline cache: " << hits << " of " << total << " pipelines hit";
+    if (unknown > 0) {
+        std::cout << ", " << unknown << " without driver feedback";
+    }
+    std::cout << std::endl;
+
+    vkDestroyPipelineCache(device, cache, nullptr);
+    cache = VK_NULL_HANDLE;
+}
+
+void PipelineCache::record(const VkPipelineCreationFeedback& feedback) {
+    if (!(feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT)) {
+        unknown++;
+    } else if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT) {
+        hits++;
+    } else {
+        misses++;
+    }
+}
+
+bool PipelineCache::save() {
+    if (cache == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    size_t size = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &size, nullptr));
+    std::vector<uint8_t> contents(sizeof(FileHeader) + size);
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &size, contents.data() + sizeof(FileHeader)));
+    contents.resize(sizeof(FileHeader) + size);
+
+    // every pipeline came out of the cache, nothing new to write
+    uint64_t dataHash = hash64(contents.data() + sizeof(FileHeader), size);
+    if (size == loadedSize && dataHash == loadedHash) {
+        return true;
+    }
+
+    FileHeader header { magic, version, size, dataHash };
+    memcpy(contents.data(), &header, sizeof(header));
+    if (!writeFileAtomic(path, contents)) {
+        return false;
+    }
+
+    loadedSize = size;
+    loadedHash = dataHash;
+    std::cout << "Saved pipeline cache " << path << " (" << size / 1024 << " KB)" << std::endl;
+    return true;
+}
+
+bool PipelineCache::matchesDevice(const uint8_t* data, size_t size) const {
+    VkPipelineCacheHeaderVersionOne header {};
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    return header.headerSize >= sizeof(header) && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+           memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
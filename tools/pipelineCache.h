@@ -0,0 +1,56 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// one VkPipelineCache for every pipeline the app builds, loaded from the cache dir at
+// startup and written back (writeFileAtomic) at shutdown, so only the first launch
+// after a driver update pays for the shader compiles.
+//
+// the file is a small header of our own (size and hash of the blob, so a torn or
+// truncated file is caught before the driver sees it) followed by what
+// vkGetPipelineCacheData returned. the blob's own header has to match this device's
+// vendor, device id and pipelineCacheUUID, anything else starts empty. the file name
+// has vendor and device in it, so two GPUs don't keep overwriting each other.
+//
+// IDK_PIPELINE_CACHE=0 builds every pipeline from scratch and writes nothing.
+class PipelineCache {
+public:
+    static constexpr uint32_t magic   { 0x43504449 };  // "IDPC"
+    static constexpr uint32_t version { 1 };
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+
+    void init(VkDevice _device, VkPhysicalDevice physicalDevice);
+    // saves if anything was added, then destroys the cache. after the last pipeline is built
+    void destroy();
+
+    // VK_NULL_HANDLE when disabled, fine to pass to vkCreate*Pipelines either way
+    VkPipelineCache handle() const { return cache; }
+
+    // counts a hit or miss from the pipeline's creation feedback, any thread
+    void record(const VkPipelineCreationFeedback& feedback);
+
+    bool save();
+
+private:
+    VkDevice                   device { VK_NULL_HANDLE };
+    VkPipelineCache            cache  { VK_NULL_HANDLE };
+    VkPhysicalDeviceProperties properties {};
+    std::string                path;
+    uint64_t                   loadedSize { 0 };
+    uint64_t                   loadedHash { 0 };
+
+    std::atomic<uint32_t>      hits     { 0 };
+    std::atomic<uint32_t>      misses   { 0 };
+    std::atomic<uint32_t>      unknown  { 0 };   // no feedback from the driver
+
+    // the blob's VkPipelineCacheHeaderVersionOne against properties
+    bool matchesDevice(const uint8_t* data, size_t size) const;
+};
@@ -0,0 +1,404 @@
+#include "pipelineCompiler.h"
+#include "hash.h"
+#include "inits.h"
+#include "startupProfiler.h"
+#include "utils.h"
+
+#include <chrono>
+#include <iterator>
+#include <memory>
+
+namespace {
+
+// field by field, the create info structs have padding and pointers in them
+template<typename T>
+uint64_t mix(uint64_t hash, const T& value) {
+    return hash64(&value, sizeof(value), hash);
+}
+
+uint64_t mix(uint64_t hash, const std::string& value) {
+    return hash64(value.data(), value.size(), hash);
+}
+
+bool isReady(const std::shared_future<VkPipeline>& future) {
+    return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+constexpr VkGraphicsPipelineLibraryFlagsEXT libraryParts[] = {
+    VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT,
+};
+
+}
+
+VkPipeline AsyncPipeline::current() const {
+    if (isReady(optimized)) {
+        return optimized.get();
+    }
+    if (isReady(fast)) {
+        return fast.get();
+    }
+    return VK_NULL_HANDLE;
+}
+
+bool AsyncPipeline::isOptimized() const {
+    return isReady(optimized);
+}
+
+void PipelineCompiler::GraphicsRequest::fixPointers() {
+    builder.vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
+    builder.vertexInputInfo.pVertexBindingDescriptions = bindings.data();
+    builder.vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+    builder.vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
+    if (builder.renderInfo.colorAttachmentCount > 0) {
+        builder.renderInfo.pColorAttachmentFormats = &builder.colorAttachmentFormat;
+    }
+    builder.shaderStages.clear();
+}
+
+void PipelineCompiler::init(VkDevice _device, PipelineCache* _cache, JobSystem* _jobs, ShaderLoader _loadShader,
+                            bool _pipelineLibrary) {
+    device = _device;
+    cache = _cache;
+    jobs = _jobs;
+    loadShader = std::move(_loadShader);
+    pipelineLibrary = _pipelineLibrary;
+}
+
+void PipelineCompiler::destroy() {
+    if (!jobs) {
+        return;
+    }
+    wait();
+
+    std::lock_guard lock(mutex);
+    for (auto& [key, library] : libraries) {
+        // a library that failed to build holds the exception instead
+        try {
+            vkDestroyPipeline(device, library.get(), nullptr);
+        } catch (...) {
+        }
+    }
+    libraries.clear();
+    for (VkPipeline pipeline : pipelines) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+    }
+    pipelines.clear();
+    jobs = nullptr;
+}
+
+void PipelineCompiler::wait() {
+    // failures already went to the futures
+    try {
+        jobs->wait(pending);
+    } catch (...) {
+    }
+}
+
+AsyncPipeline PipelineCompiler::compileGraphics(const PipelineBuilder& builder, const char* vertexShader,
+                                                const char* fragmentShader) {
+    auto request = std::make_shared<GraphicsRequest>();
+    request->builder = builder;
+    const VkPipelineVertexInputStateCreateInfo& input = builder.vertexInputInfo;
+    if (input.vertexBindingDescriptionCount > 0) {
+        request->bindings.assign(input.pVertexBindingDescriptions,
+                                 input.pVertexBindingDescriptions + input.vertexBindingDescriptionCount);
+    }
+    if (input.vertexAttributeDescriptionCount > 0) {
+        request->attributes.assign(input.pVertexAttributeDescriptions,
+                                   input.pVertexAttributeDescriptions + input.vertexAttributeDescriptionCount);
+    }
+    request->vertexShader = vertexShader;
+    request->fragmentShader = fragmentShader;
+    request->fixPointers();
+
+    auto fast = std::make_shared<std::promise<VkPipeline>>();
+    AsyncPipeline result;
+    result.fast = fast->get_future().share();
+
+    if (!pipelineLibrary) {
+        result.optimized = result.fast;
+        jobs->run(pending, [this, request, fast] {
+            try {
+                fast->set_value(buildMonolithic(*request));
+            } catch (...) {
+                fast->set_exception(std::current_exception());
+            }
+        });
+        return result;
+    }
+
+    auto optimized = std::make_shared<std::promise<VkPipeline>>();
+    result.optimized = optimized->get_future().share();
+    jobs->run(pending, [this, request, fast, optimized] {
+        VkPipeline parts[std::size(libraryParts)];
+        try {
+            for (size_t i = 0; i < std::size(libraryParts); i++) {
+                parts[i] = library(*request, libraryParts[i]);
+            }
+            fast->set_value(link(*request, parts, false));
+        } catch (...) {
+            fast->set_exception(std::current_exception());
+            optimized->set_exception(std::current_exception());
+            return;
+        }
+
+        try {
+            optimized->set_value(link(*request, parts, true));
+        } catch (...) {
+            optimized->set_exception(std::current_exception());
+        }
+    });
+    return result;
+}
+
+std::shared_future<VkPipeline> PipelineCompiler::compileCompute(VkPipelineLayout layout, const char* shader,
+                                                                std::vector<uint32_t> constants) {
+    auto promise = std::make_shared<std::promise<VkPipeline>>();
+    std::shared_future<VkPipeline> future = promise->get_future().share();
+
+    jobs->run(pending, [this, layout, path = std::string(shader), constants = std::move(constants), promise] {
+        try {
+            VkShaderModule module = loadShader(path.c_str());
+
+            std::vector<VkSpecializationMapEntry> entries(constants.size());
+            for (uint32_t i = 0; i < entries.size(); i++) {
+                entries[i] = { i, i * uint32_t(sizeof(uint32_t)), sizeof(uint32_t) };
+            }
+            VkSpecializationInfo specialization {};
+            specialization.mapEntryCount = static_cast<uint32_t>(entries.size());
+            specialization.pMapEntries = entries.data();
+            specialization.dataSize = constants.size() * sizeof(uint32_t);
+            specialization.pData = constants.data();
+
+            VkComputePipelineCreateInfo pipelineInfo = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+            pipelineInfo.layout = layout;
+            pipelineInfo.stage = pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, module);
+            if (!constants.empty()) {
+                pipelineInfo.stage.pSpecializationInfo = &specialization;
+            }
+
+            startup::PipelineFeedback feedback;
+            pipelineInfo.pNext = feedback.chain(nullptr, 1);
+
+            VkPipeline pipeline;
+            uint64_t startNs = trace::nowNs();
+            VkResult result = vkCreateComputePipelines(device, cache->handle(), 1, &pipelineInfo, nullptr, &pipeline);
+            startup::recordPipeline("vkCreateComputePipelines", feedback, startNs, trace::nowNs());
+            vkDestroyShaderModule(device, module, nullptr);
+            VK_CHECK(result);
+
+            cache->record(feedback.pipeline);
+            keep(pipeline);
+            promise->set_value(pipeline);
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return future;
+}
+
+VkPipeline PipelineCompiler::buildMonolithic(GraphicsRequest& request) {
+    VkShaderModule vertex = loadShader(request.vertexShader.c_str());
+    VkShaderModule fragment;
+    try {
+        fragment = loadShader(request.fragmentShader.c_str());
+    } catch (...) {
+        vkDestroyShaderModule(device, vertex, nullptr);
+        throw;
+    }
+
+    request.builder.setShaders(vertex, fragment);
+    VkPipeline pipeline = request.builder.buildPipeline(device, cache);
+
+    vkDestroyShaderModule(device, fragment, nullptr);
+    vkDestroyShaderModule(device, vertex, nullptr);
+
+    keep(pipeline);
+    return pipeline;
+}
+
+VkPipeline PipelineCompiler::library(const GraphicsRequest& request, VkGraphicsPipelineLibraryFlagsEXT part) {
+    const PipelineBuilder& b = request.builder;
+
+    // only the state that goes into this part, so variants that differ elsewhere share it
+    uint64_t key = mix(0, part);
+    switch (part) {
+    case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+        key = mix(key, b.inputAssembly.topology);
+        key = mix(key, b.inputAssembly.primitiveRestartEnable);
+        key = hash64(request.bindings.data(), request.bindings.size() * sizeof(VkVertexInputBindingDescription), key);
+        key = hash64(request.attributes.data(), request.attributes.size() * sizeof(VkVertexInputAttributeDescription), key);
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+        key = mix(key, request.vertexShader);
+        key = mix(key, b.pipelineLayout);
+        key = mix(key, b.rasterizer.depthClampEnable);
+        key = mix(key, b.rasterizer.rasterizerDiscardEnable);
+        key = mix(key, b.rasterizer.polygonMode);
+        key = mix(key, b.rasterizer.cullMode);
+        key = mix(key, b.rasterizer.frontFace);
+        key = mix(key, b.rasterizer.depthBiasEnable);
+        key = mix(key, b.rasterizer.lineWidth);
+        key = mix(key, b.renderInfo.viewMask);
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+        key = mix(key, request.fragmentShader);
+        key = mix(key, b.pipelineLayout);
+        key = mix(key, b.depthStencil.depthTestEnable);
+        key = mix(key, b.depthStencil.depthWriteEnable);
+        key = mix(key, b.depthStencil.depthCompareOp);
+        key = mix(key, b.depthStencil.stencilTestEnable);
+        key = mix(key, b.multisampling.rasterizationSamples);
+        key = mix(key, b.multisampling.sampleShadingEnable);
+        key = mix(key, b.multisampling.minSampleShading);
+        key = mix(key, b.renderInfo.viewMask);
+        break;
+    default:
+        key = mix(key, b.colorBlendAttachment);
+        key = mix(key, b.multisampling.rasterizationSamples);
+        key = mix(key, b.multisampling.alphaToCoverageEnable);
+        key = mix(key, b.multisampling.alphaToOneEnable);
+        key = mix(key, b.renderInfo.colorAttachmentCount);
+        key = mix(key, b.colorAttachmentFormat);
+        key = mix(key, b.renderInfo.depthAttachmentFormat);
+        key = mix(key, b.renderInfo.stencilAttachmentFormat);
+        key = mix(key, b.renderInfo.viewMask);
+        break;
+    }
+
+    std::promise<VkPipeline> promise;
+    std::shared_future<VkPipeline> future;
+    {
+        std::lock_guard lock(mutex);
+        auto found = libraries.find(key);
+        if (found != libraries.end()) {
+            future = found->second;
+        } else {
+            libraries.emplace(key, promise.get_future().share());
+        }
+    }
+
+    // someone else is building it (on another job, so this can't deadlock) or already has
+    if (future.valid()) {
+        return future.get();
+    }
+
+    try {
+        VkPipeline built = buildLibrary(request, part);
+        promise.set_value(built);
+        return built;
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+VkPipeline PipelineCompiler::buildLibrary(const GraphicsRequest& request, VkGraphicsPipelineLibraryFlagsEXT part) {
+    const PipelineBuilder& b = request.builder;
+
+    VkPipelineRenderingCreateInfo renderInfo = b.renderInfo;
+    renderInfo.pNext = nullptr;
+
+    VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT };
+    libraryInfo.flags = part;
+    if (part != VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT) {
+        libraryInfo.pNext = &renderInfo;
+    }
+
+    // the same fixed state buildPipeline uses
+    VkPipelineViewportStateCreateInfo viewportState = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkDynamicState state[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicInfo = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+    dynamicInfo.pDynamicStates = state;
+    dynamicInfo.dynamicStateCount = 2;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &b.colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    info.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    VkPipelineShaderStageCreateInfo stage {};
+
+    switch (part) {
+    case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+        info.pVertexInputState = &b.vertexInputInfo;
+        info.pInputAssemblyState = &b.inputAssembly;
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+        module = loadShader(request.vertexShader.c_str());
+        stage = pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, module);
+        info.stageCount = 1;
+        info.pStages = &stage;
+        info.pViewportState = &viewportState;
+        info.pRasterizationState = &b.rasterizer;
+        info.pDynamicState = &dynamicInfo;
+        info.layout = b.pipelineLayout;
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+        module = loadShader(request.fragmentShader.c_str());
+        stage = pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, module);
+        info.stageCount = 1;
+        info.pStages = &stage;
+        info.pMultisampleState = &b.multisampling;
+        info.pDepthStencilState = &b.depthStencil;
+        info.layout = b.pipelineLayout;
+        break;
+    default:
+        info.pColorBlendState = &colorBlending;
+        info.pMultisampleState = &b.multisampling;
+        break;
+    }
+
+    startup::PipelineFeedback feedback;
+    info.pNext = feedback.chain(&libraryInfo, info.stageCount);
+
+    VkPipeline pipeline;
+    uint64_t startNs = trace::nowNs();
+    VkResult result = vkCreateGraphicsPipelines(device, cache->handle(), 1, &info, nullptr, &pipeline);
+    startup::recordPipeline("pipeline library", feedback, startNs, trace::nowNs());
+    if (module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, module, nullptr);
+    }
+    VK_CHECK(result);
+
+    cache->record(feedback.pipeline);
+    return pipeline;
+}
+
+VkPipeline PipelineCompiler::link(const GraphicsRequest& request, const VkPipeline* parts, bool optimize) {
+    VkPipelineLibraryCreateInfoKHR linkInfo { VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR };
+    linkInfo.libraryCount = static_cast<uint32_t>(std::size(libraryParts));
+    linkInfo.pLibraries = parts;
+
+    VkGraphicsPipelineCreateInfo info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    info.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+    info.layout = request.builder.pipelineLayout;
+
+    startup::PipelineFeedback feedback;
+    info.pNext = feedback.chain(&linkInfo, 0);
+
+    VkPipeline pipeline;
+    uint64_t startNs = trace::nowNs();
+    VK_CHECK(vkCreateGraphicsPipelines(device, cache->handle(), 1, &info, nullptr, &pipeline));
+    startup::recordPipeline(optimize ? "optimized link" : "fast link", feedback, startNs, trace::nowNs());
+
+    cache->record(feedback.pipeline);
+    keep(pipeline);
+    return pipeline;
+}
+
+void PipelineCompiler::keep(VkPipeline pipeline) {
+    std::lock_guard lock(mutex);
+    pipelines.push_back(pipeline);
+}
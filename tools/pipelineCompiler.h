@@ -0,0 +1,92 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "jobSystem.h"
+#include "pipelineCache.h"
+#include "types.h"
+
+// a graphics pipeline that may still be compiling. with VK_EXT_graphics_pipeline_library
+// fast is the pipeline linked from libraries without link time optimization, ready long
+// before optimized, and the renderer can draw with it in the meantime. without the
+// extension both futures are the same monolithic pipeline.
+struct AsyncPipeline {
+    std::shared_future<VkPipeline> fast;
+    std::shared_future<VkPipeline> optimized;
+
+    bool valid() const { return optimized.valid(); }
+    // never blocks: optimized once it's there, fast before that, VK_NULL_HANDLE while neither is
+    VkPipeline current() const;
+    bool isOptimized() const;
+};
+
+// builds pipelines on the job system and hands back futures, so startup and new variants
+// don't stall a frame on the driver's compiler. everything goes through the PipelineCache.
+//
+// with VK_EXT_graphics_pipeline_library every graphics pipeline is split into the four
+// library parts (vertex input, pre-rasterization shaders, fragment shader, fragment output),
+// each built once per distinct state and shared. both shader parts are keyed on the pipeline
+// layout too (no VK_PIPELINE_LAYOUT_CREATE_INDEPENDENT_SETS_BIT_EXT here), so variants only
+// share the vertex shader part if they share the layout: Mesh gives its debug variants one
+// layout with a set each for that. the link without optimization is cheap and comes first,
+// the optimized link follows on the same job.
+//
+// the compiler owns every pipeline it returns and destroys them in destroy().
+// IDK_PIPELINE_LIBRARY=0 skips the libraries even where they're supported.
+class PipelineCompiler {
+public:
+    using ShaderLoader = std::function<VkShaderModule(const char* path)>;
+
+    void init(VkDevice _device, PipelineCache* _cache, JobSystem* _jobs, ShaderLoader _loadShader, bool pipelineLibrary);
+    // waits for whatever is still compiling, then destroys every pipeline and library
+    void destroy();
+
+    // blocks until nothing is compiling, before destroying layouts a job may still use
+    void wait();
+
+    // the builder is copied, its shader stages are ignored in favour of the paths. the
+    // vertex input arrays it points to only have to live until this returns
+    AsyncPipeline compileGraphics(const PipelineBuilder& builder, const char* vertexShader, const char* fragmentShader);
+    // constants[i] goes to the shader's constant_id = i
+    std::shared_future<VkPipeline> compileCompute(VkPipelineLayout layout, const char* shader,
+                                                  std::vector<uint32_t> constants = {});
+
+    bool usesPipelineLibrary() const { return pipelineLibrary; }
+
+private:
+    // a PipelineBuilder with the vertex input arrays it points to, so it can outlive the caller's
+    struct GraphicsRequest {
+        PipelineBuilder                                builder;
+        std::vector<VkVertexInputBindingDescription>   bindings;
+        std::vector<VkVertexInputAttributeDescription> attributes;
+        std::string                                    vertexShader;
+        std::string                                    fragmentShader;
+
+        void fixPointers();
+    };
+
+    VkPipeline buildMonolithic(GraphicsRequest& request);
+    VkPipeline buildLibrary(const GraphicsRequest& request, VkGraphicsPipelineLibraryFlagsEXT part);
+    // the library for part with request's state, built by the first caller and shared after
+    VkPipeline library(const GraphicsRequest& request, VkGraphicsPipelineLibraryFlagsEXT part);
+    VkPipeline link(const GraphicsRequest& request, const VkPipeline* libraries, bool optimize);
+    void keep(VkPipeline pipeline);
+
+    VkDevice       device     { VK_NULL_HANDLE };
+    PipelineCache* cache      { nullptr };
+    JobSystem*     jobs       { nullptr };
+    ShaderLoader   loadShader;
+    bool           pipelineLibrary { false };
+
+    JobCounter     pending;
+
+    std::mutex                                               mutex;
+    std::unordered_map<uint64_t, std::shared_future<VkPipeline>> libraries;
+    std::vector<VkPipeline>                                  pipelines;
+};
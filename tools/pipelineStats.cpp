@@ -0,0 +1,76 @@
+#include "pipelineStats.h"
+#include "settings.h"
+#include "utils.h"
+
+#include <iostream>
+
+void PipelineStatsQuery::init(VkDevice _device, VkPhysicalDevice physicalDevice, uint32_t framesInFlight) {
+    if (!envFlag("IDK_PIPELINE_STATS")) {
+        return;
+    }
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    if (!features.pipelineStatisticsQuery) {
+        std::cerr << "pipelineStatisticsQuery not supported, pipeline stats disabled" << std::endl;
+        return;
+    }
+
+    device = _device;
+
+    // results come back in bit order, which is the order of PipelineStats
+    VkQueryPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    poolInfo.queryCount = framesInFlight;
+    poolInfo.pipelineStatistics =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    VK_CHECK(vkCreateQueryPool(device, &poolInfo, nullptr, &queryPool));
+}
+
+void PipelineStatsQuery::destroy() {
+    if (queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        queryPool = VK_NULL_HANDLE;
+    }
+}
+
+void PipelineStatsQuery::reset(VkCommandBuffer cmd, uint32_t frameIndex) {
+    if (!isActive()) {
+        return;
+    }
+
+    vkCmdResetQueryPool(cmd, queryPool, frameIndex, 1);
+}
+
+void PipelineStatsQuery::begin(VkCommandBuffer cmd, uint32_t frameIndex) {
+    if (!isActive()) {
+        return;
+    }
+
+    vkCmdBeginQuery(cmd, queryPool, frameIndex, 0);
+}
+
+void PipelineStatsQuery::end(VkCommandBuffer cmd, uint32_t frameIndex) {
+    if (!isActive()) {
+        return;
+    }
+
+    vkCmdEndQuery(cmd, queryPool, frameIndex);
+    written |= 1u << frameIndex;
+}
+
+bool PipelineStatsQuery::read(uint32_t frameIndex, PipelineStats& stats) {
+    if (!isActive() || !(written & (1u << frameIndex))) {
+        return false;
+    }
+
+    VkResult result = vkGetQueryPoolResults(device, queryPool, frameIndex, 1,
+        sizeof(PipelineStats), &stats, sizeof(PipelineStats), VK_QUERY_RESULT_64_BIT);
+
+    return result == VK_SUCCESS;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+struct PipelineStats {
+    uint64_t inputAssemblyPrimitives;
+    uint64_t vertexInvocations;
+    uint64_t clippingInvocations;
+    uint64_t clippingPrimitives;
+    uint64_t fragmentInvocations;
+};
+
+// one VK_QUERY_TYPE_PIPELINE_STATISTICS query per frame slot. enable with
+// IDK_PIPELINE_STATS=1 (needs the pipelineStatisticsQuery device feature).
+class PipelineStatsQuery {
+public:
+    void init(VkDevice _device, VkPhysicalDevice physicalDevice, uint32_t framesInFlight);
+    void destroy();
+
+    // reset has to be recorded outside of rendering, begin/end around the draws
+    void reset(VkCommandBuffer cmd, uint32_t frameIndex);
+    void begin(VkCommandBuffer cmd, uint32_t frameIndex);
+    void end(VkCommandBuffer cmd, uint32_t frameIndex);
+
+    // only valid once the frame slot's fence has signalled
+    bool read(uint32_t frameIndex, PipelineStats& stats);
+
+    bool isActive() const { return queryPool != VK_NULL_HANDLE; }
+
+private:
+    VkDevice    device    { VK_NULL_HANDLE };
+    VkQueryPool queryPool { VK_NULL_HANDLE };
+    uint32_t    written   { 0 };
+};
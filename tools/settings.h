@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdlib>
+#include <string>
+
+// runtime switches are read from the environment so automation can flip
+// them without a rebuild. all of them are prefixed with IDK_.
+
+inline const char* envValue(const char* name) {
+    const char* value = std::getenv(name);
+    if (value == nullptr || value[0] == '\0') {
+        return nullptr;
+    }
+    return value;
+}
+
+inline bool envFlag(const char* name, bool fallback = false) {
+    const char* value = envValue(name);
+    if (value == nullptr) {
+        return fallback;
+    }
+    return !(value[0] == '0' || value[0] == 'n' || value[0] == 'N' || value[0] == 'f' || value[0] == 'F');
+}
+
+inline std::string envString(const char* name, const char* fallback = "") {
+    const char* value = envValue(name);
+    return value ? std::string(value) : std::string(fallback);
+}
+
+inline double envNumber(const char* name, double fallback = 0.0) {
+    const char* value = envValue(name);
+    return value ? std::atof(value) : fallback;
+}
@@ -0,0 +1,191 @@
+#include "stagingRing.h"
+#include "utils.h"
+
+#include <iostream>
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+void StagingRing::init(VkDevice _device, VmaAllocator _allocator, MemoryTelemetry* _telemetry, VkSemaphore _timeline,
+                       VkDeviceSize _capacity, const char* name) {
+    device = _device;
+    allocator = _allocator;
+    telemetry = _telemetry;
+    timeline = _timeline;
+    ringCapacity = _capacity;
+
+    VkBufferCreateInfo bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.size = ringCapacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo info;
+    VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer, &allocation, &info));
+    telemetry->track(allocation, MemoryCategory::Staging, name);
+    mapped = static_cast<std::byte*>(info.pMappedData);
+
+    head = 0;
+    regions.clear();
+    frontRegion = 1;
+    fallbacks = 0;
+}
+
+void StagingRing::destroy() {
+    if (buffer == VK_NULL_HANDLE) {
+        return;
+    }
+
+    for (Dedicated& d : dedicated) {
+        telemetry->untrack(d.allocation);
+        vmaDestroyBuffer(allocator, d.buffer, d.allocation);
+    }
+    dedicated.clear();
+    regions.clear();
+
+    if (fallbacks > 0) {
+        std::cout << "staging ring: " << fallbacks << " uploads needed a dedicated buffer ("
+                  << (ringCapacity >> 20) << " MB ring)" << std::endl;
+    }
+
+    telemetry->untrack(allocation);
+    vmaDestroyBuffer(allocator, buffer, allocation);
+    buffer = VK_NULL_HANDLE;
+}
+
+uint64_t StagingRing::completedValue() {
+    uint64_t completed = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, timeline, &completed));
+    return completed;
+}
+
+void StagingRing::reclaim(uint64_t completed) {
+    while (!regions.empty() && regions.front().value != 0 && regions.front().value <= completed) {
+        regions.pop_front();
+        frontRegion++;
+    }
+    if (regions.empty()) {
+        head = 0;
+    }
+
+    std::erase_if(dedicated, [&](const Dedicated& d) {
+        if (d.value > completed) {
+            return false;
+        }
+        telemetry->untrack(d.allocation);
+        vmaDestroyBuffer(allocator, d.buffer, d.allocation);
+        return true;
+    });
+}
+
+bool StagingRing::tryAllocate(VkDeviceSize size, VkDeviceSize alignment, StagingSlice& slice) {
+    if (size > ringCapacity) {
+        slice = allocateDedicated(size);
+        return true;
+    }
+
+    std::lock_guard lock(mutex);
+    reclaim(completedValue());
+
+    while (true) {
+        VkDeviceSize start = 0;
+        bool fits = false;
+
+        if (regions.empty()) {
+            head = 0;
+            fits = true;
+        } else {
+            VkDeviceSize tail = regions.front().start;
+            VkDeviceSize alignedHead = alignUp(head, alignment);
+            if (head > tail) {
+                if (alignedHead + size <= ringCapacity) {
+                    start = alignedHead;
+                    fits = true;
+                } else if (size <= tail) {
+                    // wrap, the skipped end of the buffer belongs to this region
+                    start = 0;
+                    fits = true;
+                }
+            } else if (head < tail && alignedHead + size <= tail) {
+                start = alignedHead;
+                fits = true;
+            }
+        }
+
+        if (fits) {
+            regions.push_back({ head, start + size, 0 });
+            head = start + size;
+
+            slice = {};
+            slice.buffer = buffer;
+            slice.offset = start;
+            slice.size = size;
+            slice.data = mapped + start;
+            slice.region = frontRegion + regions.size() - 1;
+            return true;
+        }
+
+        // the oldest region is in the way. if it's been submitted the GPU will free it, otherwise give up
+        uint64_t value = regions.front().value;
+        if (value == 0) {
+            return false;
+        }
+
+        VkSemaphoreWaitInfo waitInfo { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &timeline;
+        waitInfo.pValues = &value;
+        VK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+        reclaim(completedValue());
+    }
+}
+
+StagingSlice StagingRing::allocateDedicated(VkDeviceSize size) {
+    VkBufferCreateInfo bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    StagingSlice slice {};
+    VmaAllocationInfo info;
+    VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &slice.buffer, &slice.dedicated, &info));
+    telemetry->track(slice.dedicated, MemoryCategory::Staging, "dedicated staging");
+    slice.size = size;
+    slice.data = static_cast<std::byte*>(info.pMappedData);
+
+    std::lock_guard lock(mutex);
+    fallbacks++;
+    return slice;
+}
+
+StagingSlice StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    StagingSlice slice;
+    if (!tryAllocate(size, alignment, slice)) {
+        slice = allocateDedicated(size);
+    }
+    return slice;
+}
+
+void StagingRing::release(const StagingSlice& slice, uint64_t timelineValue) {
+    if (!slice.valid()) {
+        return;
+    }
+
+    std::lock_guard lock(mutex);
+    if (slice.dedicated) {
+        dedicated.push_back({ slice.buffer, slice.dedicated, timelineValue });
+    } else {
+        regions[slice.region - frontRegion].value = timelineValue;
+    }
+    reclaim(completedValue());
+}
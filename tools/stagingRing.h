@@ -0,0 +1,81 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "memoryTelemetry.h"
+
+// one persistently mapped staging buffer, handed out front to back and wrapped
+// around. every slice is released with the timeline value of the submit that
+// reads it, and space comes back in allocation order once the owner's timeline
+// semaphore gets there.
+//
+// slices bigger than the ring, or that would have to wait on a slice nobody has
+// submitted yet, get a dedicated buffer instead, destroyed the same way.
+
+struct StagingSlice {
+    VkBuffer      buffer    { VK_NULL_HANDLE };
+    VkDeviceSize  offset    { 0 };
+    VkDeviceSize  size      { 0 };
+    std::byte*    data      { nullptr };
+    uint64_t      region    { 0 };
+    VmaAllocation dedicated { VK_NULL_HANDLE };
+
+    bool valid() const { return buffer != VK_NULL_HANDLE; }
+};
+
+class StagingRing {
+public:
+    void init(VkDevice _device, VmaAllocator _allocator, MemoryTelemetry* _telemetry, VkSemaphore _timeline,
+              VkDeviceSize _capacity, const char* name);
+    // everything released has to be complete on the GPU by now
+    void destroy();
+
+    // false only when the space is held by slices that haven't been released yet
+    bool tryAllocate(VkDeviceSize size, VkDeviceSize alignment, StagingSlice& slice);
+    StagingSlice allocateDedicated(VkDeviceSize size);
+    StagingSlice allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+    void release(const StagingSlice& slice, uint64_t timelineValue);
+
+    VkDeviceSize capacity() const { return ringCapacity; }
+
+private:
+    // value 0 = still being filled / recorded
+    struct Region {
+        VkDeviceSize start;
+        VkDeviceSize end;
+        uint64_t     value;
+    };
+
+    struct Dedicated {
+        VkBuffer      buffer;
+        VmaAllocation allocation;
+        uint64_t      value;
+    };
+
+    void reclaim(uint64_t completed);
+    uint64_t completedValue();
+
+    VkDevice               device       { VK_NULL_HANDLE };
+    VmaAllocator           allocator    { VK_NULL_HANDLE };
+    MemoryTelemetry*       telemetry    { nullptr };
+    VkSemaphore            timeline     { VK_NULL_HANDLE };
+
+    VkBuffer               buffer       { VK_NULL_HANDLE };
+    VmaAllocation          allocation   { VK_NULL_HANDLE };
+    std::byte*             mapped       { nullptr };
+    VkDeviceSize           ringCapacity { 0 };
+
+    std::mutex             mutex;
+    VkDeviceSize           head         { 0 };
+    std::deque<Region>     regions;
+    uint64_t               frontRegion  { 1 };   // id of regions.front()
+    std::vector<Dedicated> dedicated;
+    uint32_t               fallbacks    { 0 };
+};
@@ -0,0 +1,185 @@
+#include "startupProfiler.h"
+#include "settings.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace startup {
+
+namespace {
+    constexpr uint32_t noParent = UINT32_MAX;
+
+    struct Entry {
+        const char* name;
+        uint32_t    parent;
+        uint64_t    startNs;
+        uint64_t    endNs;
+        uint64_t    childNs;
+        bool        pipeline;
+        bool        worker;       // top level stage that ran on a job thread
+        bool        driverValid;
+        bool        cacheHit;
+        uint64_t    driverNs;
+    };
+
+    // static init runs on the main thread
+    const std::thread::id  mainThread = std::this_thread::get_id();
+
+    std::mutex             entryMutex;
+    std::vector<Entry>     entries;
+    uint64_t               firstFrameNs { 0 };
+
+    thread_local uint32_t  currentStage { noParent };
+
+    double toMs(uint64_t ns) {
+        return double(ns) / 1e6;
+    }
+}
+
+Stage::Stage(const char* name) {
+    std::lock_guard lock(entryMutex);
+    index = static_cast<uint32_t>(entries.size());
+    bool worker = currentStage == noParent && std::this_thread::get_id() != mainThread;
+    entries.push_back({ name, currentStage, trace::nowNs(), 0, 0, false, worker, false, false, 0 });
+    currentStage = index;
+}
+
+Stage::~Stage() {
+    uint64_t endNs = trace::nowNs();
+    const char* name;
+    uint64_t startNs;
+    {
+        std::lock_guard lock(entryMutex);
+        Entry& entry = entries[index];
+        entry.endNs = endNs;
+        if (entry.parent != noParent) {
+            entries[entry.parent].childNs += endNs - entry.startNs;
+        }
+        currentStage = entry.parent;
+        name = entry.name;
+        startNs = entry.startNs;
+    }
+    trace::record(name, startNs, endNs);
+}
+
+const void* PipelineFeedback::chain(const void* next, uint32_t stageCount) {
+    info.pNext = next;
+    info.pPipelineCreationFeedback = &pipeline;
+    info.pipelineStageCreationFeedbackCount = std::min<uint32_t>(stageCount, static_cast<uint32_t>(stages.size()));
+    info.pPipelineStageCreationFeedbacks = stages.data();
+    return &info;
+}
+
+void recordPipeline(const char* name, const PipelineFeedback& feedback, uint64_t startNs, uint64_t endNs) {
+    bool worker = currentStage == noParent && std::this_thread::get_id() != mainThread;
+    Entry entry { name, currentStage, startNs, endNs, 0, true, worker, false, false, 0 };
+    if (feedback.pipeline.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT) {
+        entry.driverValid = true;
+        entry.driverNs = feedback.pipeline.duration;
+        entry.cacheHit = feedback.pipeline.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT;
+    }
+
+    {
+        std::lock_guard lock(entryMutex);
+        if (entry.parent != noParent) {
+            entries[entry.parent].childNs += endNs - startNs;
+        }
+        entries.push_back(entry);
+    }
+    trace::record(name, startNs, endNs);
+}
+
+void markFirstFrame() {
+    if (firstFrameNs != 0) {
+        return;
+    }
+    firstFrameNs = trace::nowNs();
+
+    std::cout << "First frame after " << toMs(firstFrameNs) << " ms" << std::endl;
+}
+
+bool firstFrameDone() {
+    return firstFrameNs != 0;
+}
+
+bool report() {
+    std::lock_guard lock(entryMutex);
+
+    std::vector<uint32_t> order(entries.size());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+
+    auto selfNs = [](const Entry& entry) {
+        uint64_t total = entry.endNs - entry.startNs;
+        return total > entry.childNs ? total - entry.childNs : 0;
+    };
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return selfNs(entries[a]) > selfNs(entries[b]);
+    });
+
+    // job thread stages overlap the main thread ones, they'd be counted twice
+    uint64_t measuredNs = 0;
+    for (const Entry& entry : entries) {
+        if (entry.parent == noParent && !entry.worker) {
+            measuredNs += entry.endNs - entry.startNs;
+        }
+    }
+
+    std::cout << "Startup breakdown (ranked by self time):" << std::endl;
+    std::cout << "     self ms    total ms  stage" << std::endl;
+
+    char line[256];
+    for (uint32_t i : order) {
+        const Entry& entry = entries[i];
+        const char* parent = entry.parent != noParent ? entries[entry.parent].name : "";
+
+        snprintf(line, sizeof(line), "  %10.2f  %10.2f  %s%s%s", toMs(selfNs(entry)),
+            toMs(entry.endNs - entry.startNs), parent, entry.parent != noParent ? " > " : "", entry.name);
+        std::cout << line;
+
+        if (entry.worker) {
+            std::cout << "  [job thread]";
+        }
+        if (entry.pipeline) {
+            if (entry.driverValid) {
+                snprintf(line, sizeof(line), "  (driver %.2f ms%s)", toMs(entry.driverNs), entry.cacheHit ? ", cache hit" : "");
+                std::cout << line;
+            } else {
+                std::cout << "  (no driver feedback)";
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    if (firstFrameNs == 0) {
+        std::cout << "No frame was presented" << std::endl;
+        return true;
+    }
+
+    // everything outside a stage: static init, swapchain work in drawFrame, the first acquire etc.
+    uint64_t otherNs = firstFrameNs > measuredNs ? firstFrameNs - measuredNs : 0;
+    snprintf(line, sizeof(line), "  %10.2f  %10s  (outside any stage)", toMs(otherNs), "");
+    std::cout << line << std::endl;
+
+    double budgetMs = envNumber("IDK_STARTUP_BUDGET_MS", 0.0);
+    double firstFrameMs = toMs(firstFrameNs);
+    std::cout << "Time to first frame: " << firstFrameMs << " ms";
+    if (budgetMs <= 0.0) {
+        std::cout << std::endl;
+        return true;
+    }
+
+    std::cout << " (budget " << budgetMs << " ms)" << std::endl;
+    if (firstFrameMs > budgetMs) {
+        std::cerr << "Startup over budget by " << firstFrameMs - budgetMs << " ms" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+
+#include "trace.h"
+
+// wall-clock breakdown of everything between process start (the trace clock origin)
+// and the first present.
+// stages nest, and the report ranks them by self time (total minus children) so
+// a parent like Base::prepare doesn't hide which of its steps is slow.
+// every stage is also emitted as a trace zone when IDK_TRACE is set.
+//
+// IDK_STARTUP_BUDGET_MS=<ms> makes report() fail when time-to-first-frame is over budget,
+// IDK_STARTUP_EXIT=1 closes the window right after the first frame (for CI runs).
+
+namespace startup {
+
+void markFirstFrame();
+bool firstFrameDone();
+
+// prints the ranked breakdown, returns false if the budget was blown
+bool report();
+
+class Stage {
+public:
+    explicit Stage(const char* name);
+    ~Stage();
+
+    Stage(const Stage&) = delete;
+    Stage& operator=(const Stage&) = delete;
+
+private:
+    uint32_t index;
+};
+
+// VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO storage. chain() it into the
+// create info, then pass it to recordPipeline() once the pipeline exists. don't move it
+// in between, the driver writes through the pointers.
+struct PipelineFeedback {
+    VkPipelineCreationFeedback                pipeline {};
+    std::array<VkPipelineCreationFeedback, 8> stages {};
+    VkPipelineCreationFeedbackCreateInfo      info { VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO };
+
+    const void* chain(const void* next, uint32_t stageCount);
+};
+
+// adds the driver-reported compile time as a child of the current stage
+void recordPipeline(const char* name, const PipelineFeedback& feedback, uint64_t startNs, uint64_t endNs);
+
+}
+
+#define STARTUP_STAGE(name) startup::Stage TRACE_CONCAT(startupStage, __LINE__)(name)
@@ -0,0 +1,582 @@
+#include "textureStreamer.h"
+#include "files.h"
+#include "hash.h"
+#include "imageMips.h"
+#include "inits.h"
+#include "ktx2.h"
+#include "settings.h"
+#include "trace.h"
+#include "utils.h"
+#include "vfs.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+// a copy this big on the graphics queue fallback is already a visible stall, so batches stop growing here
+constexpr VkDeviceSize maxBatchBytes = 32ull << 20;
+
+VkFormat codecFormat(BlockCodec codec, bool srgb) {
+    switch (codec) {
+        case BlockCodec::BC1: return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        case BlockCodec::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+        case BlockCodec::BC7: return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+const char* codecExtension(BlockCodec codec) {
+    switch (codec) {
+        case BlockCodec::BC1: return "bc1.ktx2";
+        case BlockCodec::BC5: return "bc5.ktx2";
+        case BlockCodec::BC7: return "bc7.ktx2";
+    }
+    return "ktx2";
+}
+
+}
+
+void TextureStreamer::init(VkDevice _device, VmaAllocator _allocator, MemoryTelemetry* _telemetry, JobSystem* _jobs,
+                           UploadQueue* uploads, const QueueFamilyIndices& indices, VkQueue graphicsQueue,
+                           VkQueue transferQueue, std::mutex* graphicsQueueMutex, bool _blockCompression,
+                           BindlessTextures* _bindless, MipGenerator* _mipGenerator) {
+    device = _device;
+    allocator = _allocator;
+    telemetry = _telemetry;
+    jobs = _jobs;
+    blockCompression = _blockCompression;
+    bindless = _bindless;
+    mipGenerator = _mipGenerator;
+
+    graphicsFamily = indices.graphicsFamily;
+    dedicatedTransfer = indices.transferFamilyHasValue && transferQueue != VK_NULL_HANDLE;
+    if (dedicatedTransfer) {
+        uploadFamily = indices.transferFamily;
+        uploadQueue = transferQueue;
+        uploadQueueMutex = nullptr;
+    } else {
+        uploadFamily = indices.graphicsFamily;
+        uploadQueue = graphicsQueue;
+        uploadQueueMutex = graphicsQueueMutex;
+    }
+
+    VkSemaphoreTypeCreateInfo timelineInfo { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    semaphoreInfo.pNext = &timelineInfo;
+    VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline));
+    submittedValue = 0;
+
+    VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    cmdPoolInfo.queueFamilyIndex = uploadFamily;
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    VK_CHECK(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
+
+    for (Batch& batch : batches) {
+        VkCommandBufferAllocateInfo cmdBufferAllocInfo { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        cmdBufferAllocInfo.commandPool = commandPool;
+        cmdBufferAllocInfo.commandBufferCount = 1;
+        cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        VK_CHECK(vkAllocateCommandBuffers(device, &cmdBufferAllocInfo, &batch.cmd));
+        batch.timelineValue = 0;
+    }
+
+    VkDeviceSize ringSize = static_cast<VkDeviceSize>(envNumber("IDK_STAGING_MB", 64.0)) << 20;
+    staging.init(device, allocator, telemetry, timeline, ringSize, "texture staging ring");
+
+    createPlaceholder(uploads);
+
+    std::cout << "texture streaming on the " << (dedicatedTransfer ? "transfer" : "graphics") << " queue" << std::endl;
+
+    stopping = false;
+    thread = std::thread(&TextureStreamer::threadMain, this);
+}
+
+void TextureStreamer::createPlaceholder(UploadQueue* uploads) {
+    VkImageCreateInfo imageInfo = imageCreateInfo(VK_FORMAT_R8G8B8A8_SRGB,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, { 1, 1, 1 });
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    VK_CHECK(vmaCreateImage(allocator, &imageInfo, &allocInfo, &placeholder.image, &placeholder.allocation, nullptr));
+    telemetry->track(placeholder.allocation, MemoryCategory::Texture, "texture placeholder");
+    placeholder.imageExtent = imageInfo.extent;
+    placeholder.imageFormat = imageInfo.format;
+
+    VkImageViewCreateInfo viewInfo = imageviewCreateInfo(VK_FORMAT_R8G8B8A8_SRGB, placeholder.image, VK_IMAGE_ASPECT_COLOR_BIT);
+    VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &placeholder.imageView));
+
+    // owned by the graphics family from the start, so it never needs an acquire
+    uploads->submitAndWait([this](VkCommandBuffer cmd) {
+        transitionImage(cmd, placeholder.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+        VkClearColorValue grey = { { 0.5f, 0.5f, 0.5f, 1.0f } };
+        VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        vkCmdClearColorImage(cmd, placeholder.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &grey, 1, &range);
+
+        transitionImage(cmd, placeholder.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    });
+}
+
+void TextureStreamer::shutdown() {
+    if (!thread.joinable()) {
+        return;
+    }
+
+    // decodes still running would push into a stopped queue
+    jobs->wait(decodes);
+
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    pendingChanged.notify_one();
+    thread.join();
+
+    VkSemaphoreWaitInfo waitInfo { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline;
+    waitInfo.pValues = &submittedValue;
+    VK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+
+    // everything submitted is done, so that value frees the never submitted slices too
+    for (Upload& upload : pending) {
+        staging.release(upload.staging, submittedValue);
+        if (upload.mipViews.count > 0) {
+            mipGenerator->destroyViews(upload.mipViews);
+        }
+        destroyImage(upload.image);
+    }
+    for (Upload& upload : inFlight) {
+        if (upload.mipViews.count > 0) {
+            mipGenerator->destroyViews(upload.mipViews);
+        }
+        destroyImage(upload.image);
+    }
+    pending.clear();
+    inFlight.clear();
+    staging.destroy();
+
+    for (Texture& texture : textures) {
+        if (texture.state == State::Resident) {
+            destroyImage(texture.image);
+        }
+    }
+    textures.clear();
+
+    destroyImage(placeholder);
+
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroySemaphore(device, timeline, nullptr);
+}
+
+TextureHandle TextureStreamer::request(const char* filePath, TextureUsage usage, MipMode mipMode) {
+    TextureHandle handle;
+    {
+        std::lock_guard lock(mutex);
+        handle = static_cast<TextureHandle>(textures.size());
+        textures.push_back({ filePath });
+        textures.back().bindlessIndex = bindless->add(placeholder.imageView);
+    }
+
+    jobs->run(decodes, [this, handle, usage, mipMode, path = std::string(filePath)] {
+        decode(handle, path, usage, mipMode);
+    });
+    return handle;
+}
+
+void TextureStreamer::fail(TextureHandle handle, const std::string& path, const char* reason) {
+    std::cerr << "failed to load texture " << path << ": " << reason << std::endl;
+    std::lock_guard lock(mutex);
+    textures[handle].state = State::Failed;
+}
+
+std::optional<BlockCodec> TextureStreamer::chooseCodec(TextureUsage usage) const {
+    if (!blockCompression || !envFlag("IDK_TEXTURE_COMPRESS", true)) {
+        return std::nullopt;
+    }
+    if (usage == TextureUsage::Normal) {
+        return BlockCodec::BC5;
+    }
+    return envString("IDK_TEXTURE_CODEC", "bc7") == "bc1" ? BlockCodec::BC1 : BlockCodec::BC7;
+}
+
+bool TextureStreamer::useComputeMips(VkFormat format, uint32_t width, uint32_t height, MipMode mipMode) const {
+    uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+    return mipGenerator && !dedicatedTransfer && MipGenerator::useCompute(mipMode) &&
+           MipGenerator::supports(format, width, height, mipLevels);
+}
+
+void TextureStreamer::decode(TextureHandle handle, std::string path, TextureUsage usage, MipMode mipMode) {
+    TRACE_ZONE("stream decode");
+
+    AssetFile source;
+    if (!source.open(path.c_str())) {
+        fail(handle, path, "can't open file");
+        return;
+    }
+
+    bool srgb = usage == TextureUsage::Color;
+    std::optional<BlockCodec> codec = chooseCodec(usage);
+    VkFormat format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    std::string cachePath;
+    std::string sourceKey;
+    bool useCache = codec && envFlag("IDK_TEXTURE_CACHE", true);
+
+    if (codec) {
+        format = codecFormat(*codec, srgb);
+        cachePath = cacheFilePath(path.c_str(), codecExtension(*codec));
+
+        char key[64];
+        snprintf(key, sizeof(key), "%016llx-%zu-%u", static_cast<unsigned long long>(hash64(source.data(), source.size())),
+                 source.size(), cookerVersion);
+        sourceKey = key;
+    }
+
+    // cooked blocks go to the GPU as they are, no decode and no mips to build. a pack can ship them too
+    if (useCache) {
+        AssetFile cached;
+        Ktx2Image image;
+        if (cached.open(cachePath.c_str()) && parseKtx2(cached.span(), image) && image.format == format &&
+            image.value("idk.source") == sourceKey) {
+            stageUpload(handle, path, format, image.width, image.height, image.levels);
+            return;
+        }
+    }
+
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels = stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &texWidth, &texHeight,
+                                            &texChannels, STBI_rgb_alpha);
+    if (!pixels) {
+        fail(handle, path, stbi_failure_reason());
+        return;
+    }
+    source.close();
+
+    // level 0 goes up as it is and the batch dispatches the rest
+    if (!codec && useComputeMips(format, texWidth, texHeight, mipMode)) {
+        std::span<const uint8_t> level0(pixels, size_t(texWidth) * texHeight * 4);
+        stageUpload(handle, path, format, texWidth, texHeight, std::span(&level0, 1), true);
+        stbi_image_free(pixels);
+        return;
+    }
+
+    // the whole chain is built on this thread so the upload is plain copies, which is all a transfer queue can do
+    std::vector<ImageLevel> mips;
+    {
+        TRACE_ZONE("stream mips");
+        mips = buildMipChain(pixels, texWidth, texHeight, srgb);
+    }
+    stbi_image_free(pixels);
+    uint32_t mipLevels = static_cast<uint32_t>(mips.size());
+
+    if (!codec) {
+        std::vector<std::span<const uint8_t>> levels;
+        for (const ImageLevel& mip : mips) {
+            levels.push_back(mip.rgba);
+        }
+        stageUpload(handle, path, format, mips[0].width, mips[0].height, levels);
+        return;
+    }
+
+    auto cookStart = std::chrono::steady_clock::now();
+    std::vector<std::vector<uint8_t>> blocks(mipLevels);
+    {
+        TRACE_ZONE("stream compress");
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            const ImageLevel& mip = mips[level];
+            uint32_t blocksY = (mip.height + 3) / 4;
+            blocks[level].resize(size_t((mip.width + 3) / 4) * blocksY * blockBytes(*codec));
+
+            jobs->parallelFor(blocksY, 8, [&](uint32_t begin, uint32_t end) {
+                encodeBlockRows(mip.rgba.data(), mip.width, mip.height, *codec, begin, end, blocks[level].data());
+            });
+        }
+    }
+    double cookMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cookStart).count();
+
+    if (useCache) {
+        TRACE_ZONE("write texture cache");
+        std::pair<std::string, std::string> keyValues[] = { { "idk.source", sourceKey }, { "KTXwriter", "idk texture cooker" } };
+        std::vector<uint8_t> file = buildKtx2(format, mips[0].width, mips[0].height, blocks, keyValues);
+        if (writeFileAtomic(cachePath, file)) {
+            std::cout << "Cooked " << path << " to " << cachePath << " in " << cookMs << " ms" << std::endl;
+        }
+    }
+
+    std::vector<std::span<const uint8_t>> levels(blocks.begin(), blocks.end());
+    stageUpload(handle, path, format, mips[0].width, mips[0].height, levels);
+}
+
+void TextureStreamer::stageUpload(TextureHandle handle, const std::string& path, VkFormat format, uint32_t width,
+                                  uint32_t height, std::span<const std::span<const uint8_t>> levels, bool computeMips) {
+    Upload upload {};
+    upload.handle = handle;
+    upload.mipLevels = computeMips ? static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1
+                                   : static_cast<uint32_t>(levels.size());
+
+    // 16 keeps every level on a block boundary for all the formats we upload
+    VkDeviceSize totalSize = 0;
+    for (uint32_t level = 0; level < levels.size(); level++) {
+        VkBufferImageCopy region {};
+        region.bufferOffset = totalSize;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+        region.imageExtent = { std::max(1u, width >> level), std::max(1u, height >> level), 1 };
+        upload.regions.push_back(region);
+
+        totalSize = (totalSize + levels[level].size() + 15) & ~VkDeviceSize(15);
+    }
+
+    upload.staging = staging.allocate(totalSize, 16);
+    for (uint32_t level = 0; level < levels.size(); level++) {
+        memcpy(upload.staging.data + upload.regions[level].bufferOffset, levels[level].data(), levels[level].size());
+        upload.regions[level].bufferOffset += upload.staging.offset;
+    }
+
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (computeMips) {
+        usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    }
+    VkImageCreateInfo imageInfo = imageCreateInfo(format, usage, { width, height, 1 });
+    imageInfo.mipLevels = upload.mipLevels;
+    if (computeMips) {
+        // the generator writes through unorm storage views, see MipGenerator
+        imageInfo.flags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+    }
+
+    VmaAllocationCreateInfo imageAllocInfo = {};
+    imageAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    imageAllocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK(vmaCreateImage(allocator, &imageInfo, &imageAllocInfo, &upload.image.image, &upload.image.allocation, nullptr));
+    telemetry->track(upload.image.allocation, MemoryCategory::Texture, path.c_str());
+    upload.image.imageExtent = imageInfo.extent;
+    upload.image.imageFormat = imageInfo.format;
+
+    VkImageViewCreateInfo viewInfo = imageviewCreateInfo(format, upload.image.image, VK_IMAGE_ASPECT_COLOR_BIT);
+    viewInfo.subresourceRange.levelCount = upload.mipLevels;
+    VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &upload.image.imageView));
+
+    if (computeMips) {
+        upload.mipViews = mipGenerator->createViews(upload.image.image, format, upload.mipLevels);
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        pending.push_back(std::move(upload));
+    }
+    pendingChanged.notify_one();
+}
+
+VkImageMemoryBarrier2 TextureStreamer::ownershipBarrier(const Upload& upload) const {
+    // release and acquire have to match exactly, including the layout change
+    VkImageMemoryBarrier2 barrier { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex = dedicatedTransfer ? uploadFamily : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = dedicatedTransfer ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = upload.image.image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, upload.mipLevels, 0, 1 };
+    return barrier;
+}
+
+void TextureStreamer::recordUpload(VkCommandBuffer cmd, const Upload& upload) {
+    VkImageMemoryBarrier2 toTransfer { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+    toTransfer.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    toTransfer.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    toTransfer.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.image = upload.image.image;
+    toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, upload.mipLevels, 0, 1 };
+
+    VkDependencyInfo depInfo { VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    depInfo.imageMemoryBarrierCount = 1;
+    depInfo.pImageMemoryBarriers = &toTransfer;
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+
+    vkCmdCopyBufferToImage(cmd, upload.staging.buffer, upload.image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(upload.regions.size()), upload.regions.data());
+
+    // only on the graphics queue, and it leaves every level ready for the fragment shader
+    if (upload.mipViews.count > 0) {
+        mipGenerator->record(cmd, upload.image.image, upload.image.imageFormat, upload.mipViews,
+                             upload.image.imageExtent.width, upload.image.imageExtent.height);
+        return;
+    }
+
+    // release half. on the graphics fallback this is the whole transition
+    VkImageMemoryBarrier2 release = ownershipBarrier(upload);
+    release.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    release.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    if (!dedicatedTransfer) {
+        release.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+        release.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    }
+
+    depInfo.pImageMemoryBarriers = &release;
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+}
+
+void TextureStreamer::threadMain() {
+    trace::setThreadName("texture stream");
+
+    std::vector<Upload> batchUploads;
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            pendingChanged.wait(lock, [&] { return stopping || !pending.empty(); });
+            if (stopping) {
+                return;
+            }
+
+            VkDeviceSize batchBytes = 0;
+            size_t taken = 0;
+            while (taken < pending.size() && (taken == 0 || batchBytes < maxBatchBytes)) {
+                batchBytes += pending[taken].staging.size;
+                taken++;
+            }
+            batchUploads.assign(std::make_move_iterator(pending.begin()), std::make_move_iterator(pending.begin() + taken));
+            pending.erase(pending.begin(), pending.begin() + taken);
+        }
+
+        TRACE_ZONE("stream batch");
+
+        // recycle the oldest command buffer once its batch has retired
+        Batch& batch = batches[nextBatch];
+        nextBatch = (nextBatch + 1) % batchCount;
+        if (batch.timelineValue > 0) {
+            VkSemaphoreWaitInfo waitInfo { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &timeline;
+            waitInfo.pValues = &batch.timelineValue;
+            VK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+        }
+
+        VK_CHECK(vkResetCommandBuffer(batch.cmd, 0));
+        VkCommandBufferBeginInfo cmdBeginInfo = commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        VK_CHECK(vkBeginCommandBuffer(batch.cmd, &cmdBeginInfo));
+        for (const Upload& upload : batchUploads) {
+            recordUpload(batch.cmd, upload);
+        }
+        VK_CHECK(vkEndCommandBuffer(batch.cmd));
+
+        batch.timelineValue = submittedValue + 1;
+
+        VkSemaphoreSubmitInfo signalInfo = semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, timeline);
+        signalInfo.value = batch.timelineValue;
+        VkCommandBufferSubmitInfo cmdInfo = submitCommandBufferInfo(batch.cmd);
+        VkSubmitInfo2 submit = createSubmitInfo(&cmdInfo, &signalInfo, nullptr);
+
+        if (uploadQueueMutex) {
+            std::lock_guard lock(*uploadQueueMutex);
+            VK_CHECK(vkQueueSubmit2(uploadQueue, 1, &submit, VK_NULL_HANDLE));
+        } else {
+            VK_CHECK(vkQueueSubmit2(uploadQueue, 1, &submit, VK_NULL_HANDLE));
+        }
+
+        for (const Upload& upload : batchUploads) {
+            staging.release(upload.staging, batch.timelineValue);
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            submittedValue = batch.timelineValue;
+            for (Upload& upload : batchUploads) {
+                upload.timelineValue = batch.timelineValue;
+                textures[upload.handle].state = State::InFlight;
+                inFlight.push_back(std::move(upload));
+            }
+        }
+        batchUploads.clear();
+    }
+}
+
+uint64_t TextureStreamer::update(VkCommandBuffer cmd) {
+    uint64_t completed = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, timeline, &completed));
+
+    std::vector<VkImageMemoryBarrier2> acquires;
+    uint64_t waitValue = 0;
+    {
+        std::lock_guard lock(mutex);
+        auto landed = std::partition(inFlight.begin(), inFlight.end(), [&](const Upload& upload) {
+            return upload.timelineValue > completed;
+        });
+
+        for (auto it = landed; it != inFlight.end(); it++) {
+            Upload& upload = *it;
+
+            if (dedicatedTransfer) {
+                // src is waitInfo()'s stage, which chains the layout transition after the timeline wait
+                VkImageMemoryBarrier2 acquire = ownershipBarrier(upload);
+                acquire.srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+                acquire.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+                acquire.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+                acquires.push_back(acquire);
+                waitValue = std::max(waitValue, upload.timelineValue);
+            }
+
+            // the dispatch that wrote through them has finished
+            if (upload.mipViews.count > 0) {
+                mipGenerator->destroyViews(upload.mipViews);
+            }
+
+            Texture& texture = textures[upload.handle];
+            texture.image = upload.image;
+            texture.state = State::Resident;
+            bindless->set(texture.bindlessIndex, texture.image.imageView);
+        }
+        inFlight.erase(landed, inFlight.end());
+    }
+
+    if (!acquires.empty()) {
+        VkDependencyInfo depInfo { VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+        depInfo.imageMemoryBarrierCount = static_cast<uint32_t>(acquires.size());
+        depInfo.pImageMemoryBarriers = acquires.data();
+        vkCmdPipelineBarrier2(cmd, &depInfo);
+    }
+
+    // usually signaled by the time we get here, the wait is what orders the release before the acquire
+    return waitValue;
+}
+
+VkSemaphoreSubmitInfo TextureStreamer::waitInfo(uint64_t value) const {
+    VkSemaphoreSubmitInfo info = semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, timeline);
+    info.value = value;
+    return info;
+}
+
+VkImageView TextureStreamer::imageView(TextureHandle handle) {
+    std::lock_guard lock(mutex);
+    const Texture& texture = textures[handle];
+    return texture.state == State::Resident ? texture.image.imageView : placeholder.imageView;
+}
+
+bool TextureStreamer::isResident(TextureHandle handle) {
+    std::lock_guard lock(mutex);
+    return textures[handle].state == State::Resident;
+}
+
+uint32_t TextureStreamer::bindlessIndex(TextureHandle handle) {
+    std::lock_guard lock(mutex);
+    return textures[handle].bindlessIndex;
+}
+
+void TextureStreamer::destroyImage(AllocatedImage& image) {
+    vkDestroyImageView(device, image.imageView, nullptr);
+    telemetry->untrack(image.allocation);
+    vmaDestroyImage(allocator, image.image, image.allocation);
+    image = {};
+}
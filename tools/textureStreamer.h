@@ -0,0 +1,159 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+#include "bindlessTextures.h"
+#include "blockCompress.h"
+#include "jobSystem.h"
+#include "memoryTelemetry.h"
+#include "mipGenerator.h"
+#include "stagingRing.h"
+#include "uploadQueue.h"
+
+// loads textures behind the renderer's back. request() hands out a handle that
+// points at a grey placeholder right away; decoding and mip generation run as
+// jobs straight into a staging ring, and one streaming thread batches the copies
+// into a single submit that signals a timeline semaphore.
+//
+// with a dedicated transfer family the copies run there and each image is
+// released to the graphics family; update() records the matching acquire into
+// the frame's command buffer once the timeline says the copy has landed.
+// without one, batches go to the graphics queue and no ownership transfer is needed.
+//
+// IDK_TRANSFER_QUEUE=0 forces the graphics queue path.
+//
+// on devices with BC support the first load cooks the image to BC7 (BC5 for normal
+// maps) with its whole mip chain and keeps it as KTX2 next to the mesh cache, so
+// later runs just copy blocks. IDK_TEXTURE_COMPRESS=0 uploads plain RGBA8,
+// IDK_TEXTURE_CODEC=bc1 trades quality for half the size on colour textures and
+// IDK_TEXTURE_CACHE=0 cooks every run without touching the disk.
+//
+// every request also gets a slot in the bindless table, pointing at the placeholder
+// until update() swaps the streamed image in.
+//
+// uncompressed uploads on the graphics queue only copy level 0 and let MipGenerator
+// build the rest in the same batch (MipMode per request, IDK_MIP_COMPUTE=0 turns it
+// off). a transfer queue can't dispatch and the BC cooker needs every level on the
+// CPU to compress it, so those keep the CPU chain.
+
+using TextureHandle = uint32_t;
+
+enum class TextureUsage : uint8_t {
+    Color,      // srgb
+    Normal,     // linear, only xy survive compression
+};
+
+class TextureStreamer {
+public:
+    void init(VkDevice _device, VmaAllocator _allocator, MemoryTelemetry* _telemetry, JobSystem* _jobs,
+              UploadQueue* uploads, const QueueFamilyIndices& indices, VkQueue graphicsQueue,
+              VkQueue transferQueue, std::mutex* graphicsQueueMutex, bool _blockCompression,
+              BindlessTextures* _bindless, MipGenerator* _mipGenerator);
+    void shutdown();
+
+    TextureHandle request(const char* filePath, TextureUsage usage = TextureUsage::Color,
+                          MipMode mipMode = MipMode::Default);
+
+    // main thread, once per frame after cmd has begun. returns the timeline value the
+    // frame's submit has to wait on (0 when nothing was acquired)
+    uint64_t update(VkCommandBuffer cmd);
+
+    VkSemaphoreSubmitInfo waitInfo(uint64_t value) const;
+
+    // the placeholder's view until the texture is resident
+    VkImageView imageView(TextureHandle handle);
+    bool isResident(TextureHandle handle);
+    // slot in the bindless table, valid from request() on
+    uint32_t bindlessIndex(TextureHandle handle);
+    bool usesTransferQueue() const { return dedicatedTransfer; }
+
+private:
+    enum class State : uint8_t {
+        Loading,
+        InFlight,
+        Resident,
+        Failed,
+    };
+
+    struct Texture {
+        std::string    path;
+        State          state         { State::Loading };
+        AllocatedImage image         {};
+        uint32_t       bindlessIndex { 0 };
+    };
+
+    struct Upload {
+        TextureHandle                  handle;
+        AllocatedImage                 image;
+        StagingSlice                   staging;
+        uint32_t                       mipLevels;
+        std::vector<VkBufferImageCopy> regions;
+        MipGenerator::Views            mipViews      {};    // count 0 when the levels came from staging
+        uint64_t                       timelineValue { 0 };
+    };
+
+    struct Batch {
+        VkCommandBuffer cmd;
+        uint64_t        timelineValue { 0 };
+    };
+
+    static constexpr uint32_t batchCount { 4 };
+    // bump when the encoders change so old cooks get redone
+    static constexpr uint32_t cookerVersion { 1 };
+
+    void createPlaceholder(UploadQueue* uploads);
+    std::optional<BlockCodec> chooseCodec(TextureUsage usage) const;
+    bool useComputeMips(VkFormat format, uint32_t width, uint32_t height, MipMode mipMode) const;
+    void decode(TextureHandle handle, std::string path, TextureUsage usage, MipMode mipMode);
+    // computeMips: levels is only level 0, the rest of the chain is dispatched after the copy
+    void stageUpload(TextureHandle handle, const std::string& path, VkFormat format, uint32_t width, uint32_t height,
+                     std::span<const std::span<const uint8_t>> levels, bool computeMips = false);
+    void fail(TextureHandle handle, const std::string& path, const char* reason);
+    void threadMain();
+    void recordUpload(VkCommandBuffer cmd, const Upload& upload);
+    VkImageMemoryBarrier2 ownershipBarrier(const Upload& upload) const;
+    void destroyImage(AllocatedImage& image);
+
+    VkDevice                device            { VK_NULL_HANDLE };
+    VmaAllocator            allocator         { VK_NULL_HANDLE };
+    MemoryTelemetry*        telemetry         { nullptr };
+    JobSystem*              jobs              { nullptr };
+    bool                    blockCompression  { false };
+    BindlessTextures*       bindless          { nullptr };
+    MipGenerator*           mipGenerator      { nullptr };
+
+    bool                    dedicatedTransfer { false };
+    uint32_t                graphicsFamily    { 0 };
+    uint32_t                uploadFamily      { 0 };
+    VkQueue                 uploadQueue       { VK_NULL_HANDLE };
+    std::mutex*             uploadQueueMutex  { nullptr };   // null when the queue is ours alone
+
+    VkCommandPool           commandPool       { VK_NULL_HANDLE };
+    Batch                   batches[batchCount];
+    uint32_t                nextBatch         { 0 };
+    VkSemaphore             timeline          { VK_NULL_HANDLE };
+    uint64_t                submittedValue    { 0 };
+    StagingRing             staging;
+
+    AllocatedImage          placeholder {};
+
+    JobCounter              decodes;
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable pendingChanged;
+    std::deque<Texture>     textures;
+    std::vector<Upload>     pending;
+    std::vector<Upload>     inFlight;
+    bool                    stopping          { false };
+};
@@ -0,0 +1,278 @@
+#include "trace.h"
+#include "settings.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace trace {
+
+struct Track {
+    std::string        name;
+    uint32_t           id;
+    std::vector<Event> events;
+};
+
+namespace {
+    std::atomic<bool>                   traceEnabled { false };
+    std::string                         outputPath;
+    const auto                          origin = std::chrono::steady_clock::now();
+
+    std::mutex                          registryMutex;
+    std::vector<std::unique_ptr<Track>> tracks;
+    uint32_t                            nextTrackId { 1 };
+
+    thread_local Track*                 localTrack { nullptr };
+
+    Track* registerTrack(std::string name) {
+        std::lock_guard lock(registryMutex);
+        auto track = std::make_unique<Track>();
+        track->id = nextTrackId++;
+        track->name = name.empty() ? "thread " + std::to_string(track->id) : std::move(name);
+        track->events.reserve(4096);
+        tracks.push_back(std::move(track));
+        return tracks.back().get();
+    }
+
+    Track* threadTrack() {
+        if (!localTrack) {
+            localTrack = registerTrack({});
+        }
+        return localTrack;
+    }
+
+    void writeEscaped(std::ofstream& out, const char* text) {
+        for (const char* c = text; *c; c++) {
+            if (*c == '"' || *c == '\\') out << '\\';
+            out << *c;
+        }
+    }
+}
+
+void init() {
+    outputPath = envString("IDK_TRACE");
+    traceEnabled = !outputPath.empty();
+
+    if (traceEnabled) {
+        setThreadName("main");
+        std::cout << "Tracing to " << outputPath << std::endl;
+    }
+}
+
+bool enabled() {
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+
+uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void setThreadName(const char* name) {
+    Track* track = threadTrack();
+    std::lock_guard lock(registryMutex);
+    track->name = name;
+}
+
+void record(const char* name, uint64_t startNs, uint64_t endNs) {
+    record(threadTrack(), name, startNs, endNs);
+}
+
+void record(Track* track, const char* name, uint64_t startNs, uint64_t endNs) {
+    if (!enabled() || !track) {
+        return;
+    }
+    track->events.push_back({ name, startNs, endNs });
+}
+
+Track* createTrack(const char* name) {
+    return registerTrack(name);
+}
+
+void flush() {
+    if (!enabled()) {
+        return;
+    }
+
+    std::lock_guard lock(registryMutex);
+
+    std::ofstream out(outputPath, std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Could not open trace output " << outputPath << std::endl;
+        return;
+    }
+
+    // microseconds with the nanoseconds kept, the default 6 digits lose them after ~10 s
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+    for (const auto& track : tracks) {
+        if (!first) out << ",\n";
+        first = false;
+
+        out << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << track->id << R"(,"args":{"name":")";
+        writeEscaped(out, track->name.c_str());
+        out << "\"}}";
+
+        for (const Event& event : track->events) {
+            out << ",\n{\"name\":\"";
+            writeEscaped(out, event.name);
+            out << R"(","ph":"X","pid":1,"tid":)" << track->id
+                << ",\"ts\":" << event.startNs / 1000.0
+                << ",\"dur\":" << (event.endNs - event.startNs) / 1000.0 << "}";
+        }
+    }
+
+    out << "\n]}\n";
+
+    size_t eventCount = 0;
+    for (const auto& track : tracks) {
+        eventCount += track->events.size();
+        track->events.clear();
+    }
+
+    std::cout << "Wrote " << eventCount << " trace events to " << outputPath << std::endl;
+}
+
+void GpuProfiler::init(VkDevice _device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+                       uint32_t framesInFlight, uint32_t maxZonesPerFrame) {
+    if (!enabled()) {
+        return;
+    }
+
+    device = _device;
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+    uint32_t validBits = families[queueFamily].timestampValidBits;
+    if (validBits == 0) {
+        std::cerr << "Queue family has no timestamp support, GPU zones disabled" << std::endl;
+        return;
+    }
+    tickMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    nsPerTick = properties.limits.timestampPeriod;
+
+    queriesPerFrame = maxZonesPerFrame * 2;
+    frames.resize(framesInFlight);
+
+    VkQueryPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = queriesPerFrame * framesInFlight;
+
+    VK_CHECK(vkCreateQueryPool(device, &poolInfo, nullptr, &queryPool));
+
+    track = createTrack("GPU");
+}
+
+void GpuProfiler::calibrate(const std::function<void(std::function<void(VkCommandBuffer)>&&)>& submit) {
+    if (!isActive()) {
+        return;
+    }
+
+    // stamp once on an otherwise idle queue and pin that tick to the middle of the
+    // cpu window around the submit. good to well under a frame, which is all a
+    // timeline view needs.
+    uint64_t cpuBefore = nowNs();
+    submit([&](VkCommandBuffer cmd) {
+        vkCmdResetQueryPool(cmd, queryPool, 0, 1);
+        vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, 0);
+    });
+    uint64_t cpuAfter = nowNs();
+
+    uint64_t ticks = 0;
+    VK_CHECK(vkGetQueryPoolResults(device, queryPool, 0, 1, sizeof(ticks), &ticks, sizeof(ticks),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    int64_t gpuNs = static_cast<int64_t>((ticks & tickMask) * nsPerTick);
+    offsetNs = static_cast<int64_t>((cpuBefore + cpuAfter) / 2) - gpuNs;
+}
+
+void GpuProfiler::destroy() {
+    if (queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        queryPool = VK_NULL_HANDLE;
+    }
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer cmd, uint32_t frameIndex) {
+    if (!isActive()) {
+        return;
+    }
+
+    collect(frameIndex);
+
+    currentFrame = frameIndex;
+    frames[frameIndex].names.clear();
+    frames[frameIndex].queryCount = 0;
+
+    vkCmdResetQueryPool(cmd, queryPool, frameIndex * queriesPerFrame, queriesPerFrame);
+}
+
+uint32_t GpuProfiler::beginZone(VkCommandBuffer cmd, const char* name) {
+    if (!isActive()) {
+        return UINT32_MAX;
+    }
+
+    FrameZones& zones = frames[currentFrame];
+    if (zones.queryCount + 2 > queriesPerFrame) {
+        return UINT32_MAX;
+    }
+
+    uint32_t zone = static_cast<uint32_t>(zones.names.size());
+    zones.names.push_back(name);
+    zones.queryCount += 2;
+
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, queryPool,
+        currentFrame * queriesPerFrame + zone * 2);
+
+    return zone;
+}
+
+void GpuProfiler::endZone(VkCommandBuffer cmd, uint32_t zone) {
+    if (zone == UINT32_MAX) {
+        return;
+    }
+
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, queryPool,
+        currentFrame * queriesPerFrame + zone * 2 + 1);
+}
+
+void GpuProfiler::collect(uint32_t frameIndex) {
+    FrameZones& zones = frames[frameIndex];
+    if (zones.queryCount == 0) {
+        return;
+    }
+
+    // value + availability per query
+    std::vector<uint64_t> results(zones.queryCount * 2);
+    vkGetQueryPoolResults(device, queryPool, frameIndex * queriesPerFrame, zones.queryCount,
+        results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    for (uint32_t zone = 0; zone < zones.names.size(); zone++) {
+        const uint64_t* begin = &results[zone * 4];
+        const uint64_t* end = &results[zone * 4 + 2];
+        if (begin[1] == 0 || end[1] == 0) {
+            continue;
+        }
+
+        uint64_t startNs = static_cast<uint64_t>(static_cast<int64_t>((begin[0] & tickMask) * nsPerTick) + offsetNs);
+        uint64_t endNs = static_cast<uint64_t>(static_cast<int64_t>((end[0] & tickMask) * nsPerTick) + offsetNs);
+        record(track, zones.names[zone], startNs, std::max(startNs, endNs));
+    }
+}
+
+}
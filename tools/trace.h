@@ -0,0 +1,116 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// scoped-zone tracer that writes chrome trace-event json (load it in
+// chrome://tracing or ui.perfetto.dev). enable with IDK_TRACE=<output path>.
+//
+// every thread appends into its own buffer so recording never takes a lock.
+// buffers are only walked by trace::flush(), which must run once the worker
+// threads have gone quiet (Base does it at shutdown).
+//
+// zone names must outlive the tracer -- string literals only.
+
+namespace trace {
+
+struct Event {
+    const char* name;
+    uint64_t    startNs;
+    uint64_t    endNs;
+};
+
+struct Track;
+
+void     init();
+bool     enabled();
+uint64_t nowNs();
+void     setThreadName(const char* name);
+void     record(const char* name, uint64_t startNs, uint64_t endNs);
+void     record(Track* track, const char* name, uint64_t startNs, uint64_t endNs);
+Track*   createTrack(const char* name);
+void     flush();
+
+class Zone {
+public:
+    explicit Zone(const char* _name) : name(_name), active(enabled()) {
+        if (active) startNs = nowNs();
+    }
+    ~Zone() {
+        if (active) record(name, startNs, nowNs());
+    }
+
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+private:
+    const char* name;
+    uint64_t    startNs { 0 };
+    bool        active;
+};
+
+// timestamp queries around command buffer regions. results for a frame slot are
+// collected the next time that slot comes around (its fence has been waited on by then)
+// and are mapped onto the cpu clock through a one-off calibration submit.
+class GpuProfiler {
+public:
+    void init(VkDevice _device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+              uint32_t framesInFlight, uint32_t maxZonesPerFrame = 32);
+    void calibrate(const std::function<void(std::function<void(VkCommandBuffer)>&&)>& submit);
+    void destroy();
+
+    void     beginFrame(VkCommandBuffer cmd, uint32_t frameIndex);
+    uint32_t beginZone(VkCommandBuffer cmd, const char* name);
+    void     endZone(VkCommandBuffer cmd, uint32_t zone);
+
+    bool isActive() const { return queryPool != VK_NULL_HANDLE; }
+
+private:
+    void collect(uint32_t frameIndex);
+
+    struct FrameZones {
+        std::vector<const char*> names;
+        uint32_t                 queryCount { 0 };
+    };
+
+    VkDevice                device         { VK_NULL_HANDLE };
+    VkQueryPool             queryPool      { VK_NULL_HANDLE };
+    uint32_t                queriesPerFrame { 0 };
+    uint32_t                currentFrame   { 0 };
+    double                  nsPerTick      { 1.0 };
+    uint64_t                tickMask       { ~0ull };
+    int64_t                 offsetNs       { 0 };
+    std::vector<FrameZones> frames;
+    Track*                  track          { nullptr };
+};
+
+class GpuZone {
+public:
+    GpuZone(GpuProfiler& _profiler, VkCommandBuffer _cmd, const char* name)
+        : profiler(_profiler), cmd(_cmd), zone(_profiler.beginZone(_cmd, name)) {}
+    ~GpuZone() { profiler.endZone(cmd, zone); }
+
+    GpuZone(const GpuZone&) = delete;
+    GpuZone& operator=(const GpuZone&) = delete;
+
+private:
+    GpuProfiler&    profiler;
+    VkCommandBuffer cmd;
+    uint32_t        zone;
+};
+
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifndef IDK_DISABLE_TRACING
+#define TRACE_ZONE(name) trace::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_GPU_ZONE(profiler, cmd, name) trace::GpuZone TRACE_CONCAT(traceGpuZone, __LINE__)(profiler, cmd, name)
+#else
+#define TRACE_ZONE(name) do {} while (0)
+#define TRACE_GPU_ZONE(profiler, cmd, name) do {} while (0)
+#endif
+
+#define TRACE_FUNCTION() TRACE_ZONE(__func__)
@@ -0,0 +1,274 @@
+#include "transformHierarchy.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IDK_TRANSFORM_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+void expandLocal(const float (*local)[4], uint32_t lane, float* world) {
+    for (uint32_t column = 0; column < 4; column++) {
+        world[column * 4 + 0] = local[column * 3 + 0][lane];
+        world[column * 4 + 1] = local[column * 3 + 1][lane];
+        world[column * 4 + 2] = local[column * 3 + 2][lane];
+        world[column * 4 + 3] = column == 3 ? 1.0f : 0.0f;
+    }
+}
+
+// world = parent * local, the local's bottom row being 0 0 0 1 saves a quarter of the work
+void multiplyLocal(const float* parent, const float (*local)[4], uint32_t lane, float* world) {
+#ifdef IDK_TRANSFORM_SSE
+    __m128 c0 = _mm_loadu_ps(parent + 0);
+    __m128 c1 = _mm_loadu_ps(parent + 4);
+    __m128 c2 = _mm_loadu_ps(parent + 8);
+    __m128 c3 = _mm_loadu_ps(parent + 12);
+
+    for (uint32_t column = 0; column < 4; column++) {
+        __m128 result = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(local[column * 3 + 0][lane])),
+                       _mm_mul_ps(c1, _mm_set1_ps(local[column * 3 + 1][lane]))),
+            _mm_mul_ps(c2, _mm_set1_ps(local[column * 3 + 2][lane])));
+        if (column == 3) {
+            result = _mm_add_ps(result, c3);
+        }
+        _mm_storeu_ps(world + column * 4, result);
+    }
+#else
+    for (uint32_t column = 0; column < 4; column++) {
+        float x = local[column * 3 + 0][lane];
+        float y = local[column * 3 + 1][lane];
+        float z = local[column * 3 + 2][lane];
+        for (uint32_t row = 0; row < 4; row++) {
+            float value = parent[row] * x + parent[4 + row] * y + parent[8 + row] * z;
+            world[column * 4 + row] = column == 3 ? value + parent[12 + row] : value;
+        }
+    }
+#endif
+}
+
+}
+
+TransformHierarchy::TransformHierarchy(uint32_t _gpuCopies)
+    : gpuCopies(std::max(_gpuCopies, 1u)) {
+    pending.resize(gpuCopies);
+}
+
+void TransformHierarchy::setGpuCopies(uint32_t copies) {
+    gpuCopies = std::max(copies, 1u);
+    pending.assign(gpuCopies, count > 0 ? Range { 0, count } : Range {});
+}
+
+void TransformHierarchy::reserve(uint32_t capacity) {
+    size_t padded = (static_cast<size_t>(capacity) + 3) & ~size_t(3);
+    for (std::vector<float>* array : { &tx, &ty, &tz, &rx, &ry, &rz, &rw, &sx, &sy, &sz }) {
+        array->reserve(padded);
+    }
+    parents.reserve(padded);
+    dirty.reserve(padded);
+    worlds.reserve(padded * 16);
+}
+
+void TransformHierarchy::clear() {
+    count = 0;
+    for (std::vector<float>* array : { &tx, &ty, &tz, &rx, &ry, &rz, &rw, &sx, &sy, &sz }) {
+        array->clear();
+    }
+    parents.clear();
+    dirty.clear();
+    worlds.clear();
+    std::fill(pending.begin(), pending.end(), Range {});
+}
+
+// padding entries are identity and never dirty, so whole blocks of 4 can always be read
+void TransformHierarchy::grow(uint32_t padded) {
+    parents.resize(padded, noParent);
+    tx.resize(padded, 0.0f);
+    ty.resize(padded, 0.0f);
+    tz.resize(padded, 0.0f);
+    rx.resize(padded, 0.0f);
+    ry.resize(padded, 0.0f);
+    rz.resize(padded, 0.0f);
+    rw.resize(padded, 1.0f);
+    sx.resize(padded, 1.0f);
+    sy.resize(padded, 1.0f);
+    sz.resize(padded, 1.0f);
+    dirty.resize(padded, 0);
+}
+
+uint32_t TransformHierarchy::add(uint32_t parent) {
+    assert(parent == noParent || parent < count);
+
+    uint32_t node = count++;
+    uint32_t padded = (count + 3) & ~3u;
+    if (parents.size() < padded) {
+        grow(padded);
+    }
+
+    worlds.resize(static_cast<size_t>(count) * 16, 0.0f);
+    parents[node] = parent;
+    markDirty(node);
+    return node;
+}
+
+void TransformHierarchy::setTranslation(uint32_t node, float x, float y, float z) {
+    tx[node] = x;
+    ty[node] = y;
+    tz[node] = z;
+    markDirty(node);
+}
+
+void TransformHierarchy::setRotation(uint32_t node, float x, float y, float z, float w) {
+    rx[node] = x;
+    ry[node] = y;
+    rz[node] = z;
+    rw[node] = w;
+    markDirty(node);
+}
+
+void TransformHierarchy::setScale(uint32_t node, float x, float y, float z) {
+    sx[node] = x;
+    sy[node] = y;
+    sz[node] = z;
+    markDirty(node);
+}
+
+// translation * rotation * scale for four nodes at once, straight out of the SoA arrays
+void TransformHierarchy::composeBlock(uint32_t base, float (*local)[4]) const {
+#ifdef IDK_TRANSFORM_SSE
+    __m128 x = _mm_loadu_ps(&rx[base]);
+    __m128 y = _mm_loadu_ps(&ry[base]);
+    __m128 z = _mm_loadu_ps(&rz[base]);
+    __m128 w = _mm_loadu_ps(&rw[base]);
+
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 two = _mm_set1_ps(2.0f);
+
+    __m128 xx = _mm_mul_ps(x, x);
+    __m128 yy = _mm_mul_ps(y, y);
+    __m128 zz = _mm_mul_ps(z, z);
+    __m128 xy = _mm_mul_ps(x, y);
+    __m128 xz = _mm_mul_ps(x, z);
+    __m128 yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(w, x);
+    __m128 wy = _mm_mul_ps(w, y);
+    __m128 wz = _mm_mul_ps(w, z);
+
+    __m128 scaleX = _mm_loadu_ps(&sx[base]);
+    __m128 scaleY = _mm_loadu_ps(&sy[base]);
+    __m128 scaleZ = _mm_loadu_ps(&sz[base]);
+
+    auto store = [&](uint32_t index, __m128 value) {
+        _mm_storeu_ps(local[index], value);
+    };
+
+    store(0, _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX));
+    store(1, _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX));
+    store(2, _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX));
+
+    store(3, _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY));
+    store(4, _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY));
+    store(5, _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY));
+
+    store(6, _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ));
+    store(7, _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ));
+    store(8, _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ));
+
+    store(9, _mm_loadu_ps(&tx[base]));
+    store(10, _mm_loadu_ps(&ty[base]));
+    store(11, _mm_loadu_ps(&tz[base]));
+#else
+    for (uint32_t lane = 0; lane < 4; lane++) {
+        uint32_t i = base + lane;
+        float x = rx[i], y = ry[i], z = rz[i], w = rw[i];
+
+        local[0][lane] = (1.0f - 2.0f * (y * y + z * z)) * sx[i];
+        local[1][lane] = 2.0f * (x * y + w * z) * sx[i];
+        local[2][lane] = 2.0f * (x * z - w * y) * sx[i];
+
+        local[3][lane] = 2.0f * (x * y - w * z) * sy[i];
+        local[4][lane] = (1.0f - 2.0f * (x * x + z * z)) * sy[i];
+        local[5][lane] = 2.0f * (y * z + w * x) * sy[i];
+
+        local[6][lane] = 2.0f * (x * z + w * y) * sz[i];
+        local[7][lane] = 2.0f * (y * z - w * x) * sz[i];
+        local[8][lane] = (1.0f - 2.0f * (x * x + y * y)) * sz[i];
+
+        local[9][lane] = tx[i];
+        local[10][lane] = ty[i];
+        local[11][lane] = tz[i];
+    }
+#endif
+}
+
+uint32_t TransformHierarchy::update() {
+    // parents come first, so a parent's flag is final by the time its children look at it
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t parent = parents[i];
+        if (parent != noParent && dirty[parent]) {
+            dirty[i] = 1;
+        }
+    }
+
+    Range changed;
+    uint32_t updated = 0;
+    alignas(16) float local[12][4];
+
+    for (uint32_t base = 0; base < count; base += 4) {
+        // four flags in one load, most blocks of a mostly static scene stop here
+        uint32_t flags;
+        memcpy(&flags, &dirty[base], sizeof(flags));
+        if (flags == 0) {
+            continue;
+        }
+
+        composeBlock(base, local);
+
+        uint32_t lanes = std::min(4u, count - base);
+        for (uint32_t lane = 0; lane < lanes; lane++) {
+            uint32_t node = base + lane;
+            if (!dirty[node]) {
+                continue;
+            }
+
+            // a parent in the same block was finished a lane earlier
+            float* world = &worlds[static_cast<size_t>(node) * 16];
+            if (parents[node] == noParent) {
+                expandLocal(local, lane, world);
+            } else {
+                multiplyLocal(&worlds[static_cast<size_t>(parents[node]) * 16], local, lane, world);
+            }
+
+            dirty[node] = 0;
+            changed.begin = std::min(changed.begin, node);
+            changed.end = node + 1;
+            updated++;
+        }
+    }
+
+    if (updated > 0) {
+        for (Range& range : pending) {
+            range.begin = std::min(range.begin, changed.begin);
+            range.end = std::max(range.end, changed.end);
+        }
+    }
+    return updated;
+}
+
+size_t TransformHierarchy::writeWorlds(uint32_t copy, void* mapped) {
+    Range& range = pending[copy];
+    if (range.begin >= range.end) {
+        return 0;
+    }
+
+    size_t offset = static_cast<size_t>(range.begin) * 16 * sizeof(float);
+    size_t bytes = static_cast<size_t>(range.end - range.begin) * 16 * sizeof(float);
+    memcpy(static_cast<uint8_t*>(mapped) + offset, &worlds[static_cast<size_t>(range.begin) * 16], bytes);
+
+    range = {};
+    return bytes;
+}
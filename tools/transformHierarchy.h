@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// flattened scene transforms. nodes live in arrays in parents-first order, so one
+// linear pass propagates the whole hierarchy: no node pointers, no recursion, and
+// reading a world matrix is an index instead of a walk up the parent chain.
+//
+//  local   translation, rotation quaternion and scale in SoA arrays, composed four
+//          nodes per SSE instruction
+//  world   column major 4x4 per node, back to back, the same layout as a std430 mat4[]
+//  dirty   the setters mark a node, update() recomposes marked nodes and everything
+//          below them and leaves the rest alone
+//
+// writeWorlds() copies only the range a destination hasn't seen yet, with one range per
+// copy: Mesh keeps one node buffer per frame in flight, and the vertex shaders read a
+// surface's world out of it.
+//
+// plain floats so bench/ can build it without glm. scalar fallback without SSE2.
+
+class TransformHierarchy {
+public:
+    static constexpr uint32_t noParent { UINT32_MAX };
+
+    explicit TransformHierarchy(uint32_t _gpuCopies = 1);
+
+    // for a hierarchy built before its destinations existed, every copy starts out missing
+    // every world
+    void setGpuCopies(uint32_t copies);
+
+    void reserve(uint32_t count);
+    void clear();
+
+    // the parent has to be added first, that's what keeps the arrays topologically sorted.
+    // starts at identity and dirty
+    uint32_t add(uint32_t parent = noParent);
+
+    void setTranslation(uint32_t node, float x, float y, float z);
+    void setRotation(uint32_t node, float x, float y, float z, float w);     // unit quaternion
+    void setScale(uint32_t node, float x, float y, float z);
+
+    // recomposes every dirty node and its descendants, returns how many worlds changed
+    uint32_t update();
+
+    // column major, valid after update()
+    const float* world(uint32_t node) const { return &worlds[node * 16]; }
+    const float* worldData() const { return worlds.data(); }
+
+    uint32_t size() const { return count; }
+    uint32_t parent(uint32_t node) const { return parents[node]; }
+
+    // copies the worlds copy hasn't seen since its last write into mapped, a mat4 array for
+    // every node. returns the bytes written
+    size_t writeWorlds(uint32_t copy, void* mapped);
+
+private:
+    struct Range {
+        uint32_t begin { UINT32_MAX };
+        uint32_t end   { 0 };
+    };
+
+    void markDirty(uint32_t node) { dirty[node] = 1; }
+    void grow(uint32_t padded);
+    // local matrices of nodes base..base+3 as local[column * 3 + row][lane], the
+    // bottom row is always 0 0 0 1
+    void composeBlock(uint32_t base, float (*local)[4]) const;
+
+    uint32_t              count     { 0 };
+    uint32_t              gpuCopies { 1 };
+
+    // SoA, padded to a multiple of 4 with identity so the SIMD loop never needs a tail
+    std::vector<uint32_t> parents;
+    std::vector<float>    tx, ty, tz;
+    std::vector<float>    rx, ry, rz, rw;
+    std::vector<float>    sx, sy, sz;
+    std::vector<uint8_t>  dirty;
+
+    std::vector<float>    worlds;
+    std::vector<Range>    pending;    // per GPU copy
+};
@@ -11,6 +11,8 @@
 
 
 
+class PipelineCache;
+
 struct DescriptorLayout {
     std::vector<VkDescriptorSetLayoutBinding> bindings;
 
@@ -76,8 +78,11 @@ private:
 struct QueueFamilyIndices {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    uint32_t transferFamily;
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue = false;
+    // a family without graphics that can copy, i.e. the DMA engine (or async compute at worst)
+    bool transferFamilyHasValue = false;
     bool isComplete() const { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -99,7 +104,7 @@ struct PipelineBuilder {
 
     void clear();
 
-    VkPipeline buildPipeline(VkDevice device);
+    VkPipeline buildPipeline(VkDevice device, PipelineCache* cache = nullptr);
     void setShaders(VkShaderModule vertexShader, VkShaderModule fragmentShader);
     void setInputTopology(VkPrimitiveTopology topology);
     void setPolygonMode(VkPolygonMode mode);
@@ -164,15 +169,24 @@ struct DrawPushConstants {
     glm::vec2 padding2;
 };
 
+// vec4s before the address so the c++ layout matches std430 without manual padding
 struct MeshPushConstants {
     glm::mat4             worldMatrix;
+    glm::vec4             positionScale;  // packed vertices only, position = unorm16 * scale + offset
+    glm::vec4             positionOffset;
     VkDeviceAddress       vertexBuffer;
+    VkDeviceAddress       materialBuffer; // GpuMaterial[]
+    VkDeviceAddress       surfaceBuffer;  // GpuSurface[], what InstanceData::surface indexes
+    VkDeviceAddress       nodeBuffer;     // mat4 per model node, this frame's copy
 };
+// every device takes 128 bytes of push constants, not necessarily more
+static_assert(sizeof(MeshPushConstants) <= 128);
 
 struct MeshBuffers {
     AllocatedBuffer indexBuffer;
     AllocatedBuffer vertexBuffer;
     VkDeviceAddress vertexBufferAddress;
+    VkIndexType     indexType;
 };
 
 struct Texture {
@@ -198,8 +212,6 @@ struct Material {
     bool doubleSided = false;
     std::string alphaMode = "OPAQUE";
     float alphaCutoff = 0.5f;
-
-    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 };
 
 struct TextureResources {
@@ -240,6 +252,19 @@ struct Vertex {
     }
 };
 
+// 16 byte vertex decoded in meshPacked.vert. position is unorm16 across the mesh bounds,
+// normal is octahedral snorm16x2, uv is half2. color is dropped, it was always white.
+struct PackedVertex {
+    uint16_t position[4]; // w unused
+    uint32_t normal;
+    uint32_t uv;
+};
+
+enum class VertexFormat {
+    Full,
+    Packed,
+};
+
 struct SimpleMaterial {
     std::string name;
     glm::vec3 ambient;
@@ -248,11 +273,21 @@ struct SimpleMaterial {
     float shininess;
 };
 
+// one draw range of a loaded model: a glTF primitive under one node, or the whole obj
+struct MeshSurface {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t  materialIndex;     // into the model's materials, -1 without one
+    uint32_t node;              // in the model's hierarchy, the vertex shader applies its world
+};
+
 struct ObjMeshData {
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
     std::vector<SimpleMaterial> materials;
     std::vector<uint32_t> materialIds;
+    // empty means one surface over all of indices
+    std::vector<MeshSurface> surfaces;
 
 };
 
@@ -273,9 +308,47 @@ struct FrameTimings {
     float total;
 };
 
+// std430 rounds the struct up to 32 bytes in cull.comp.glsl, the padding keeps both sides the same
 struct InstanceData {
     glm::vec3 position;
-    float scale;
+    float     scale;
+    uint32_t  surface;          // into the MaterialTable's surfaces
+    uint32_t  pad[3];
+};
+
+// one MaterialTable entry as the shaders see it, 32 bytes in std430
+struct GpuMaterial {
+    glm::vec4 baseColorFactor;
+    uint32_t  baseColorTexture;   // slot in the bindless texture table, noTexture samples white
+    uint32_t  pad;
+    float     alphaCutoff;
+    uint32_t  flags;              // GpuMaterialFlags
+};
+
+// a model surface as the shaders see it
+struct GpuSurface {
+    uint32_t material;            // GpuMaterial
+    uint32_t node;
+    uint32_t bucket;              // binning bucket, one indirect draw each
+    uint32_t pad;
+};
+
+// the index range a bucket's draw covers, binScan copies it into the command
+struct GpuBucket {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+enum GpuMaterialFlags : uint32_t {
+    MaterialDoubleSided = 1u << 0,
+    MaterialAlphaMask   = 1u << 1,
+    MaterialAlphaBlend  = 1u << 2,
+};
+
+// push constants of the cull, binScan and binScatter passes
+struct BinningPushConstants {
+    uint32_t instanceCount;
+    uint32_t bucketCount;
 };
 
 struct CullData{
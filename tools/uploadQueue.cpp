@@ -0,0 +1,192 @@
+#include "uploadQueue.h"
+#include "inits.h"
+#include "settings.h"
+#include "trace.h"
+#include "utils.h"
+
+#include <vector>
+
+void UploadQueue::init(VkDevice _device, VmaAllocator allocator, MemoryTelemetry* telemetry, uint32_t queueFamily,
+                       VkQueue _queue, std::mutex* _queueMutex) {
+    device = _device;
+    queue = _queue;
+    queueMutex = _queueMutex;
+
+    VkSemaphoreTypeCreateInfo timelineInfo { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    semaphoreInfo.pNext = &timelineInfo;
+    VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline));
+
+    VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    cmdPoolInfo.queueFamilyIndex = queueFamily;
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    VK_CHECK(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
+
+    for (Batch& batch : batches) {
+        VkCommandBufferAllocateInfo cmdBufferAllocInfo { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        cmdBufferAllocInfo.commandPool = commandPool;
+        cmdBufferAllocInfo.commandBufferCount = 1;
+        cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        VK_CHECK(vkAllocateCommandBuffers(device, &cmdBufferAllocInfo, &batch.cmd));
+        batch.timelineValue = 0;
+    }
+
+    VkDeviceSize ringSize = static_cast<VkDeviceSize>(envNumber("IDK_STAGING_MB", 64.0)) << 20;
+    staging.init(device, allocator, telemetry, timeline, ringSize, "upload staging ring");
+
+    enqueuedCount = flushTarget = submittedCount = submittedValue = 0;
+    stopping = false;
+    thread = std::thread(&UploadQueue::threadMain, this);
+}
+
+void UploadQueue::shutdown() {
+    if (!thread.joinable()) {
+        return;
+    }
+
+    wait(flush());
+
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    flushRequested.notify_one();
+    thread.join();
+
+    for (Batch& batch : batches) {
+        retire(batch);
+    }
+    staging.destroy();
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroySemaphore(device, timeline, nullptr);
+}
+
+StagingSlice UploadQueue::allocateStaging(VkDeviceSize size, VkDeviceSize alignment) {
+    StagingSlice slice;
+    if (staging.tryAllocate(size, alignment, slice)) {
+        return slice;
+    }
+
+    // the ring is full of copies nobody has flushed yet, push them out and try again
+    flush();
+    if (staging.tryAllocate(size, alignment, slice)) {
+        return slice;
+    }
+    return staging.allocateDedicated(size);
+}
+
+void UploadQueue::enqueue(std::function<void(VkCommandBuffer)>&& record, StagingSlice slice,
+                          std::function<void()>&& retired) {
+    std::lock_guard lock(mutex);
+    pending.push_back({ std::move(record), slice, std::move(retired) });
+    enqueuedCount++;
+}
+
+uint64_t UploadQueue::flush() {
+    std::unique_lock lock(mutex);
+    uint64_t target = enqueuedCount;
+    if (target > flushTarget) {
+        flushTarget = target;
+        flushRequested.notify_one();
+    }
+    batchSubmitted.wait(lock, [&] { return submittedCount >= target; });
+    return submittedValue;
+}
+
+void UploadQueue::wait(uint64_t value) {
+    if (value == 0) {
+        return;
+    }
+
+    TRACE_ZONE("upload wait");
+    VkSemaphoreWaitInfo waitInfo { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline;
+    waitInfo.pValues = &value;
+    VK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+}
+
+bool UploadQueue::isComplete(uint64_t value) const {
+    uint64_t completed = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, timeline, &completed));
+    return completed >= value;
+}
+
+void UploadQueue::submitAndWait(std::function<void(VkCommandBuffer)>&& record) {
+    // flush() doesn't return before record has run, so by-reference captures are fine here
+    enqueue(std::move(record));
+    wait(flush());
+}
+
+void UploadQueue::retire(Batch& batch) {
+    for (auto& retired : batch.retired) {
+        retired();
+    }
+    batch.retired.clear();
+}
+
+void UploadQueue::threadMain() {
+    trace::setThreadName("upload");
+
+    std::vector<Request> requests;
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            flushRequested.wait(lock, [&] { return stopping || flushTarget > submittedCount; });
+            if (pending.empty()) {
+                return;
+            }
+            requests.assign(std::make_move_iterator(pending.begin()), std::make_move_iterator(pending.end()));
+            pending.clear();
+        }
+
+        TRACE_ZONE("upload batch");
+
+        // the oldest command buffer comes back once its batch has retired
+        Batch& batch = batches[nextBatch];
+        nextBatch = (nextBatch + 1) % batchCount;
+        wait(batch.timelineValue);
+        retire(batch);
+
+        VK_CHECK(vkResetCommandBuffer(batch.cmd, 0));
+
+        VkCommandBufferBeginInfo cmdBeginInfo = commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        VK_CHECK(vkBeginCommandBuffer(batch.cmd, &cmdBeginInfo));
+
+        for (Request& request : requests) {
+            request.record(batch.cmd);
+        }
+
+        VK_CHECK(vkEndCommandBuffer(batch.cmd));
+
+        // only this thread signals, so the next value is known before the submit
+        batch.timelineValue = submittedValue + 1;
+
+        VkSemaphoreSubmitInfo signalInfo = semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, timeline);
+        signalInfo.value = batch.timelineValue;
+        VkCommandBufferSubmitInfo cmdInfo = submitCommandBufferInfo(batch.cmd);
+        VkSubmitInfo2 submit = createSubmitInfo(&cmdInfo, &signalInfo, nullptr);
+        {
+            std::lock_guard lock(*queueMutex);
+            VK_CHECK(vkQueueSubmit2(queue, 1, &submit, VK_NULL_HANDLE));
+        }
+
+        for (Request& request : requests) {
+            staging.release(request.staging, batch.timelineValue);
+            if (request.retired) {
+                batch.retired.push_back(std::move(request.retired));
+            }
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            submittedCount += requests.size();
+            submittedValue = batch.timelineValue;
+        }
+        batchSubmitted.notify_all();
+        requests.clear();
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "memoryTelemetry.h"
+#include "stagingRing.h"
+
+// every upload goes through one thread that owns the command pool and the staging
+// ring, so loaders on any job thread can upload without their own vulkan objects.
+//
+// enqueue() only queues the recording. everything queued goes out as one command
+// buffer and one submit the next time someone flush()es, and the submit signals a
+// timeline value that wait() blocks on and the staging ring recycles against.
+//
+// IDK_STAGING_MB sets the ring size (default 64).
+class UploadQueue {
+public:
+    // queueMutex guards the VkQueue against the other threads submitting to it
+    void init(VkDevice _device, VmaAllocator allocator, MemoryTelemetry* telemetry, uint32_t queueFamily,
+              VkQueue _queue, std::mutex* _queueMutex);
+    void shutdown();
+
+    // mapped scratch for one enqueue(), returned to the ring with the batch that reads it
+    StagingSlice allocateStaging(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+    // record runs on the upload thread later, so it can't capture locals by reference.
+    // retired runs on the upload thread too, some time after the GPU is done with the batch
+    void enqueue(std::function<void(VkCommandBuffer)>&& record, StagingSlice staging = {},
+                 std::function<void()>&& retired = {});
+
+    // submits everything enqueued so far, returns the timeline value that covers it
+    uint64_t flush();
+    void wait(uint64_t value);
+    // doesn't block, for callers that poll once a frame
+    bool isComplete(uint64_t value) const;
+
+    // blocks until the GPU has executed whatever record() put in the command buffer
+    void submitAndWait(std::function<void(VkCommandBuffer)>&& record);
+
+private:
+    struct Request {
+        std::function<void(VkCommandBuffer)> record;
+        StagingSlice                         staging;
+        std::function<void()>                retired;
+    };
+
+    struct Batch {
+        VkCommandBuffer                    cmd           { VK_NULL_HANDLE };
+        uint64_t                           timelineValue { 0 };
+        std::vector<std::function<void()>> retired;
+    };
+
+    static constexpr uint32_t batchCount { 3 };
+
+    void threadMain();
+    void retire(Batch& batch);
+
+    VkDevice                device             { VK_NULL_HANDLE };
+    VkQueue                 queue              { VK_NULL_HANDLE };
+    std::mutex*             queueMutex         { nullptr };
+    VkCommandPool           commandPool        { VK_NULL_HANDLE };
+    Batch                   batches[batchCount];
+    uint32_t                nextBatch          { 0 };
+    VkSemaphore             timeline           { VK_NULL_HANDLE };
+    StagingRing             staging;
+
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable flushRequested;
+    std::condition_variable batchSubmitted;
+    std::deque<Request>     pending;
+    uint64_t                enqueuedCount      { 0 };
+    uint64_t                flushTarget        { 0 };
+    uint64_t                submittedCount     { 0 };
+    uint64_t                submittedValue     { 0 };
+    bool                    stopping           { false };
+};
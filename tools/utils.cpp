@@ -1,5 +1,7 @@
 #include "utils.h"
 #include "inits.h"
+#include "pipelineCache.h"
+#include "startupProfiler.h"
 
 VkSemaphore createSemaphore(VkDevice device, VkSemaphoreCreateFlags flags) {
     VkSemaphoreCreateInfo createInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
@@ -329,7 +331,7 @@ void PipelineBuilder::clear() {
     shaderStages.clear();
 }
 
-VkPipeline PipelineBuilder::buildPipeline(VkDevice device) {
+VkPipeline PipelineBuilder::buildPipeline(VkDevice device, PipelineCache* cache) {
     VkPipelineViewportStateCreateInfo viewportState = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
     viewportState.pNext = nullptr;
     viewportState.viewportCount = 1;
@@ -364,10 +366,18 @@ VkPipeline PipelineBuilder::buildPipeline(VkDevice device) {
 
     graphicsPipelineInfo.pDynamicState = &dynamicInfo;
 
+    startup::PipelineFeedback feedback;
+    graphicsPipelineInfo.pNext = feedback.chain(&renderInfo, graphicsPipelineInfo.stageCount);
+
     VkPipeline newPipeline;
 
-    VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &graphicsPipelineInfo,
+    uint64_t startNs = trace::nowNs();
+    VK_CHECK(vkCreateGraphicsPipelines(device, cache ? cache->handle() : VK_NULL_HANDLE, 1, &graphicsPipelineInfo,
             nullptr, &newPipeline));
+    startup::recordPipeline("vkCreateGraphicsPipelines", feedback, startNs, trace::nowNs());
+    if (cache) {
+        cache->record(feedback.pipeline);
+    }
 
     return newPipeline;
 
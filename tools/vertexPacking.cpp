@@ -0,0 +1,77 @@
+#include "vertexPacking.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <glm/gtc/packing.hpp>
+
+MeshBounds computeBounds(std::span<const Vertex> vertices) {
+    MeshBounds bounds { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+    for (const Vertex& vertex : vertices) {
+        bounds.min = glm::min(bounds.min, vertex.position);
+        bounds.max = glm::max(bounds.max, vertex.position);
+    }
+    if (vertices.empty()) {
+        bounds = { glm::vec3(0.0f), glm::vec3(0.0f) };
+    }
+    return bounds;
+}
+
+glm::vec4 quantizationScale(const MeshBounds& bounds) {
+    return glm::vec4(bounds.max - bounds.min, 0.0f);
+}
+
+glm::vec4 quantizationOffset(const MeshBounds& bounds) {
+    return glm::vec4(bounds.min, 0.0f);
+}
+
+// octahedral mapping, see "A Survey of Efficient Representations for Independent Unit Vectors"
+static glm::vec2 octEncode(glm::vec3 n) {
+    n /= std::max(std::abs(n.x) + std::abs(n.y) + std::abs(n.z), 1e-20f);
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f) {
+        glm::vec2 sign(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+        p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+    }
+    return p;
+}
+
+std::vector<PackedVertex> packVertices(std::span<const Vertex> vertices, const MeshBounds& bounds) {
+    glm::vec3 extent = bounds.max - bounds.min;
+    // flat axes (a plane, a single point) would divide by zero
+    glm::vec3 invExtent(
+        extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+        extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+        extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+    std::vector<PackedVertex> packed(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex& vertex = vertices[i];
+        PackedVertex& out = packed[i];
+
+        glm::vec3 unit = glm::clamp((vertex.position - bounds.min) * invExtent, 0.0f, 1.0f);
+        for (int axis = 0; axis < 3; axis++) {
+            out.position[axis] = static_cast<uint16_t>(unit[axis] * 65535.0f + 0.5f);
+        }
+        out.position[3] = 0;
+
+        out.normal = glm::packSnorm2x16(octEncode(vertex.normal));
+        out.uv = glm::packHalf2x16(glm::vec2(vertex.uv_x, vertex.uv_y));
+    }
+    return packed;
+}
+
+VkIndexType chooseIndexType(size_t vertexCount) {
+    return vertexCount <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+uint32_t indexTypeSize(VkIndexType type) {
+    return type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+std::vector<uint16_t> narrowIndices(std::span<const uint32_t> indices) {
+    std::vector<uint16_t> narrow(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+        narrow[i] = static_cast<uint16_t>(indices[i]);
+    }
+    return narrow;
+}
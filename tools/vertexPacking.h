@@ -0,0 +1,24 @@
+#pragma once
+#include <span>
+#include <vector>
+
+#include "types.h"
+
+struct MeshBounds {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+MeshBounds computeBounds(std::span<const Vertex> vertices);
+
+// scale/offset that turn a unorm16 position back into object space
+glm::vec4 quantizationScale(const MeshBounds& bounds);
+glm::vec4 quantizationOffset(const MeshBounds& bounds);
+
+std::vector<PackedVertex> packVertices(std::span<const Vertex> vertices, const MeshBounds& bounds);
+
+// uint16 whenever every vertex is addressable with it. primitive restart is never
+// enabled, so 0xffff is an ordinary index and 65536 vertices still fit
+VkIndexType chooseIndexType(size_t vertexCount);
+uint32_t indexTypeSize(VkIndexType type);
+std::vector<uint16_t> narrowIndices(std::span<const uint32_t> indices);
@@ -0,0 +1,271 @@
+#include "vfs.h"
+#include "hash.h"
+#include "lz4.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+
+AssetPack   mounted;
+ParallelFor parallelFor;
+
+void forChunks(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& function) {
+    if (count > 1 && parallelFor) {
+        parallelFor(count, function);
+    } else if (count > 0) {
+        function(0, count);
+    }
+}
+
+}
+
+bool AssetPack::open(const char* path) {
+    close();
+
+    if (!file.open(path)) {
+        return false;
+    }
+
+    auto fail = [&](const char* reason) {
+        std::cerr << "Ignoring pack " << path << ": " << reason << std::endl;
+        close();
+        return false;
+    };
+
+    if (file.size() < sizeof(PackHeader)) {
+        return fail("too small");
+    }
+    memcpy(&header, file.data(), sizeof(PackHeader));
+    if (header.magic != magic || header.version != version) {
+        return fail("wrong magic or version");
+    }
+
+    uint64_t fileSize = file.size();
+    bool slotsValid = header.slotCount > 0 && (header.slotCount & (header.slotCount - 1)) == 0 &&
+                      header.slotCount > header.entryCount;
+    if (!slotsValid ||
+        header.entriesOffset + uint64_t(header.entryCount) * sizeof(PackEntry) > fileSize ||
+        header.slotsOffset + uint64_t(header.slotCount) * sizeof(uint32_t) > fileSize ||
+        header.namesOffset + header.namesSize > fileSize ||
+        header.entriesOffset % alignof(PackEntry) != 0 || header.slotsOffset % alignof(uint32_t) != 0) {
+        return fail("table of contents out of bounds");
+    }
+
+    entries = reinterpret_cast<const PackEntry*>(file.data() + header.entriesOffset);
+    slots = reinterpret_cast<const uint32_t*>(file.data() + header.slotsOffset);
+    names = reinterpret_cast<const char*>(file.data() + header.namesOffset);
+
+    // once here so find() and contents() never have to
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        const PackEntry& e = entries[i];
+        if (e.offset + e.storedSize > fileSize || uint64_t(e.nameOffset) + e.nameLength > header.namesSize) {
+            return fail("entry out of bounds");
+        }
+
+        // the chunk table itself is checked chunk by chunk in readChunk
+        bool valid = false;
+        if (e.compression == uint32_t(PackCompression::None)) {
+            valid = e.storedSize == e.size && e.chunkCount == 0;
+        } else if (e.compression == uint32_t(PackCompression::LZ4)) {
+            valid = e.chunkCount == (e.size + chunkSize - 1) / chunkSize &&
+                    uint64_t(e.chunkCount) * sizeof(uint32_t) <= e.storedSize && e.offset % alignof(uint32_t) == 0;
+        }
+        if (!valid) {
+            return fail("bad entry compression");
+        }
+    }
+    for (uint32_t i = 0; i < header.slotCount; i++) {
+        if (slots[i] != emptySlot && slots[i] >= header.entryCount) {
+            return fail("slot out of bounds");
+        }
+    }
+    return true;
+}
+
+void AssetPack::close() {
+    file.close();
+    header = {};
+    entries = nullptr;
+    slots = nullptr;
+    names = nullptr;
+}
+
+const PackEntry* AssetPack::find(std::string_view path) const {
+    if (!isOpen()) {
+        return nullptr;
+    }
+
+    uint64_t pathHash = hash64(path.data(), path.size());
+    uint32_t mask = header.slotCount - 1;
+
+    // at most half full, so there's always an empty slot to stop at
+    for (uint32_t slot = static_cast<uint32_t>(pathHash) & mask;; slot = (slot + 1) & mask) {
+        uint32_t index = slots[slot];
+        if (index == emptySlot) {
+            return nullptr;
+        }
+        const PackEntry& e = entries[index];
+        if (e.pathHash == pathHash && name(e) == path) {
+            return &e;
+        }
+    }
+}
+
+bool AssetPack::readChunk(const PackEntry& entry, uint32_t chunk, uint8_t* dst) const {
+    const uint8_t* stored = file.data() + entry.offset;
+    const auto* ends = reinterpret_cast<const uint32_t*>(stored);
+    const uint8_t* payload = stored + size_t(entry.chunkCount) * sizeof(uint32_t);
+    uint64_t payloadSize = entry.storedSize - uint64_t(entry.chunkCount) * sizeof(uint32_t);
+
+    uint64_t begin = chunk == 0 ? 0 : ends[chunk - 1];
+    uint64_t end = ends[chunk];
+    if (begin > end || end > payloadSize) {
+        return false;
+    }
+
+    // idkpack only keeps a compressed chunk if it came out smaller
+    size_t rawSize = static_cast<size_t>(std::min(chunkSize, entry.size - uint64_t(chunk) * chunkSize));
+    if (end - begin == rawSize) {
+        memcpy(dst, payload + begin, rawSize);
+        return true;
+    }
+    return lz4Decompress(payload + begin, static_cast<size_t>(end - begin), dst, rawSize);
+}
+
+std::string_view AssetPack::name(const PackEntry& entry) const {
+    return { names + entry.nameOffset, entry.nameLength };
+}
+
+AssetFile::AssetFile(AssetFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+AssetFile& AssetFile::operator=(AssetFile&& other) noexcept {
+    if (this != &other) {
+        // moving the vector keeps its buffer, so view stays valid
+        loose = std::move(other.loose);
+        entry = other.entry;
+        decompressed = std::move(other.decompressed);
+        view = other.view;
+        length = other.length;
+        opened = other.opened;
+        other.close();
+    }
+    return *this;
+}
+
+bool AssetFile::open(const char* path, bool decompress) {
+    close();
+
+    if (mounted.isOpen()) {
+        if (const PackEntry* found = mounted.find(vfs::normalize(path))) {
+            entry = found;
+            length = found->size;
+            opened = true;
+
+            if (!isCompressed()) {
+                view = mounted.contents(*found);
+            } else if (decompress) {
+                decompressed.resize(length);
+                if (!readInto(decompressed.data(), 0, length)) {
+                    std::cerr << "Pack entry " << path << " is corrupt" << std::endl;
+                    close();
+                    return false;
+                }
+                view = decompressed;
+            }
+            return true;
+        }
+    }
+
+    if (!loose.open(path)) {
+        return false;
+    }
+    view = loose.span();
+    length = view.size();
+    opened = true;
+    return true;
+}
+
+void AssetFile::close() {
+    loose.close();
+    entry = nullptr;
+    decompressed.clear();
+    decompressed.shrink_to_fit();
+    view = {};
+    length = 0;
+    opened = false;
+}
+
+bool AssetFile::readInto(void* dst, size_t offset, size_t count) const {
+    if (offset > length || count > length - offset) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    // chunk sized pieces even for plain copies, the page faults on a cold mapping overlap that way
+    constexpr uint64_t chunkSize = AssetPack::chunkSize;
+    uint32_t firstChunk = static_cast<uint32_t>(offset / chunkSize);
+    uint32_t endChunk = static_cast<uint32_t>((offset + count + chunkSize - 1) / chunkSize);
+    bool fromView = !view.empty();
+
+    std::atomic<bool> valid { true };
+    forChunks(endChunk - firstChunk, [&](uint32_t begin, uint32_t end) {
+        std::vector<uint8_t> partial;
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t chunk = firstChunk + i;
+            uint64_t chunkBegin = uint64_t(chunk) * chunkSize;
+            uint64_t chunkEnd = std::min<uint64_t>(chunkBegin + chunkSize, length);
+            uint64_t copyBegin = std::max<uint64_t>(chunkBegin, offset);
+            uint64_t copyEnd = std::min<uint64_t>(chunkEnd, offset + count);
+            uint8_t* target = static_cast<uint8_t*>(dst) + (copyBegin - offset);
+
+            if (fromView) {
+                memcpy(target, view.data() + copyBegin, static_cast<size_t>(copyEnd - copyBegin));
+            } else if (copyBegin == chunkBegin && copyEnd == chunkEnd) {
+                if (!mounted.readChunk(*entry, chunk, target)) {
+                    valid = false;
+                }
+            } else {
+                // a chunk the range only covers part of goes through a scratch buffer
+                partial.resize(static_cast<size_t>(chunkEnd - chunkBegin));
+                if (!mounted.readChunk(*entry, chunk, partial.data())) {
+                    valid = false;
+                    continue;
+                }
+                memcpy(target, partial.data() + (copyBegin - chunkBegin), static_cast<size_t>(copyEnd - copyBegin));
+            }
+        }
+    });
+    return valid;
+}
+
+bool vfs::mount(const char* packPath) {
+    if (!mounted.open(packPath)) {
+        return false;
+    }
+    std::cout << "Mounted " << packPath << ": " << mounted.size() << " assets" << std::endl;
+    return true;
+}
+
+void vfs::unmount() {
+    mounted.close();
+}
+
+void vfs::setParallelFor(ParallelFor parallel) {
+    parallelFor = std::move(parallel);
+}
+
+const AssetPack& vfs::pack() {
+    return mounted;
+}
+
+std::string vfs::normalize(const char* path) {
+    return std::filesystem::path(path).lexically_normal().generic_string();
+}
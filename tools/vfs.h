@@ -0,0 +1,150 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "files.h"
+#include "jobSystem.h"
+
+// asset reads go through here. a mounted pack (one file written by idkpack, one mmap)
+// answers first, anything it doesn't have comes from the loose file on disk, so a
+// development tree works without a pack and a shipped build is the exe plus idk.pak.
+//
+// pack layout, little endian:
+//
+//   PackHeader
+//   entry data       every entry 16 byte aligned, so SPIR-V and vertex data can be used in place
+//   PackEntry[]      entryCount
+//   uint32_t[]       slotCount, open addressed on the path hash: entry index or emptySlot
+//   names            the normalized paths back to back, not terminated
+//
+// paths are keyed the way the engine asks for them, lexically normalized with forward
+// slashes ("../assets/barrel/Barrel.obj"). a lookup is one hash plus a probe or two
+// and returns a view into the mapping, nothing is read or copied.
+//
+// entries can also be LZ4 compressed (idkpack -c), for when the disk is slower than
+// decompressing. those are cut into chunkSize pieces compressed on their own:
+//
+//   uint32_t[]       chunkCount, where each chunk's data ends, counted from the end of this table
+//   chunk data       LZ4 blocks, or the raw bytes for a chunk that didn't get smaller
+//
+// so the chunks decompress in parallel, and AssetFile::readInto puts them straight into
+// the destination (staging memory, say) without a heap copy in between.
+
+struct PackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t slotCount;         // power of two, at least twice entryCount
+    uint64_t entriesOffset;
+    uint64_t slotsOffset;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+};
+
+enum class PackCompression : uint32_t {
+    None = 0,
+    LZ4  = 1,
+};
+
+struct PackEntry {
+    uint64_t pathHash;
+    uint64_t offset;
+    uint64_t size;              // of the asset, decompressed
+    uint64_t storedSize;        // in the pack
+    uint32_t nameOffset;        // into names
+    uint32_t nameLength;
+    uint32_t compression;       // PackCompression
+    uint32_t chunkCount;        // 0 when not compressed
+};
+
+class AssetPack {
+public:
+    static constexpr uint32_t magic     { 0x504B4449 };  // "IDKP"
+    static constexpr uint32_t version   { 2 };
+    static constexpr uint32_t emptySlot { UINT32_MAX };
+    static constexpr uint64_t alignment { 16 };
+    static constexpr uint64_t chunkSize { 256 * 1024 };
+
+    // maps the pack and checks the table of contents against its size
+    bool open(const char* path);
+    void close();
+
+    bool isOpen() const { return file.isOpen(); }
+    uint32_t size() const { return header.entryCount; }
+
+    // path has to be normalized already, see vfs::normalize
+    const PackEntry* find(std::string_view path) const;
+
+    // the stored bytes, only the asset itself for uncompressed entries
+    std::span<const uint8_t> contents(const PackEntry& entry) const { return { file.data() + entry.offset, entry.storedSize }; }
+
+    // decompresses chunk into dst, which takes the whole chunk. false if it's corrupt
+    bool readChunk(const PackEntry& entry, uint32_t chunk, uint8_t* dst) const;
+
+    std::string_view name(const PackEntry& entry) const;
+    const PackEntry& entry(uint32_t index) const { return entries[index]; }
+
+private:
+    MappedFile       file;
+    PackHeader       header {};
+    const PackEntry* entries { nullptr };
+    const uint32_t*  slots   { nullptr };
+    const char*      names   { nullptr };
+};
+
+// MappedFile's interface, but the bytes are either a view into the mounted pack or
+// a mapping of the loose file. compressed entries are decompressed into memory the
+// AssetFile owns, unless it's opened with decompress false, then data() stays null
+// and readInto() is the way to the bytes
+class AssetFile {
+public:
+    AssetFile() = default;
+
+    AssetFile(AssetFile&& other) noexcept;
+    AssetFile& operator=(AssetFile&& other) noexcept;
+    AssetFile(const AssetFile&) = delete;
+    AssetFile& operator=(const AssetFile&) = delete;
+
+    bool open(const char* path, bool decompress = true);
+    void close();
+
+    const uint8_t* data() const { return view.data(); }
+    size_t         size() const { return length; }
+    bool           isOpen() const { return opened; }
+    bool           isPacked() const { return entry != nullptr; }
+    bool           isCompressed() const { return entry && entry->compression != uint32_t(PackCompression::None); }
+
+    std::span<const uint8_t> span() const { return view; }
+
+    // copies (decompressing where it has to) [offset, offset + count) of the asset to dst,
+    // chunks in parallel. false if the range is out of bounds or the data is corrupt
+    bool readInto(void* dst, size_t offset, size_t count) const;
+
+private:
+    MappedFile               loose;
+    const PackEntry*         entry { nullptr };
+    std::vector<uint8_t>     decompressed;
+    std::span<const uint8_t> view;
+    size_t                   length { 0 };
+    bool                     opened { false };
+};
+
+namespace vfs {
+    // before anything opens an AssetFile, lookups don't lock. false if the pack
+    // isn't there or isn't valid, loose files keep working either way
+    bool mount(const char* packPath);
+    void unmount();
+
+    // what readInto() and decompressing opens spread their chunks with, serial without one
+    void setParallelFor(ParallelFor parallel);
+
+    const AssetPack& pack();
+
+    // the key a path is stored under
+    std::string normalize(const char* path);
+}
@@ -0,0 +1,556 @@
+#include "virtualTexture.h"
+#include "hash.h"
+#include "imageMips.h"
+#include "inits.h"
+#include "settings.h"
+#include "trace.h"
+#include "vfs.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t tileMagic = 0x58545649;   // "IVTX"
+constexpr uint32_t tileVersion = 1;
+constexpr size_t pageBytes = size_t(VirtualTextures::slotSize) * VirtualTextures::slotSize * 4;
+
+// followed by every page of every mip in page table order, mip 0 first, rows top down
+struct TileFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+    uint32_t pageCount;
+    uint32_t pad[6];
+};
+static_assert(sizeof(TileFileHeader) == 64);
+
+uint32_t pagesAcross(uint32_t size, uint32_t mip) {
+    return (std::max(size >> mip, 1u) + VirtualTextures::pageSize - 1) / VirtualTextures::pageSize;
+}
+
+// stops at the first mip that fits in one page, that one gets pinned
+uint32_t tiledMipCount(uint32_t width, uint32_t height) {
+    uint32_t mip = 0;
+    while (pagesAcross(width, mip) * pagesAcross(height, mip) > 1) {
+        mip++;
+    }
+    return mip + 1;
+}
+
+uint32_t wrap(int32_t value, uint32_t size) {
+    int32_t wrapped = value % static_cast<int32_t>(size);
+    return static_cast<uint32_t>(wrapped < 0 ? wrapped + static_cast<int32_t>(size) : wrapped);
+}
+
+}
+
+void VirtualTextures::init(VkDevice _device, VmaAllocator _allocator, MemoryTelemetry* _telemetry, JobSystem* _jobs,
+                           UploadQueue* _uploads) {
+    device = _device;
+    allocator = _allocator;
+    telemetry = _telemetry;
+    jobs = _jobs;
+    uploads = _uploads;
+
+    atlasSlots = std::clamp(static_cast<uint32_t>(envNumber("IDK_VT_ATLAS_SLOTS", 16.0)), 2u, 64u);
+    pageBudget = std::max(static_cast<uint32_t>(envNumber("IDK_VT_PAGE_BUDGET", 64.0)), 1u);
+
+    slots.assign(atlasSlots * atlasSlots, Slot {});
+    freeSlots.clear();
+    for (uint32_t i = static_cast<uint32_t>(slots.size()); i-- > 0;) {
+        freeSlots.push_back(i);
+    }
+
+    uint32_t atlasSize = atlasSlots * slotSize;
+    VkImageCreateInfo imageInfo = imageCreateInfo(VK_FORMAT_R8G8B8A8_SRGB,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, { atlasSize, atlasSize, 1 });
+
+    VmaAllocationCreateInfo imageAllocInfo = {};
+    imageAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    imageAllocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK(vmaCreateImage(allocator, &imageInfo, &imageAllocInfo, &atlas.image, &atlas.allocation, nullptr));
+    telemetry->track(atlas.allocation, MemoryCategory::Texture, "virtual texture atlas");
+    atlas.imageExtent = imageInfo.extent;
+    atlas.imageFormat = imageInfo.format;
+
+    VkImageViewCreateInfo viewInfo = imageviewCreateInfo(VK_FORMAT_R8G8B8A8_SRGB, atlas.image, VK_IMAGE_ASPECT_COLOR_BIT);
+    VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &atlas.imageView));
+
+    // pages carry their own border, so no wrapping and no mips in the atlas itself
+    VkSamplerCreateInfo samplerInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &atlasSampler));
+
+    stamps = createBuffer(sizeof(uint32_t) * maxEntries, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VMA_MEMORY_USAGE_GPU_ONLY, "virtual texture stamps");
+
+    for (uint32_t i = 0; i < MAX_FRAMES; i++) {
+        pageTables[i] = createBuffer(sizeof(PageTableHeader) + sizeof(uint32_t) * maxEntries,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, "virtual texture page table");
+        memset(pageTables[i].info.pMappedData, 0, sizeof(PageTableHeader));
+        vmaFlushAllocation(allocator, pageTables[i].allocation, 0, VK_WHOLE_SIZE);
+
+        feedback[i] = createBuffer(sizeof(FeedbackHeader) + sizeof(uint32_t) * feedbackCapacity,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, "virtual texture feedback");
+        FeedbackHeader header { 0, feedbackCapacity, {} };
+        memcpy(feedback[i].info.pMappedData, &header, sizeof(header));
+        vmaFlushAllocation(allocator, feedback[i].allocation, 0, VK_WHOLE_SIZE);
+        writtenVersion[i] = 0;
+    }
+
+    uploads->enqueue([image = atlas.image, stampBuffer = stamps.buffer](VkCommandBuffer cmd) {
+        vkCmdFillBuffer(cmd, stampBuffer, 0, VK_WHOLE_SIZE, 0);
+
+        VkMemoryBarrier2 fillBarrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+        fillBarrier.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT;
+        fillBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        fillBarrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+        fillBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+        VkImageMemoryBarrier2 imageBarrier { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+        imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+        imageBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = image;
+        imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        VkDependencyInfo dependency { VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+        dependency.memoryBarrierCount = 1;
+        dependency.pMemoryBarriers = &fillBarrier;
+        dependency.imageMemoryBarrierCount = 1;
+        dependency.pImageMemoryBarriers = &imageBarrier;
+        vkCmdPipelineBarrier2(cmd, &dependency);
+    });
+
+    std::cout << "Virtual texture atlas " << atlasSize << "x" << atlasSize << " (" << slots.size() << " pages)" << std::endl;
+}
+
+void VirtualTextures::shutdown() {
+    if (device == VK_NULL_HANDLE) {
+        return;
+    }
+
+    // loads still running would enqueue copies into an atlas that's gone
+    jobs->wait(work);
+    uploads->wait(uploads->flush());
+
+    std::cout << "Virtual textures: " << pagesLoaded << " pages loaded, " << pagesEvicted << " evicted" << std::endl;
+
+    for (uint32_t i = 0; i < MAX_FRAMES; i++) {
+        destroyBuffer(pageTables[i]);
+        destroyBuffer(feedback[i]);
+    }
+    destroyBuffer(stamps);
+
+    vkDestroySampler(device, atlasSampler, nullptr);
+    vkDestroyImageView(device, atlas.imageView, nullptr);
+    telemetry->untrack(atlas.allocation);
+    vmaDestroyImage(allocator, atlas.image, atlas.allocation);
+
+    textures.clear();
+    device = VK_NULL_HANDLE;
+}
+
+AllocatedBuffer VirtualTextures::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                              const char* name) {
+    VkBufferCreateInfo bufferInfo { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = memoryUsage;
+    if (memoryUsage != VMA_MEMORY_USAGE_GPU_ONLY) {
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    }
+
+    AllocatedBuffer buffer {};
+    VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer.buffer, &buffer.allocation, &buffer.info));
+    telemetry->track(buffer.allocation, MemoryCategory::Texture, name);
+    return buffer;
+}
+
+void VirtualTextures::destroyBuffer(AllocatedBuffer& buffer) {
+    telemetry->untrack(buffer.allocation);
+    vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+    buffer = {};
+}
+
+VirtualTextureId VirtualTextures::add(const char* path) {
+    VirtualTextureId id;
+    {
+        std::lock_guard lock(mutex);
+        if (textures.size() >= maxTextures) {
+            throw std::runtime_error("too many virtual textures");
+        }
+        id = static_cast<VirtualTextureId>(textures.size());
+        textures.emplace_back();
+        textures.back().path = path;
+    }
+
+    jobs->run(work, [this, id] {
+        cook(id);
+    });
+    return id;
+}
+
+void VirtualTextures::cook(VirtualTextureId id) {
+    TRACE_ZONE("vt cook");
+
+    std::string path;
+    {
+        std::lock_guard lock(mutex);
+        path = textures[id].path;
+    }
+
+    AssetFile source;
+    if (!source.open(path.c_str())) {
+        std::cerr << "failed to load virtual texture " << path << ": can't open file" << std::endl;
+        return;
+    }
+    uint64_t sourceHash = hash64(source.data(), source.size());
+
+    std::string cachePath = cacheFilePath(path.c_str(), "vtex");
+    MappedFile tiles;
+    TileFileHeader header {};
+    bool valid = false;
+    if (tiles.open(cachePath.c_str()) && tiles.size() >= sizeof(header)) {
+        memcpy(&header, tiles.data(), sizeof(header));
+        valid = header.magic == tileMagic && header.version == tileVersion && header.sourceHash == sourceHash &&
+                header.sourceSize == source.size() &&
+                tiles.size() == sizeof(header) + size_t(header.pageCount) * pageBytes;
+        if (!valid) {
+            std::cout << "Virtual texture cache " << cachePath << " is stale, recooking" << std::endl;
+        }
+    }
+
+    std::vector<uint8_t> cooked;
+    if (!valid) {
+        tiles.close();
+
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &width, &height,
+                                                &channels, STBI_rgb_alpha);
+        if (!pixels) {
+            std::cerr << "failed to load virtual texture " << path << ": " << stbi_failure_reason() << std::endl;
+            return;
+        }
+        std::vector<ImageLevel> mips = buildMipChain(pixels, width, height, true);
+        stbi_image_free(pixels);
+
+        header = {};
+        header.magic = tileMagic;
+        header.version = tileVersion;
+        header.sourceHash = sourceHash;
+        header.sourceSize = source.size();
+        header.width = width;
+        header.height = height;
+        header.mipCount = tiledMipCount(width, height);
+
+        struct PageSource {
+            uint32_t mip;
+            uint32_t x;
+            uint32_t y;
+        };
+        std::vector<PageSource> pageSources;
+        for (uint32_t mip = 0; mip < header.mipCount; mip++) {
+            for (uint32_t y = 0; y < pagesAcross(header.height, mip); y++) {
+                for (uint32_t x = 0; x < pagesAcross(header.width, mip); x++) {
+                    pageSources.push_back({ mip, x, y });
+                }
+            }
+        }
+        header.pageCount = static_cast<uint32_t>(pageSources.size());
+
+        cooked.resize(sizeof(header) + pageSources.size() * pageBytes);
+        memcpy(cooked.data(), &header, sizeof(header));
+
+        // borders wrap around, the mesh samples with repeat addressing
+        jobs->parallelFor(header.pageCount, 16, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                const PageSource& page = pageSources[i];
+                const ImageLevel& level = mips[page.mip];
+                uint8_t* out = cooked.data() + sizeof(header) + i * pageBytes;
+
+                for (uint32_t y = 0; y < slotSize; y++) {
+                    uint32_t sy = wrap(int32_t(page.y * pageSize + y) - int32_t(pageBorder), level.height);
+                    for (uint32_t x = 0; x < slotSize; x++) {
+                        uint32_t sx = wrap(int32_t(page.x * pageSize + x) - int32_t(pageBorder), level.width);
+                        memcpy(out + (y * slotSize + x) * 4, level.rgba.data() + (size_t(sy) * level.width + sx) * 4, 4);
+                    }
+                }
+            }
+        });
+
+        // without a cache file the pages stream out of memory instead
+        if (writeFileAtomic(cachePath, cooked) && tiles.open(cachePath.c_str())) {
+            std::cout << "Cooked " << path << " to " << cachePath << std::endl;
+            cooked.clear();
+            cooked.shrink_to_fit();
+        }
+    }
+
+    PageLoad pinned {};
+    {
+        std::lock_guard lock(mutex);
+        Texture& texture = textures[id];
+        texture.file = std::move(tiles);
+        texture.memory = std::move(cooked);
+        std::span<const uint8_t> bytes = texture.file.isOpen() ? texture.file.span() : std::span<const uint8_t>(texture.memory);
+        texture.pages = bytes.subspan(sizeof(header));
+        texture.width = header.width;
+        texture.height = header.height;
+        texture.pageCount = header.pageCount;
+
+        if (entries.size() + header.pageCount > maxEntries) {
+            std::cerr << "failed to load virtual texture " << path << ": page table is full" << std::endl;
+            return;
+        }
+
+        texture.firstEntry = static_cast<uint32_t>(entries.size());
+        for (uint32_t mip = 0; mip < header.mipCount; mip++) {
+            for (uint32_t y = 0; y < pagesAcross(header.height, mip); y++) {
+                for (uint32_t x = 0; x < pagesAcross(header.width, mip); x++) {
+                    entries.push_back(notResident);
+                    entryStates.push_back(PageState::Missing);
+                    entryKeys.push_back({ static_cast<uint16_t>(id), static_cast<uint8_t>(mip),
+                                          static_cast<uint16_t>(x), static_cast<uint16_t>(y) });
+                }
+            }
+        }
+
+        if (!allocateSlot(currentFrame, pinned.slot)) {
+            std::cerr << "failed to load virtual texture " << path << ": no atlas slot for its last mip" << std::endl;
+            return;
+        }
+        pinned.entry = texture.firstEntry + header.pageCount - 1;
+        slots[pinned.slot] = { pinned.entry, currentFrame, true, true };
+        entryStates[pinned.entry] = PageState::Loading;
+
+        // shaders only look at the texture once it has a mip count
+        texture.mipCount = header.mipCount;
+        tableVersion++;
+    }
+
+    loadPages({ pinned });
+}
+
+bool VirtualTextures::allocateSlot(uint64_t frameNumber, uint32_t& slot) {
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        return true;
+    }
+
+    // frames still in flight may be sampling anything they touched recently
+    uint32_t best = notResident;
+    for (uint32_t i = 0; i < slots.size(); i++) {
+        const Slot& candidate = slots[i];
+        if (candidate.pinned || candidate.loading || candidate.lastUsed + MAX_FRAMES >= frameNumber) {
+            continue;
+        }
+        if (best == notResident || candidate.lastUsed < slots[best].lastUsed) {
+            best = i;
+        }
+    }
+    if (best == notResident) {
+        return false;
+    }
+
+    Slot& victim = slots[best];
+    if (victim.entry != notResident) {
+        entries[victim.entry] = notResident;
+        entryStates[victim.entry] = PageState::Missing;
+        pagesEvicted++;
+        tableVersion++;
+    }
+    victim = {};
+    slot = best;
+    return true;
+}
+
+void VirtualTextures::loadPages(std::vector<PageLoad> pages) {
+    TRACE_ZONE("vt load pages");
+
+    StagingSlice staging = uploads->allocateStaging(pages.size() * pageBytes);
+    std::vector<VkBufferImageCopy> regions;
+    regions.reserve(pages.size());
+
+    for (size_t i = 0; i < pages.size(); i++) {
+        PageKey key;
+        const Texture* texture;
+        {
+            std::lock_guard lock(mutex);
+            key = entryKeys[pages[i].entry];
+            texture = &textures[key.texture];
+        }
+
+        // this is where the disk read happens, the tiles are mapped
+        size_t page = pages[i].entry - texture->firstEntry;
+        memcpy(staging.data + i * pageBytes, texture->pages.data() + page * pageBytes, pageBytes);
+
+        VkBufferImageCopy region {};
+        region.bufferOffset = staging.offset + i * pageBytes;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageOffset = { int32_t(pages[i].slot % atlasSlots * slotSize), int32_t(pages[i].slot / atlasSlots * slotSize), 0 };
+        region.imageExtent = { slotSize, slotSize, 1 };
+        regions.push_back(region);
+    }
+
+    uploads->enqueue([image = atlas.image, staging, regions = std::move(regions)](VkCommandBuffer cmd) {
+        // the wait on earlier fragment work covers frames still sampling a slot that just got recycled
+        VkImageMemoryBarrier2 barrier { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+        barrier.srcAccessMask = VK_ACCESS_2_NONE;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        VkDependencyInfo dependency { VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+        dependency.imageMemoryBarrierCount = 1;
+        dependency.pImageMemoryBarriers = &barrier;
+        vkCmdPipelineBarrier2(cmd, &dependency);
+
+        vkCmdCopyBufferToImage(cmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(regions.size()), regions.data());
+
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+        barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkCmdPipelineBarrier2(cmd, &dependency);
+    }, staging);
+
+    uint64_t value = uploads->flush();
+
+    std::lock_guard lock(mutex);
+    pagesLoaded += pages.size();
+    inFlight.push_back({ std::move(pages), value });
+}
+
+void VirtualTextures::retireLoads() {
+    auto done = std::partition(inFlight.begin(), inFlight.end(), [&](const Batch& batch) {
+        return !uploads->isComplete(batch.uploadValue);
+    });
+
+    for (auto it = done; it != inFlight.end(); ++it) {
+        for (const PageLoad& page : it->pages) {
+            entries[page.entry] = page.slot;
+            entryStates[page.entry] = PageState::Resident;
+            slots[page.slot].loading = false;
+        }
+        tableVersion++;
+    }
+    inFlight.erase(done, inFlight.end());
+}
+
+void VirtualTextures::readFeedback(uint32_t frameIndex, uint64_t frameNumber, std::vector<uint32_t>& wanted) {
+    vmaInvalidateAllocation(allocator, feedback[frameIndex].allocation, 0, VK_WHOLE_SIZE);
+
+    auto* header = static_cast<FeedbackHeader*>(feedback[frameIndex].info.pMappedData);
+    const uint32_t* requests = reinterpret_cast<const uint32_t*>(header + 1);
+    uint32_t count = std::min(header->count, feedbackCapacity);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t entry = requests[i];
+        if (entry >= entries.size()) {
+            continue;
+        }
+        // a fallback page the shader actually sampled comes through here too
+        if (entryStates[entry] == PageState::Resident) {
+            slots[entries[entry]].lastUsed = frameNumber;
+        } else if (entryStates[entry] == PageState::Missing) {
+            wanted.push_back(entry);
+        }
+    }
+
+    header->count = 0;
+    vmaFlushAllocation(allocator, feedback[frameIndex].allocation, 0, sizeof(FeedbackHeader));
+}
+
+void VirtualTextures::update(uint32_t frameIndex, uint64_t frameNumber) {
+    TRACE_FUNCTION();
+
+    std::vector<PageLoad> loads;
+    {
+        std::lock_guard lock(mutex);
+        currentFrame = frameNumber;
+
+        retireLoads();
+
+        std::vector<uint32_t> wanted;
+        readFeedback(frameIndex, frameNumber, wanted);
+
+        // coarse pages first, each one covers more of the screen and is the fallback for the finer ones
+        std::sort(wanted.begin(), wanted.end(), [&](uint32_t a, uint32_t b) {
+            return entryKeys[a].mip > entryKeys[b].mip;
+        });
+
+        for (uint32_t entry : wanted) {
+            uint32_t slot;
+            if (loads.size() >= pageBudget || !allocateSlot(frameNumber, slot)) {
+                break;
+            }
+            slots[slot] = { entry, frameNumber, false, true };
+            entryStates[entry] = PageState::Loading;
+            loads.push_back({ entry, slot });
+        }
+
+        auto* header = static_cast<PageTableHeader*>(pageTables[frameIndex].info.pMappedData);
+        if (writtenVersion[frameIndex] != tableVersion) {
+            header->atlasSlots = atlasSlots;
+            header->textureCount = static_cast<uint32_t>(textures.size());
+            for (uint32_t i = 0; i < textures.size(); i++) {
+                const Texture& texture = textures[i];
+                header->textures[i] = { texture.width, texture.height, texture.mipCount, texture.firstEntry };
+            }
+            memcpy(header + 1, entries.data(), entries.size() * sizeof(uint32_t));
+            writtenVersion[frameIndex] = tableVersion;
+        }
+        // stamps start out 0, so the first frame is 1
+        header->frameStamp = static_cast<uint32_t>(frameNumber + 1);
+        vmaFlushAllocation(allocator, pageTables[frameIndex].allocation, 0,
+                           sizeof(PageTableHeader) + entries.size() * sizeof(uint32_t));
+    }
+
+    if (!loads.empty()) {
+        jobs->run(work, [this, loads = std::move(loads)]() mutable {
+            loadPages(std::move(loads));
+        });
+    }
+}
+
+void VirtualTextures::writeDescriptors(VkDescriptorSet set, uint32_t frameIndex) {
+    DescriptorWriter writer;
+    writer.writeImage(0, atlas.imageView, atlasSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    writer.writeBuffer(1, pageTables[frameIndex].buffer, sizeof(PageTableHeader) + sizeof(uint32_t) * maxEntries, 0,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    writer.writeBuffer(2, stamps.buffer, sizeof(uint32_t) * maxEntries, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    writer.writeBuffer(3, feedback[frameIndex].buffer, sizeof(FeedbackHeader) + sizeof(uint32_t) * feedbackCapacity, 0,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    writer.updateSet(device, set);
+}
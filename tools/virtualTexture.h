@@ -0,0 +1,167 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "files.h"
+#include "jobSystem.h"
+#include "memoryTelemetry.h"
+#include "uploadQueue.h"
+#include "utils.h"
+
+// software virtual texturing. every texture is cooked once into a tiled file of
+// 128x128 pages (120 texels plus a 4 texel border for filtering) per mip, and
+// only the pages something actually sampled are kept in one physical atlas.
+//
+//  page table  per frame, host visible. texture info plus one entry per page that
+//              says which atlas slot holds it
+//  feedback    shaders/meshVirtual.frag appends the pages it wanted and the coarser
+//              resident page it fell back to, each page once per frame; update()
+//              reads the list back once the frame slot's fence has passed. resident
+//              pages in it count as used for the LRU, missing ones get loaded
+//  loader      jobs copy the requested pages out of the memory mapped tiles into
+//              the upload queue's staging ring, coarse mips first. slots are
+//              recycled least recently used, the coarsest mip of every texture
+//              stays pinned so there is always something to fall back to
+//
+// IDK_VT_ATLAS_SLOTS   atlas side in pages (default 16, 2048x2048)
+// IDK_VT_PAGE_BUDGET   pages loaded per frame at most (default 64)
+
+using VirtualTextureId = uint32_t;
+
+class VirtualTextures {
+public:
+    static constexpr uint32_t pageSize         { 120 };
+    static constexpr uint32_t pageBorder       { 4 };
+    static constexpr uint32_t slotSize         { pageSize + 2 * pageBorder };
+    static constexpr uint32_t maxTextures      { 64 };
+    static constexpr uint32_t maxEntries       { 1u << 16 };
+    static constexpr uint32_t feedbackCapacity { 4096 };
+
+    void init(VkDevice _device, VmaAllocator _allocator, MemoryTelemetry* _telemetry, JobSystem* _jobs,
+              UploadQueue* _uploads);
+    void shutdown();
+    bool isInitialized() const { return device != VK_NULL_HANDLE; }
+
+    // cooks the tiled file on a job if the cache doesn't have it, the texture shows
+    // grey until its coarsest page has been uploaded
+    VirtualTextureId add(const char* path);
+
+    // main thread, after the fence for frameIndex: reads that slot's feedback, starts
+    // loads, and writes the page table this frame's draw reads
+    void update(uint32_t frameIndex, uint64_t frameNumber);
+
+    // bindings 0..3 of meshVirtual.frag
+    void writeDescriptors(VkDescriptorSet set, uint32_t frameIndex);
+
+private:
+    static constexpr uint32_t notResident { UINT32_MAX };
+
+    enum class PageState : uint8_t {
+        Missing,
+        Loading,
+        Resident,
+    };
+
+    struct PageKey {
+        uint16_t texture;
+        uint8_t  mip;
+        uint16_t x;
+        uint16_t y;
+    };
+
+    struct Texture {
+        std::string              path;
+        MappedFile               file;
+        std::vector<uint8_t>     memory;     // cooked pages when the cache couldn't be written
+        std::span<const uint8_t> pages;
+        uint32_t                 width      { 0 };
+        uint32_t                 height     { 0 };
+        uint32_t                 mipCount   { 0 };
+        uint32_t                 firstEntry { 0 };
+        uint32_t                 pageCount  { 0 };
+    };
+
+    struct Slot {
+        uint32_t entry    { notResident };
+        uint64_t lastUsed { 0 };
+        bool     pinned   { false };
+        bool     loading  { false };
+    };
+
+    struct PageLoad {
+        uint32_t entry;
+        uint32_t slot;
+    };
+
+    struct Batch {
+        std::vector<PageLoad> pages;
+        uint64_t              uploadValue;
+    };
+
+    struct GpuTextureInfo {
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipCount;
+        uint32_t firstEntry;
+    };
+
+    struct PageTableHeader {
+        uint32_t       frameStamp;
+        uint32_t       atlasSlots;
+        uint32_t       textureCount;
+        uint32_t       pad;
+        GpuTextureInfo textures[maxTextures];
+    };
+
+    struct FeedbackHeader {
+        uint32_t count;
+        uint32_t capacity;
+        uint32_t pad[2];
+    };
+
+    void cook(VirtualTextureId id);
+    bool allocateSlot(uint64_t frameNumber, uint32_t& slot);
+    void loadPages(std::vector<PageLoad> pages);
+    AllocatedBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, const char* name);
+    void destroyBuffer(AllocatedBuffer& buffer);
+    void readFeedback(uint32_t frameIndex, uint64_t frameNumber, std::vector<uint32_t>& wanted);
+    void retireLoads();
+
+    VkDevice                                device         { VK_NULL_HANDLE };
+    VmaAllocator                            allocator      { VK_NULL_HANDLE };
+    MemoryTelemetry*                        telemetry      { nullptr };
+    JobSystem*                              jobs           { nullptr };
+    UploadQueue*                            uploads        { nullptr };
+
+    uint32_t                                atlasSlots     { 16 };
+    uint32_t                                pageBudget     { 64 };
+    AllocatedImage                          atlas          {};
+    VkSampler                               atlasSampler   { VK_NULL_HANDLE };
+    AllocatedBuffer                         stamps         {};
+    std::array<AllocatedBuffer, MAX_FRAMES> pageTables     {};
+    std::array<AllocatedBuffer, MAX_FRAMES> feedback       {};
+    std::array<uint64_t, MAX_FRAMES>        writtenVersion {};
+
+    JobCounter                              work;
+    std::mutex                              mutex;
+    std::deque<Texture>                     textures;
+    std::vector<uint32_t>                   entries;        // slot per page, notResident if it isn't
+    std::vector<PageState>                  entryStates;
+    std::vector<PageKey>                    entryKeys;
+    std::vector<Slot>                       slots;
+    std::vector<uint32_t>                   freeSlots;
+    std::vector<Batch>                      inFlight;
+    uint64_t                                tableVersion   { 1 };
+    uint64_t                                currentFrame   { 0 };
+    uint64_t                                pagesLoaded    { 0 };
+    uint64_t                                pagesEvicted   { 0 };
+};
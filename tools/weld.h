@@ -0,0 +1,127 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "hash.h"
+#include "jobSystem.h"
+
+// vertex welding: turns an expanded corner list into unique vertices + indices.
+//
+// vertices are compared bitwise, so the vertex type has to be trivially copyable
+// with any padding zeroed (build them with Vertex v{}). the table is open addressing
+// with linear probing, sized up front to twice the corner count so it never rehashes,
+// and every corner costs exactly one probe sequence.
+
+template<typename V>
+class VertexWelder {
+    static_assert(std::is_trivially_copyable_v<V>, "welding compares vertices bitwise");
+
+public:
+    explicit VertexWelder(size_t maxVertices) {
+        size_t capacity = 16;
+        while (capacity < maxVertices * 2) {
+            capacity <<= 1;
+        }
+        slots.assign(capacity, Slot { 0, empty });
+        mask = capacity - 1;
+    }
+
+    // returns the index of v in vertices, appending it if it's new
+    uint32_t insert(const V& v, std::vector<V>& vertices) {
+        uint64_t h = hash64(&v, sizeof(V));
+        uint32_t tag = static_cast<uint32_t>(h >> 32);
+
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            Slot& slot = slots[i];
+            if (slot.index == empty) {
+                slot.tag = tag;
+                slot.index = static_cast<uint32_t>(vertices.size());
+                vertices.push_back(v);
+                return slot.index;
+            }
+            if (slot.tag == tag && memcmp(&vertices[slot.index], &v, sizeof(V)) == 0) {
+                return slot.index;
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t empty = UINT32_MAX;
+
+    struct Slot {
+        uint32_t tag;
+        uint32_t index;
+    };
+
+    std::vector<Slot> slots;
+    size_t            mask;
+};
+
+struct WeldRange {
+    size_t first;
+    size_t count;
+};
+
+// welds corners into vertices/indices (both are overwritten). shards are welded in parallel
+// through parallel (the job system's parallelFor, no threads of its own), then the much smaller
+// set of per-shard unique vertices is welded once more so vertices shared between shards still
+// come out once. output order is first occurrence, same as a single-threaded weld, which is
+// what an empty parallel gets.
+template<typename V>
+void weldVertices(std::span<const V> corners, std::span<const WeldRange> shards,
+                  std::vector<V>& vertices, std::vector<uint32_t>& indices, const ParallelFor& parallel = nullptr) {
+    indices.resize(corners.size());
+    vertices.clear();
+
+    // not worth splitting small meshes
+    if (shards.size() <= 1 || !parallel || corners.size() < 65536) {
+        VertexWelder<V> welder(corners.size());
+        vertices.reserve(corners.size() / 4);
+        for (size_t i = 0; i < corners.size(); i++) {
+            indices[i] = welder.insert(corners[i], vertices);
+        }
+        return;
+    }
+
+    std::vector<std::vector<V>> shardVertices(shards.size());
+
+    auto weldShard = [&](size_t s) {
+        const WeldRange& range = shards[s];
+        VertexWelder<V> welder(range.count);
+        shardVertices[s].reserve(range.count / 4);
+        for (size_t i = range.first; i < range.first + range.count; i++) {
+            indices[i] = welder.insert(corners[i], shardVertices[s]);
+        }
+    };
+
+    parallel(static_cast<uint32_t>(shards.size()), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t s = begin; s < end; s++) {
+            weldShard(s);
+        }
+    });
+
+    size_t localCount = 0;
+    for (const auto& local : shardVertices) {
+        localCount += local.size();
+    }
+
+    // merge pass, remap[s] turns a shard local index into a global one
+    VertexWelder<V> welder(localCount);
+    vertices.reserve(localCount);
+    std::vector<uint32_t> remap;
+    for (size_t s = 0; s < shards.size(); s++) {
+        remap.resize(shardVertices[s].size());
+        for (size_t i = 0; i < shardVertices[s].size(); i++) {
+            remap[i] = welder.insert(shardVertices[s][i], vertices);
+        }
+
+        const WeldRange& range = shards[s];
+        for (size_t i = range.first; i < range.first + range.count; i++) {
+            indices[i] = remap[indices[i]];
+        }
+    }
+}
@@ -0,0 +1,176 @@
+#include "workgroupTuner.h"
+#include "files.h"
+#include "settings.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+void WorkgroupTuner::init(VkPhysicalDevice physicalDevice, uint32_t queueFamily, const char* _name, uint32_t fallback) {
+    name = _name;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    driverVersion = properties.driverVersion;
+    nsPerTick = properties.limits.timestampPeriod;
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+    // no valid bits, no timestamps, nothing to tune with
+    uint32_t validBits = families[queueFamily].timestampValidBits;
+    tickMask = validBits == 0 ? 0 : validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    // 128 is all the spec promises, 256 only where the limits say so
+    uint32_t limit = std::min(properties.limits.maxComputeWorkGroupSize[0], properties.limits.maxComputeWorkGroupInvocations);
+    for (uint32_t size : { 64u, 128u, 256u }) {
+        if (size <= limit) {
+            supported.push_back(size);
+        }
+    }
+
+    char fileName[64];
+    snprintf(fileName, sizeof(fileName), "%s-workgroup-%04x-%04x", name.c_str(), properties.vendorID, properties.deviceID);
+    path = cacheFilePath(fileName, "wgsz");
+
+    std::string variable = "IDK_" + name + "_WORKGROUP";
+    std::transform(variable.begin(), variable.end(), variable.begin(), [](unsigned char c) { return std::toupper(c); });
+    uint32_t requested = static_cast<uint32_t>(envNumber(variable.c_str(), 0.0));
+    bool loaded = false;
+    if (requested > 0 && requested <= limit) {
+        workgroupSize = requested;
+        forced = true;
+    } else {
+        if (requested > 0) {
+            std::cerr << variable << "=" << requested << " is over the device limit of " << limit << ", ignored" << std::endl;
+        }
+        loaded = load();
+        if (!loaded) {
+            workgroupSize = fallback;
+        }
+    }
+
+    std::cout << "Workgroup size for " << name << ": " << workgroupSize
+              << (forced ? " (forced)" : loaded ? " (tuned)" : "") << std::endl;
+}
+
+bool WorkgroupTuner::wantsTuning() const {
+    return envFlag("IDK_TUNE_WORKGROUPS") && !forced && tickMask != 0 && supported.size() > 1;
+}
+
+uint32_t WorkgroupTuner::tune(VkDevice device, const Submit& submit, const Record& record) {
+    // the first round warms caches and clocks and isn't counted
+    constexpr uint32_t rounds = 5;
+    constexpr uint32_t repeats = 8;
+    uint32_t candidateCount = static_cast<uint32_t>(supported.size());
+
+    VkQueryPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = candidateCount * repeats * 2;
+
+    VkQueryPool queryPool;
+    VK_CHECK(vkCreateQueryPool(device, &poolInfo, nullptr, &queryPool));
+
+    std::vector<std::vector<double>> samples(candidateCount);
+    std::vector<uint64_t> ticks(poolInfo.queryCount);
+    for (uint32_t round = 0; round < rounds; round++) {
+        submit([&](VkCommandBuffer cmd) {
+            vkCmdResetQueryPool(cmd, queryPool, 0, poolInfo.queryCount);
+
+            // candidates interleaved inside a round, so a clock ramping up doesn't favour the last one
+            for (uint32_t r = 0; r < repeats; r++) {
+                for (uint32_t c = 0; c < candidateCount; c++) {
+                    uint32_t query = (c * repeats + r) * 2;
+                    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, query);
+                    record(cmd, c);
+                    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, query + 1);
+
+                    // the next run writes the same buffers
+                    VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+                    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+                    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+                }
+            }
+        });
+
+        VK_CHECK(vkGetQueryPoolResults(device, queryPool, 0, poolInfo.queryCount, ticks.size() * sizeof(uint64_t),
+            ticks.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+        if (round == 0) {
+            continue;
+        }
+        for (uint32_t c = 0; c < candidateCount; c++) {
+            for (uint32_t r = 0; r < repeats; r++) {
+                uint32_t query = (c * repeats + r) * 2;
+                samples[c].push_back(((ticks[query + 1] - ticks[query]) & tickMask) * nsPerTick);
+            }
+        }
+    }
+
+    vkDestroyQueryPool(device, queryPool, nullptr);
+
+    // median, one preempted run shouldn't decide it
+    uint32_t best = 0;
+    std::vector<double> medians(candidateCount);
+    for (uint32_t c = 0; c < candidateCount; c++) {
+        std::vector<double>& times = samples[c];
+        std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+        medians[c] = times[times.size() / 2];
+        if (medians[c] < medians[best]) {
+            best = c;
+        }
+    }
+
+    for (uint32_t c = 0; c < candidateCount; c++) {
+        std::cout << "  " << name << " workgroup " << supported[c] << ": " << medians[c] / 1000.0 << " us"
+                  << (c == best ? "  <-" : "") << std::endl;
+    }
+
+    workgroupSize = supported[best];
+    save();
+    return workgroupSize;
+}
+
+bool WorkgroupTuner::load() {
+    MappedFile file;
+    if (!file.open(path.c_str())) {
+        return false;
+    }
+
+    FileHeader header {};
+    if (file.size() != sizeof(header)) {
+        std::cerr << "Workgroup file " << path << " is corrupt, ignored" << std::endl;
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(header));
+
+    if (header.magic != magic || header.version != version ||
+        std::find(supported.begin(), supported.end(), header.workgroupSize) == supported.end()) {
+        std::cerr << "Workgroup file " << path << " is corrupt, ignored" << std::endl;
+        return false;
+    }
+    // a new driver compiles differently, the old winner might not be one anymore
+    if (header.driverVersion != driverVersion) {
+        std::cout << "Workgroup file " << path << " is from another driver, run with IDK_TUNE_WORKGROUPS=1 again" << std::endl;
+        return false;
+    }
+
+    workgroupSize = header.workgroupSize;
+    return true;
+}
+
+bool WorkgroupTuner::save() const {
+    FileHeader header { magic, version, driverVersion, workgroupSize };
+    if (!writeFileAtomic(path, { reinterpret_cast<const uint8_t*>(&header), sizeof(header) })) {
+        return false;
+    }
+    std::cout << "Saved " << name << " workgroup size " << workgroupSize << " to " << path << std::endl;
+    return true;
+}
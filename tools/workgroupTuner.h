@@ -0,0 +1,55 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// picks the workgroup size of one compute pass for the device it runs on. the shader
+// takes the size as a specialization constant (local_size_x_id), so size() is the only
+// place it's decided and the dispatch math reads the same number.
+//
+// IDK_TUNE_WORKGROUPS=1 times every candidate with timestamp queries and saves the
+// fastest to the cache dir, one file per pass, vendor and device. later launches read it
+// back, unless the driver changed since. IDK_<NAME>_WORKGROUP=n forces a size.
+class WorkgroupTuner {
+public:
+    using Submit = std::function<void(std::function<void(VkCommandBuffer)>&&)>;
+    // records the pass once with the pipeline built for candidates()[candidate]
+    using Record = std::function<void(VkCommandBuffer cmd, uint32_t candidate)>;
+
+    static constexpr uint32_t magic   { 0x53474449 };  // "IDGS"
+    static constexpr uint32_t version { 1 };
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t driverVersion;
+        uint32_t workgroupSize;
+    };
+
+    // name is the pass, for the file and the override ("cull" reads IDK_CULL_WORKGROUP)
+    void init(VkPhysicalDevice physicalDevice, uint32_t queueFamily, const char* _name, uint32_t fallback);
+
+    uint32_t size() const { return workgroupSize; }
+    // the sizes the device can run, what tune() tries
+    const std::vector<uint32_t>& candidates() const { return supported; }
+    // IDK_TUNE_WORKGROUPS is set, the queue has timestamps and there's a choice to make
+    bool wantsTuning() const;
+
+    // runs every candidate a few rounds, keeps the fastest median and saves it
+    uint32_t tune(VkDevice device, const Submit& submit, const Record& record);
+
+private:
+    bool load();
+    bool save() const;
+
+    std::string           name;
+    std::string           path;
+    uint32_t              workgroupSize { 0 };
+    uint32_t              driverVersion { 0 };
+    bool                  forced        { false };
+    double                nsPerTick     { 1.0 };
+    uint64_t              tickMask      { ~0ull };
+    std::vector<uint32_t> supported;
+};